@@ -278,6 +278,12 @@ LUA_API int lua_isnumber (lua_State *L, int idx) {
 }
 
 
+LUA_API int lua_isinteger (lua_State *L, int idx) {
+  StkId o = index2addr(L, idx);
+  return ttisinteger(o);
+}
+
+
 LUA_API int lua_isstring (lua_State *L, int idx) {
   int t = lua_type(L, idx);
   return (t == LUA_TSTRING || t == LUA_TNUMBER);
@@ -310,9 +316,8 @@ LUA_API void lua_arith (lua_State *L, int op) {
   }
   o1 = L->top - 2;
   o2 = L->top - 1;
-  if (ttisnumber(o1) && ttisnumber(o2)) {
-    setnvalue(o1, luaO_arith(op, nvalue(o1), nvalue(o2)));
-  }
+  if (ttisnumber(o1) && ttisnumber(o2))
+    luaO_arith(op, o1, o2, o1);
   else
     luaV_arith(L, o1, o1, o2, cast(TMS, op - LUA_OPADD + TM_ADD));
   L->top--;
@@ -356,7 +361,11 @@ LUA_API lua_Number lua_tonumberx (lua_State *L, int idx, int *isnum) {
 LUA_API lua_Integer lua_tointegerx (lua_State *L, int idx, int *isnum) {
   TValue n;
   const TValue *o = index2addr(L, idx);
-  if (tonumber(o, &n)) {
+  if (ttisinteger(o)) {  /* fast path: no conversion */
+    if (isnum) *isnum = 1;
+    return ivalue(o);
+  }
+  else if (tonumber(o, &n)) {
     lua_Integer res;
     lua_Number num = nvalue(o);
     lua_number2integer(res, num);
@@ -373,7 +382,11 @@ LUA_API lua_Integer lua_tointegerx (lua_State *L, int idx, int *isnum) {
 LUA_API lua_Unsigned lua_tounsignedx (lua_State *L, int idx, int *isnum) {
   TValue n;
   const TValue *o = index2addr(L, idx);
-  if (tonumber(o, &n)) {
+  if (ttisinteger(o)) {  /* fast path: modular conversion */
+    if (isnum) *isnum = 1;
+    return cast(lua_Unsigned, ivalue(o));
+  }
+  else if (tonumber(o, &n)) {
     lua_Unsigned res;
     lua_Number num = nvalue(o);
     lua_number2unsigned(res, num);
@@ -489,19 +502,58 @@ LUA_API void lua_pushnumber (lua_State *L, lua_Number n) {
 
 LUA_API void lua_pushinteger (lua_State *L, lua_Integer n) {
   lua_lock(L);
-  setnvalue(L->top, cast_num(n));
+  if (luai_intfits(n)) {
+    setivalue(L->top, n);
+  }
+  else {  /* too large for the integer subtype (LUA_NANTRICK) */
+    setnvalue(L->top, cast_num(n));
+  }
   api_incr_top(L);
   lua_unlock(L);
 }
 
 
 LUA_API void lua_pushunsigned (lua_State *L, lua_Unsigned u) {
+  lua_lock(L);
+#if LUA_MAXINTEGER >= 0xFFFFFFFF  /* 'lua_Unsigned' has 32 bits */
+  setivalue(L->top, cast(lua_Integer, u));  /* always fits */
+#else
+  if (u <= cast(lua_Unsigned, LUA_MAXINTEGER)) {
+    setivalue(L->top, cast(lua_Integer, u));
+  }
+  else {
+    lua_Number n = lua_unsigned2number(u);
+    setnvalue(L->top, n);
+  }
+#endif
+  api_incr_top(L);
+  lua_unlock(L);
+}
+
+
+/*
+** converts string 's' to a number (an integer when the numeral is
+** integral) and pushes it; returns the string size plus one, or 0 (and
+** pushes nothing) when 's' is not a valid numeral
+*/
+LUA_API size_t lua_stringtonumber (lua_State *L, const char *s) {
+  size_t len = strlen(s);
+  lua_Integer i;
   lua_Number n;
   lua_lock(L);
-  n = lua_unsigned2number(u);
-  setnvalue(L->top, n);
+  if (luaO_str2int(s, len, &i)) {
+    setivalue(L->top, i);
+  }
+  else if (luaO_str2d(s, len, &n)) {
+    setnvalue(L->top, n);
+  }
+  else {
+    lua_unlock(L);
+    return 0;  /* conversion failed */
+  }
   api_incr_top(L);
   lua_unlock(L);
+  return len + 1;
 }
 
 
@@ -616,8 +668,9 @@ LUA_API int lua_pushthread (lua_State *L) {
 LUA_API void lua_getglobal (lua_State *L, const char *var) {
   Table *reg = hvalue(&G(L)->l_registry);
   const TValue *gt;  /* global table */
+  TValue aux;
   lua_lock(L);
-  gt = luaH_getint(reg, LUA_RIDX_GLOBALS);
+  gt = luaH_getint(reg, LUA_RIDX_GLOBALS, &aux);
   setsvalue2s(L, L->top++, luaS_new(L, var));
   luaV_gettable(L, gt, L->top - 1, L->top - 1);
   lua_unlock(L);
@@ -646,20 +699,22 @@ LUA_API void lua_getfield (lua_State *L, int idx, const char *k) {
 
 LUA_API void lua_rawget (lua_State *L, int idx) {
   StkId t;
+  TValue aux;
   lua_lock(L);
   t = index2addr(L, idx);
   api_check(L, ttistable(t), "table expected");
-  setobj2s(L, L->top - 1, luaH_get(hvalue(t), L->top - 1));
+  setobj2s(L, L->top - 1, luaH_get(hvalue(t), L->top - 1, &aux));
   lua_unlock(L);
 }
 
 
 LUA_API void lua_rawgeti (lua_State *L, int idx, int n) {
   StkId t;
+  TValue aux;
   lua_lock(L);
   t = index2addr(L, idx);
   api_check(L, ttistable(t), "table expected");
-  setobj2s(L, L->top, luaH_getint(hvalue(t), n));
+  setobj2s(L, L->top, luaH_getint(hvalue(t), n, &aux));
   api_incr_top(L);
   lua_unlock(L);
 }
@@ -667,12 +722,12 @@ LUA_API void lua_rawgeti (lua_State *L, int idx, int n) {
 
 LUA_API void lua_rawgetp (lua_State *L, int idx, const void *p) {
   StkId t;
-  TValue k;
+  TValue k, aux;
   lua_lock(L);
   t = index2addr(L, idx);
   api_check(L, ttistable(t), "table expected");
   setpvalue(&k, cast(void *, p));
-  setobj2s(L, L->top, luaH_get(hvalue(t), &k));
+  setobj2s(L, L->top, luaH_get(hvalue(t), &k, &aux));
   api_incr_top(L);
   lua_unlock(L);
 }
@@ -691,6 +746,22 @@ LUA_API void lua_createtable (lua_State *L, int narray, int nrec) {
 }
 
 
+/* 压入一个表的浅拷贝 */
+LUA_API void lua_clonetable (lua_State *L, int idx) {
+  StkId o;
+  Table *t;
+  lua_lock(L);
+  luaC_checkGC(L);
+  o = index2addr(L, idx);
+  api_check(L, ttistable(o), "table expected");
+  t = luaH_new(L);
+  sethvalue(L, L->top, t);
+  api_incr_top(L);
+  luaH_copy(L, t, hvalue(o));
+  lua_unlock(L);
+}
+
+
 LUA_API int lua_getmetatable (lua_State *L, int objindex) {
   const TValue *obj;
   Table *mt = NULL;
@@ -742,9 +813,10 @@ LUA_API void lua_getuservalue (lua_State *L, int idx) {
 LUA_API void lua_setglobal (lua_State *L, const char *var) {
   Table *reg = hvalue(&G(L)->l_registry);
   const TValue *gt;  /* global table */
+  TValue aux;
   lua_lock(L);
   api_checknelems(L, 1);
-  gt = luaH_getint(reg, LUA_RIDX_GLOBALS);
+  gt = luaH_getint(reg, LUA_RIDX_GLOBALS, &aux);
   setsvalue2s(L, L->top++, luaS_new(L, var));
   luaV_settable(L, gt, L->top - 1, L->top - 2);
   L->top -= 2;  /* pop value and key */
@@ -781,7 +853,7 @@ LUA_API void lua_rawset (lua_State *L, int idx) {
   api_checknelems(L, 2);
   t = index2addr(L, idx);
   api_check(L, ttistable(t), "table expected");
-  setobj2t(L, luaH_set(L, hvalue(t), L->top-2), L->top-1);
+  luaH_set(L, hvalue(t), L->top-2, L->top-1);
   invalidateTMcache(hvalue(t));
   luaC_barrierback(L, gcvalue(t), L->top-1);
   L->top -= 2;
@@ -810,13 +882,59 @@ LUA_API void lua_rawsetp (lua_State *L, int idx, const void *p) {
   t = index2addr(L, idx);
   api_check(L, ttistable(t), "table expected");
   setpvalue(&k, cast(void *, p));
-  setobj2t(L, luaH_set(L, hvalue(t), &k), L->top - 1);
+  luaH_set(L, hvalue(t), &k, L->top - 1);
   luaC_barrierback(L, gcvalue(t), L->top - 1);
   L->top--;
   lua_unlock(L);
 }
 
 
+/* 删除表中所有的健,保留其内存 */
+LUA_API void lua_cleartable (lua_State *L, int idx) {
+  StkId t;
+  lua_lock(L);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  luaH_clear(L, hvalue(t));
+  lua_unlock(L);
+}
+
+
+/* t[d..d+e-f] = from[f..e],t与from分别在栈索引tidx与idx处 */
+LUA_API void lua_rawmove (lua_State *L, int idx, int f, int e, int d,
+                                        int tidx) {
+  StkId from, t;
+  lua_lock(L);
+  from = index2addr(L, idx);
+  t = index2addr(L, tidx);
+  api_check(L, ttistable(from) && ttistable(t), "table expected");
+  api_check(L, f <= e && e - f < MAX_INT, "invalid range");
+  luaH_move(L, hvalue(from), f, e, hvalue(t), d);
+  lua_unlock(L);
+}
+
+
+/* 用栈索引comp处的比较函数(为0时用'<')原地排序t[1..n] */
+LUA_API void lua_rawsort (lua_State *L, int idx, int n, int comp,
+                                        int stable) {
+  StkId t;
+  ptrdiff_t f = -1;
+  lua_lock(L);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  if (comp != 0) {  /* keep the order function at the top */
+    api_check(L, ttisfunction(index2addr(L, comp)), "function expected");
+    setobj2s(L, L->top, index2addr(L, comp));
+    api_incr_top(L);
+    f = savestack(L, L->top - 1);
+  }
+  luaH_sort(L, hvalue(t), n, f, stable);
+  if (comp != 0)
+    L->top--;
+  lua_unlock(L);
+}
+
+
 LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   TValue *obj;
   Table *mt;
@@ -1000,7 +1118,8 @@ LUA_API int lua_load (lua_State *L, lua_Reader reader, void *data,
     if (f->nupvalues == 1) {  /* does it have one upvalue? */
       /* get global table from registry */
       Table *reg = hvalue(&G(L)->l_registry);
-      const TValue *gt = luaH_getint(reg, LUA_RIDX_GLOBALS);
+      TValue aux;
+      const TValue *gt = luaH_getint(reg, LUA_RIDX_GLOBALS, &aux);
       /* set global table as 1st upvalue of 'f' (may be LUA_ENV) */
       setobj(L, f->upvals[0]->v, gt);
       luaC_barrier(L, f->upvals[0], gt);
@@ -1161,6 +1280,32 @@ LUA_API void lua_concat (lua_State *L, int n) {
 }
 
 
+/*
+** replaces the separator at the top with the concatenation of t[i..j];
+** fails (popping the separator) when t[k] is neither a string nor a
+** number, storing 'k' in '*bad'
+*/
+/* 用t[i..j]的链接替换栈顶的分隔符;t[k]不是字符串或数字时失败 */
+LUA_API int lua_rawconcat (lua_State *L, int idx, int i, int j, int *bad) {
+  StkId t;
+  TString *ts;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  api_check(L, ttisstring(L->top - 1), "string expected");
+  luaC_checkGC(L);
+  ts = luaV_tconcat(L, hvalue(t), i, j, rawtsvalue(L->top - 1), bad);
+  if (ts != NULL) {
+    setsvalue2s(L, L->top - 1, ts);
+  }
+  else
+    L->top--;
+  lua_unlock(L);
+  return (ts != NULL);
+}
+
+
 LUA_API void lua_len (lua_State *L, int idx) {
   StkId t;
   lua_lock(L);
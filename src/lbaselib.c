@@ -20,6 +20,14 @@
 #include "lualib.h"
 
 
+/*
+** iterators of 'pairs' and 'ipairs': they are in the core (see lvm.c),
+** which runs them inline in generic 'for' loops
+*/
+LUAI_FUNC int luaV_next (lua_State *L);
+LUAI_FUNC int luaV_ipairsaux (lua_State *L);
+
+
 static int luaB_print (lua_State *L) {
   int n = lua_gettop(L);  /* number of arguments */
   int i;
@@ -47,11 +55,15 @@ static int luaB_print (lua_State *L) {
 
 static int luaB_tonumber (lua_State *L) {
   if (lua_isnoneornil(L, 2)) {  /* standard conversion */
-    int isnum;
-    lua_Number n = lua_tonumberx(L, 1, &isnum);
-    if (isnum) {
-      lua_pushnumber(L, n);
+    if (lua_type(L, 1) == LUA_TNUMBER) {  /* already a number? */
+      lua_settop(L, 1);  /* keep its subtype */
       return 1;
+    }
+    else {
+      size_t l;
+      const char *s = lua_tolstring(L, 1, &l);
+      if (s != NULL && lua_stringtonumber(L, s) == l + 1)
+        return 1;  /* successful conversion to number */
     }  /* else not a number; must be something */
     luaL_checkany(L, 1);
   }
@@ -210,35 +222,13 @@ static int pairsmeta (lua_State *L, const char *method, int iszero,
 }
 
 
-static int luaB_next (lua_State *L) {
-  luaL_checktype(L, 1, LUA_TTABLE);
-  lua_settop(L, 2);  /* create a 2nd argument if there isn't one */
-  if (lua_next(L, 1))
-    return 2;
-  else {
-    lua_pushnil(L);
-    return 1;
-  }
-}
-
-
 static int luaB_pairs (lua_State *L) {
-  return pairsmeta(L, "__pairs", 0, luaB_next);
-}
-
-
-static int ipairsaux (lua_State *L) {
-  int i = luaL_checkint(L, 2);
-  luaL_checktype(L, 1, LUA_TTABLE);
-  i++;  /* next value */
-  lua_pushinteger(L, i);
-  lua_rawgeti(L, 1, i);
-  return (lua_isnil(L, -1)) ? 1 : 2;
+  return pairsmeta(L, "__pairs", 0, luaV_next);
 }
 
 
 static int luaB_ipairs (lua_State *L) {
-  return pairsmeta(L, "__ipairs", 1, ipairsaux);
+  return pairsmeta(L, "__ipairs", 1, luaV_ipairsaux);
 }
 
 
@@ -426,7 +416,7 @@ static const luaL_Reg base_funcs[] = {
 #if defined(LUA_COMPAT_LOADSTRING)
   {"loadstring", luaB_load},
 #endif
-  {"next", luaB_next},
+  {"next", luaV_next},
   {"pairs", luaB_pairs},
   {"pcall", luaB_pcall},
   {"print", luaB_print},
@@ -6,6 +6,7 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 
 #define lcode_c
 #define LUA_CORE
@@ -29,8 +30,27 @@
 #define hasjumps(e)	((e)->t != (e)->f)
 
 
+/*
+** if expression is a numeric constant, fills 'v' with its value
+** (when 'v' is not NULL) and returns 1; otherwise returns 0
+*/
+static int tonumeral(expdesc *e, TValue *v) {
+  if (e->t != NO_JUMP || e->f != NO_JUMP)
+    return 0;  /* not a numeral */
+  switch (e->k) {
+    case VKINT:
+      if (v) setivalue(v, e->u.ival);
+      return 1;
+    case VKNUM:
+      if (v) setnvalue(v, e->u.nval);
+      return 1;
+    default: return 0;
+  }
+}
+
+
 static int isnumeral(expdesc *e) {
-  return (e->k == VKNUM && e->t == NO_JUMP && e->f == NO_JUMP);
+  return tonumeral(e, NULL);
 }
 
 
@@ -290,13 +310,14 @@ static void freeexp (FuncState *fs, expdesc *e) {
 
 static int addk (FuncState *fs, TValue *key, TValue *v) {
   lua_State *L = fs->ls->L;
-  TValue *idx = luaH_set(L, fs->h, key);
+  TValue aux;
+  const TValue *idx = luaH_get(fs->h, key, &aux);
   Proto *f = fs->f;
   int k, oldsize;
-  if (ttisnumber(idx)) {
-    lua_Number n = nvalue(idx);
-    lua_number2int(k, n);
-    if (luaV_rawequalobj(&f->k[k], v))
+  if (ttisinteger(idx)) {
+    k = cast_int(ivalue(idx));
+    /* values must have the same subtype: 1 and 1.0 are distinct constants */
+    if (ttisequal(&f->k[k], v) && luaV_rawequalobj(&f->k[k], v))
       return k;
     /* else may be a collision (e.g., between 0.0 and "\0\0\0\0\0\0\0\0");
        go through and create a new entry for this value */
@@ -306,7 +327,8 @@ static int addk (FuncState *fs, TValue *key, TValue *v) {
   k = fs->nk;
   /* numerical value does not need GC barrier;
      table has no metatable, so it does not need to invalidate cache */
-  setnvalue(idx, cast_num(k));
+  setivalue(&aux, cast(lua_Integer, k));
+  luaH_set(L, fs->h, key, &aux);
   luaM_growvector(L, f->k, k, f->sizek, TValue, MAXARG_Ax, "constants");
   while (oldsize < f->sizek) setnilvalue(&f->k[oldsize++]);
   setobj(L, &f->k[k], v);
@@ -323,13 +345,22 @@ int luaK_stringK (FuncState *fs, TString *s) {
 }
 
 
+int luaK_intK (FuncState *fs, lua_Integer i) {
+  TValue o;
+  setivalue(&o, i);
+  return addk(fs, &o, &o);
+}
+
+
 int luaK_numberK (FuncState *fs, lua_Number r) {
   int n;
+  lua_Integer ik;
   lua_State *L = fs->ls->L;
   TValue o;
   setnvalue(&o, r);
-  if (r == 0 || luai_numisnan(NULL, r)) {  /* handle -0 and NaN */
-    /* use raw representation as key to avoid numeric problems */
+  if (luai_numisnan(NULL, r) || luaV_flttointeger(r, &ik, 0)) {
+    /* NaN, -0 and integral floats (which would collide with integer
+       keys) use their raw representation as key */
     setsvalue(L, L->top++, luaS_newlstr(L, (char *)&r, sizeof(r)));
     n = addk(fs, L->top - 1, &o);
     L->top--;
@@ -347,6 +378,18 @@ static int boolK (FuncState *fs, int b) {
 }
 
 
+/*
+** table constants are constructor templates (see OP_NEWTEMPL); each
+** one is only equal to itself
+*/
+/* 表常量(构造函数的模板) */
+int luaK_tableK (FuncState *fs, Table *t) {
+  TValue o;
+  sethvalue(fs->ls->L, &o, t);
+  return addk(fs, &o, &o);
+}
+
+
 static int nilK (FuncState *fs) {
   TValue k, v;
   setnilvalue(&v);
@@ -380,6 +423,21 @@ void luaK_setoneret (FuncState *fs, expdesc *e) {
 }
 
 
+/*
+** choose the opcode to index a table in a register: constant
+** short-string keys and constant integer keys have specialized ones
+*/
+static OpCode keyedop (FuncState *fs, int idx, OpCode op, OpCode opstr,
+                       OpCode opint) {
+  if (ISK(idx)) {
+    TValue *key = &fs->f->k[INDEXK(idx)];
+    if (ttisshrstring(key)) return opstr;
+    else if (ttisinteger(key)) return opint;
+  }
+  return op;
+}
+
+
 void luaK_dischargevars (FuncState *fs, expdesc *e) {
   switch (e->k) {
     case VLOCAL: {
@@ -396,7 +454,7 @@ void luaK_dischargevars (FuncState *fs, expdesc *e) {
       freereg(fs, e->u.ind.idx);
       if (e->u.ind.vt == VLOCAL) {  /* 't' is in a register? */
         freereg(fs, e->u.ind.t);
-        op = OP_GETTABLE;
+        op = keyedop(fs, e->u.ind.idx, OP_GETTABLE, OP_GETFIELD, OP_GETI);
       }
       e->u.info = luaK_codeABC(fs, op, 0, e->u.ind.t, e->u.ind.idx);
       e->k = VRELOCABLE;
@@ -437,6 +495,10 @@ static void discharge2reg (FuncState *fs, expdesc *e, int reg) {
       luaK_codek(fs, reg, luaK_numberK(fs, e->u.nval));
       break;
     }
+    case VKINT: {
+      luaK_codek(fs, reg, luaK_intK(fs, e->u.ival));
+      break;
+    }
     case VRELOCABLE: {
       Instruction *pc = &getcode(fs, e);
       SETARG_A(*pc, reg);
@@ -538,8 +600,10 @@ int luaK_exp2RK (FuncState *fs, expdesc *e) {
       }
       else break;
     }
-    case VKNUM: {
-      e->u.info = luaK_numberK(fs, e->u.nval);
+    case VKNUM:
+    case VKINT: {
+      e->u.info = (e->k == VKINT) ? luaK_intK(fs, e->u.ival)
+                                  : luaK_numberK(fs, e->u.nval);
       e->k = VK;
       /* go through */
     }
@@ -568,8 +632,10 @@ void luaK_storevar (FuncState *fs, expdesc *var, expdesc *ex) {
       break;
     }
     case VINDEXED: {
-      OpCode op = (var->u.ind.vt == VLOCAL) ? OP_SETTABLE : OP_SETTABUP;
+      OpCode op = OP_SETTABUP;  /* assume 't' is in an upvalue */
       int e = luaK_exp2RK(fs, ex);
+      if (var->u.ind.vt == VLOCAL)  /* 't' is in a register? */
+        op = keyedop(fs, var->u.ind.idx, OP_SETTABLE, OP_SETFIELD, OP_SETI);
       luaK_codeABC(fs, op, var->u.ind.t, var->u.ind.idx, e);
       break;
     }
@@ -627,7 +693,7 @@ void luaK_goiftrue (FuncState *fs, expdesc *e) {
       pc = e->u.info;
       break;
     }
-    case VK: case VKNUM: case VTRUE: {
+    case VK: case VKNUM: case VKINT: case VTRUE: {
       pc = NO_JUMP;  /* always true; do nothing */
       break;
     }
@@ -672,7 +738,7 @@ static void codenot (FuncState *fs, expdesc *e) {
       e->k = VTRUE;
       break;
     }
-    case VK: case VKNUM: case VTRUE: {
+    case VK: case VKNUM: case VKINT: case VTRUE: {
       e->k = VFALSE;
       break;
     }
@@ -711,12 +777,19 @@ void luaK_indexed (FuncState *fs, expdesc *t, expdesc *k) {
 
 
 static int constfolding (OpCode op, expdesc *e1, expdesc *e2) {
-  lua_Number r;
-  if (!isnumeral(e1) || !isnumeral(e2)) return 0;
-  if ((op == OP_DIV || op == OP_MOD) && e2->u.nval == 0)
+  TValue v1, v2, res;
+  if (!tonumeral(e1, &v1) || !tonumeral(e2, &v2)) return 0;
+  if ((op == OP_DIV || op == OP_MOD) && nvalue(&v2) == 0)
     return 0;  /* do not attempt to divide by 0 */
-  r = luaO_arith(op - OP_ADD + LUA_OPADD, e1->u.nval, e2->u.nval);
-  e1->u.nval = r;
+  luaO_arith(op - OP_ADD + LUA_OPADD, &v1, &v2, &res);
+  if (ttisinteger(&res)) {
+    e1->k = VKINT;
+    e1->u.ival = ivalue(&res);
+  }
+  else {
+    e1->k = VKNUM;
+    e1->u.nval = fltvalue(&res);
+  }
   return 1;
 }
 
@@ -764,8 +837,16 @@ void luaK_prefix (FuncState *fs, UnOpr op, expdesc *e, int line) {
   e2.t = e2.f = NO_JUMP; e2.k = VKNUM; e2.u.nval = 0;
   switch (op) {
     case OPR_MINUS: {
-      if (isnumeral(e))  /* minus constant? */
-        e->u.nval = luai_numunm(NULL, e->u.nval);  /* fold it */
+      if (isnumeral(e)) {  /* minus constant? */
+        lua_Integer i;
+        if (e->k == VKINT && !luai_intunm(NULL, i, e->u.ival))
+          e->u.ival = i;  /* fold it as an integer */
+        else {
+          lua_Number n = (e->k == VKINT) ? cast_num(e->u.ival) : e->u.nval;
+          e->k = VKNUM;
+          e->u.nval = luai_numunm(NULL, n);  /* fold it */
+        }
+      }
       else {
         luaK_exp2anyreg(fs, e);
         codearith(fs, OP_UNM, e, &e2, line);
@@ -879,3 +960,1136 @@ void luaK_setlist (FuncState *fs, int base, int nelems, int tostore) {
   fs->freereg = base + 1;  /* free registers with list values */
 }
 
+
+/*
+** whether 'LEN c t; ADD c c 1' starts at 'pc' and 'SETTABLE t c v' is
+** at 'st', with 't' and 'v' not in 'c'
+*/
+static int isappend (Proto *f, int pc, int st) {
+  Instruction *code = f->code;
+  int c = GETARG_A(code[pc]);
+  int one = GETARG_C(code[pc + 1]);
+  return (GET_OPCODE(code[pc]) == OP_LEN && GETARG_B(code[pc]) != c &&
+          GET_OPCODE(code[pc + 1]) == OP_ADD &&
+          GETARG_A(code[pc + 1]) == c && GETARG_B(code[pc + 1]) == c &&
+          ISK(one) && ttisinteger(&f->k[INDEXK(one)]) &&
+          ivalue(&f->k[INDEXK(one)]) == 1 &&
+          GET_OPCODE(code[st]) == OP_SETTABLE &&
+          GETARG_A(code[st]) == GETARG_B(code[pc]) &&
+          GETARG_B(code[st]) == c && GETARG_C(code[st]) != c);
+}
+
+
+/*
+** whether instruction 'i' cannot run other code nor change registers
+** up to 'r', and reads no variable: the registers above 'r' it reads
+** were set by the code before it, so running it before a '__len'
+** metamethod (that may change variables) does not change its result.
+** Stores are allowed only into a table created by an earlier
+** instruction in the same code ('fresh' has its register).
+*/
+static int ispure (Instruction i, int r, int *fresh) {
+  int a = GETARG_A(i);
+  switch (GET_OPCODE(i)) {
+    case OP_NEWTABLE: case OP_NEWTEMPL:
+      *fresh = a;
+      /* go through */
+    case OP_LOADK: case OP_LOADKX: case OP_LOADNIL: case OP_CLOSURE:
+      return (a > r);
+    case OP_MOVE:
+      return (a > r && GETARG_B(i) > r);
+    case OP_LOADBOOL:
+      return (a > r && GETARG_C(i) == 0);
+    case OP_SETTABLE: case OP_SETFIELD: case OP_SETI:
+      return (a > r && a == *fresh &&
+              (ISK(GETARG_B(i)) || GETARG_B(i) > r) &&
+              (ISK(GETARG_C(i)) || GETARG_C(i) > r));
+    case OP_SETLIST:  /* (its values are above 'a') */
+      return (a > r && a == *fresh && GETARG_B(i) != 0);
+    case OP_EXTRAARG:
+      return 1;
+    default: return 0;
+  }
+}
+
+
+/*
+** 't[#t+1] = v', for a local 't', is coded as 'LEN c t; ADD c c 1',
+** starting at 'pc', the code of 'v' and a SETTABLE. When the code of
+** 'v' cannot run other code, change 't' nor see what a '__len' of 't'
+** does (see 'ispure'), it is moved before the length, so that
+** 'luaK_fuse' finds the three instructions together and turns them
+** into OP_APPEND.
+*/
+void luaK_append (FuncState *fs, int pc) {
+  Proto *f = fs->f;
+  Instruction *code = f->code;
+  int st = fs->pc - 1;  /* the store */
+  int fresh = NO_REG;
+  Instruction len, add;
+  int l1, l2, j;
+  if (st < pc + 2 || !isappend(f, pc, st)) return;
+  for (j = pc + 2; j < st; j++) {
+    if (!ispure(code[j], GETARG_A(code[pc]), &fresh)) return;
+  }
+  len = code[pc]; add = code[pc + 1];
+  l1 = f->lineinfo[pc]; l2 = f->lineinfo[pc + 1];
+  for (j = pc; j < st - 2; j++) {
+    code[j] = code[j + 2];
+    f->lineinfo[j] = f->lineinfo[j + 2];
+  }
+  code[st - 2] = len; code[st - 1] = add;
+  f->lineinfo[st - 2] = l1; f->lineinfo[st - 1] = l2;
+}
+
+
+/*
+** if condition 'e' (not yet coded as a jump) is 'x == k' or 'k == x',
+** for a local variable 'x' and a constant string or number 'k' (not
+** NaN), returns the position of its OP_EQ, with 'x' as its operand B;
+** otherwise returns -1
+*/
+int luaK_casetest (FuncState *fs, expdesc *e) {
+  Instruction *i;
+  const TValue *k;
+  int b, c;
+  if (e->k != VJMP || hasjumps(e)) return -1;
+  i = getjumpcontrol(fs, e->u.info);
+  if (GET_OPCODE(*i) != OP_EQ || GETARG_A(*i) != 1) return -1;
+  b = GETARG_B(*i); c = GETARG_C(*i);
+  if (ISK(b)) { int t = b; b = c; c = t; }  /* (equality is symmetric) */
+  if (ISK(b) || b >= fs->nactvar || !ISK(c)) return -1;
+  k = &fs->f->k[INDEXK(c)];
+  if (!ttisstring(k) && !ttisinteger(k) &&
+      !(ttisfloat(k) && !luai_numisnan(NULL, fltvalue(k))))
+    return -1;
+  SETARG_B(*i, b); SETARG_C(*i, c);
+  return e->u.info - 1;
+}
+
+
+/*
+** turn the 'n' case tests (see 'luaK_casetest') of the same variable
+** starting at 'pc', each one going to the next when it fails, into an
+** OP_SWITCH: its table maps the constant of each test to the offset of
+** the block after it (the first test of a constant wins), and the jump
+** after it goes where the last test goes when it fails
+*/
+void luaK_switch (FuncState *fs, int pc, int n) {
+  lua_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  Table *t;
+  int eq = pc;
+  int j;
+  if (fs->nk > MAXARG_Bx) return;  /* table would not fit in the instruction */
+  t = luaH_new(L);
+  sethvalue(L, L->top, t);  /* anchor it */
+  incr_top(L);
+  for (j = 0; j < n; j++) {
+    const TValue *k = &f->k[INDEXK(GETARG_C(f->code[eq]))];
+    TValue aux, offset;
+    lua_assert(GET_OPCODE(f->code[eq]) == OP_EQ);
+    if (ttisnil(luaH_get(t, k, &aux))) {  /* first test of 'k'? */
+      setivalue(&offset, (eq + 2) - (pc + 1));  /* its block */
+      luaH_set(L, t, k, &offset);
+    }
+    if (j < n - 1) eq = getjump(fs, eq + 1);  /* next test */
+  }
+  fixjump(fs, pc + 1, eq + 1);
+  f->code[pc] = CREATE_ABx(OP_SWITCH, GETARG_B(f->code[pc]),
+                           luaK_tableK(fs, t));
+  L->top--;
+}
+
+
+
+/*
+** superinstruction for instruction 'op' followed by 'next', or 'op'
+** itself if the pair has none (see lopcodes.h)
+*/
+static OpCode fusedop (OpCode op, OpCode next) {
+  switch (op) {
+    case OP_GETTABUP:
+      return (next == OP_GETFIELD) ? OP_GETTABUP_F
+           : (next == OP_CALL) ? OP_GETTABUP_C : op;
+    case OP_GETFIELD:
+      return (next == OP_GETFIELD) ? OP_GETFIELD_F : op;
+    case OP_SELF:
+      return (next == OP_CALL) ? OP_SELF_C : op;
+    case OP_MOVE:
+      return (next == OP_CALL) ? OP_MOVE_C : op;
+    case OP_LOADK:
+      return (next == OP_CALL) ? OP_LOADK_C : op;
+    default: return op;
+  }
+}
+
+
+/*
+** peephole pass over the finished code of a function: turn the first
+** instruction of each frequent pair (or of an append) into its
+** superinstruction
+*/
+void luaK_fuse (Proto *f) {
+  Instruction *code = f->code;
+  int pc;
+  for (pc = 0; pc + 1 < f->sizecode; pc++) {
+    if (pc + 2 < f->sizecode && isappend(f, pc, pc + 2))
+      SET_OPCODE(code[pc], OP_APPEND);
+    else
+      SET_OPCODE(code[pc], fusedop(GET_OPCODE(code[pc]),
+                                   GET_OPCODE(code[pc + 1])));
+  }
+}
+
+
+
+/*
+** {======================================================
+** Bytecode optimizer: an optional pass over the finished code of a
+** function (see 'luaK_optimize'). It works on generic opcodes and keeps
+** the code, line information and local-variable ranges consistent;
+** instructions are first marked and only removed at the end.
+** =======================================================
+*/
+
+/* per-instruction flags used by the optimizer */
+#define OTARGET		1	/* instruction is the destination of a jump */
+#define ODEAD		2	/* instruction will be removed */
+#define OLIVE		4	/* instruction is reachable */
+#define OPIN		8	/* instruction must stay where it is */
+
+
+/*
+** true if instruction 'i' skips over the next instruction on some path
+*/
+static int skipsnext (Instruction i) {
+  OpCode op = GET_OPCODE(i);
+  return (testTMode(op) || (op == OP_LOADBOOL && GETARG_C(i)));
+}
+
+
+/*
+** true if control may go from instruction 'i' elsewhere than to the next
+** instruction (errors aside)
+*/
+static int branches (Instruction i) {
+  switch (GET_OPCODE(i)) {
+    case OP_JMP: case OP_FORLOOP: case OP_FORPREP: case OP_TFORCALL:
+    case OP_TFORLOOP: case OP_SWITCH: case OP_RETURN: case OP_TAILCALL:
+      return 1;
+    default: return skipsnext(i);
+  }
+}
+
+
+/*
+** traversal of the cases of the OP_SWITCH 'i': with 'kv[0]' nil at
+** first, each call leaves the next constant in 'kv[0]' and the offset of
+** its case in 'kv[1]', and returns 0 after the last one
+*/
+#define nextcase(L,f,i,kv)	luaH_next(L, hvalue(&(f)->k[GETARG_Bx(i)]), kv)
+
+
+/*
+** move the case in 'kv' (see 'nextcase') of the OP_SWITCH 'i' to
+** 'offset'
+*/
+static void setcase (lua_State *L, Proto *f, Instruction i, TValue *kv,
+                     int offset) {
+  setivalue(&kv[1], offset);
+  luaH_set(L, hvalue(&f->k[GETARG_Bx(i)]), &kv[0], &kv[1]);
+}
+
+
+/*
+** mark every instruction that some other instruction may jump or skip to
+*/
+static void marktargets (lua_State *L, Proto *f, lu_byte *flags) {
+  Instruction *code = f->code;
+  TValue kv[2];
+  int pc;
+  for (pc = 0; pc < f->sizecode; pc++)
+    flags[pc] &= ~OTARGET;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction i = code[pc];
+    if (flags[pc] & ODEAD) continue;
+    switch (GET_OPCODE(i)) {
+      case OP_JMP: case OP_FORLOOP: case OP_TFORLOOP:
+        flags[pc + 1 + GETARG_sBx(i)] |= OTARGET;
+        break;
+      case OP_FORPREP:
+        flags[pc + 1 + GETARG_sBx(i)] |= OTARGET;
+        flags[pc + 2 + GETARG_sBx(i)] |= OTARGET;
+        break;
+      case OP_SWITCH:
+        setnilvalue(&kv[0]);
+        while (nextcase(L, f, i, kv))
+          flags[pc + 1 + ivalue(&kv[1])] |= OTARGET;
+        break;
+      default:
+        if (skipsnext(i)) flags[pc + 2] |= OTARGET;
+        break;
+    }
+  }
+}
+
+
+/*
+** true if instruction 'i' may change register 'r'
+*/
+static int writesreg (Instruction i, int r) {
+  int a = GETARG_A(i);
+  switch (GET_OPCODE(i)) {
+    case OP_LOADNIL: return (a <= r && r <= a + GETARG_B(i));
+    case OP_SELF: return (r == a || r == a + 1);
+    case OP_CONCAT:
+      return (r == a || (GETARG_B(i) <= r && r <= GETARG_C(i)));
+    case OP_CALL: case OP_TAILCALL: return (r >= a);
+    case OP_VARARG:
+      return (GETARG_B(i) == 0) ? (r >= a)
+                                : (a <= r && r <= a + GETARG_B(i) - 2);
+    case OP_TFORCALL: return (r >= a + 3);
+    case OP_FORLOOP: case OP_FORPREP: return (a <= r && r <= a + 3);
+    default: return (testAMode(GET_OPCODE(i)) && r == a);
+  }
+}
+
+
+/*
+** register of local variable 'v': the number of older variables still
+** active where it starts
+*/
+static int localreg (Proto *f, int v) {
+  int i, reg = 0;
+  int startpc = f->locvars[v].startpc;
+  for (i = 0; i < v; i++) {
+    if (f->locvars[i].startpc <= startpc && startpc < f->locvars[i].endpc)
+      reg++;
+  }
+  return reg;
+}
+
+
+/*
+** number of registers holding active local variables at 'pc'
+*/
+static int activeregs (Proto *f, int pc) {
+  int i, n = 0;
+  for (i = 0; i < f->sizelocvars; i++) {
+    if (f->locvars[i].startpc <= pc && pc < f->locvars[i].endpc)
+      n++;
+  }
+  return n;
+}
+
+
+/*
+** constants of the function being optimized: 'h' maps each constant to
+** its index in 'f->k' (as 'FuncState.h' does for the parser), and 'f->k'
+** grows geometrically, holding 'nk' constants until 'luaK_optimize'
+** trims it
+*/
+typedef struct KIndex {
+  Table *h;
+  int nk;
+} KIndex;
+
+
+/*
+** pushes the key of constant 'v' in a 'KIndex': NaN, -0 and integral
+** floats use their raw representation, as in 'luaK_numberK'
+*/
+static void pushkkey (lua_State *L, const TValue *v) {
+  lua_Integer ik;
+  luaD_checkstack(L, 1);
+  if (ttisfloat(v) && (luai_numisnan(NULL, fltvalue(v)) ||
+                       luaV_flttointeger(fltvalue(v), &ik, 0))) {
+    lua_Number r = fltvalue(v);
+    setsvalue2s(L, L->top, luaS_newlstr(L, (char *)&r, sizeof(r)));
+  }
+  else
+    setobj2s(L, L->top, v);
+  L->top++;
+}
+
+
+/*
+** find constant 'v' (not nil) in 'f->k' or add it; returns its index.
+** Values must have the same subtype and floats the same bits (0.0 and
+** -0.0 are distinct constants, as their keys differ). 'v' must be
+** anchored by the caller.
+*/
+static int addconstant (lua_State *L, Proto *f, KIndex *ki,
+                        const TValue *v) {
+  TValue aux;
+  const TValue *idx;
+  int k, oldsize;
+  pushkkey(L, v);
+  idx = luaH_get(ki->h, L->top - 1, &aux);
+  if (ttisinteger(idx)) {
+    k = cast_int(ivalue(idx));
+    if (ttisequal(&f->k[k], v) && luaV_rawequalobj(&f->k[k], v)) {
+      L->top--;
+      return k;
+    }
+    /* else a collision, as in 'addk' */
+  }
+  k = ki->nk;
+  setivalue(&aux, cast(lua_Integer, k));
+  luaH_set(L, ki->h, L->top - 1, &aux);
+  L->top--;
+  oldsize = f->sizek;
+  luaM_growvector(L, f->k, k, f->sizek, TValue, MAXARG_Ax, "constants");
+  while (oldsize < f->sizek) setnilvalue(&f->k[oldsize++]);
+  setobj(L, &f->k[k], v);
+  ki->nk++;
+  luaC_barrier(L, f, v);
+  return k;
+}
+
+
+/*
+** true if instruction 'i' may read register 'r' (a closure reads the
+** registers it captures)
+*/
+static int readsreg (Proto *f, Instruction i, int r) {
+  OpCode op = GET_OPCODE(i);
+  int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+  switch (op) {
+    case OP_SETUPVAL: case OP_TEST: case OP_SWITCH: return (r == a);
+    case OP_SETTABLE: case OP_SETFIELD: case OP_SETI:
+      if (r == a) return 1;
+      break;
+    case OP_CONCAT: return (b <= r && r <= c);
+    case OP_CALL: case OP_TAILCALL:
+      return (b == 0) ? (r >= a) : (a <= r && r < a + b);
+    case OP_RETURN:
+      return (b == 0) ? (r >= a) : (a <= r && r < a + b - 1);
+    case OP_FORLOOP: case OP_FORPREP: case OP_TFORCALL:
+      return (a <= r && r <= a + 2);
+    case OP_TFORLOOP: return (r == a + 1);
+    case OP_SETLIST: return (b == 0) ? (r >= a) : (a <= r && r <= a + b);
+    case OP_CLOSURE: {
+      Proto *np = f->p[GETARG_Bx(i)];
+      int j;
+      for (j = 0; j < np->sizeupvalues; j++)
+        if (np->upvalues[j].instack && np->upvalues[j].idx == r) return 1;
+      return 0;
+    }
+    default: break;
+  }
+  if (getOpMode(op) != iABC) return 0;
+  return (b == r && (getBMode(op) == OpArgR || getBMode(op) == OpArgK)) ||
+         (c == r && (getCMode(op) == OpArgR || getCMode(op) == OpArgK));
+}
+
+
+/*
+** instruction 'i' with every register above 'r' moved up by 'k'
+*/
+static Instruction shiftregs (Instruction i, int r, int k) {
+  OpCode op = GET_OPCODE(i);
+  int a = GETARG_A(i);
+  if (op == OP_EXTRAARG) return i;
+  if (op == OP_JMP) {  /* A - 1 is the first register to close */
+    if (a - 1 > r) SETARG_A(i, a + k);
+    return i;
+  }
+  if (a > r && op != OP_SETTABUP &&  /* (A of these is not a register) */
+      op != OP_EQ && op != OP_LT && op != OP_LE)
+    SETARG_A(i, a + k);
+  if (getOpMode(op) == iABC) {
+    int b = GETARG_B(i), c = GETARG_C(i);
+    if (b > r && (getBMode(op) == OpArgR ||
+                  (getBMode(op) == OpArgK && !ISK(b))))
+      SETARG_B(i, b + k);
+    if (c > r && (getCMode(op) == OpArgR ||
+                  (getCMode(op) == OpArgK && !ISK(c))))
+      SETARG_C(i, c + k);
+  }
+  return i;
+}
+
+
+/*
+** if 'i' reads or writes (with a value other than the table itself) a
+** field of the table in register 'r' with a constant key, returns the
+** index of the key in 'f->k'; otherwise returns -1
+*/
+static int fieldkey (Proto *f, Instruction i, int r) {
+  int b = GETARG_B(i), c = GETARG_C(i);
+  int k;
+  switch (GET_OPCODE(i)) {
+    case OP_GETTABLE: case OP_GETFIELD: case OP_GETI:
+      if (b != r || GETARG_A(i) == r || !ISK(c)) return -1;
+      k = INDEXK(c);
+      break;
+    case OP_SETTABLE: case OP_SETFIELD: case OP_SETI:
+      if (GETARG_A(i) != r || !ISK(b) || c == r) return -1;
+      k = INDEXK(b);
+      break;
+    default: return -1;
+  }
+  if (ttisstring(&f->k[k]) || ttisinteger(&f->k[k]) ||
+      (ttisfloat(&f->k[k]) && !luai_numisnan(NULL, fltvalue(&f->k[k]))))
+    return k;
+  return -1;
+}
+
+
+/*
+** make room for 'n' instructions before 'pc', fixing jump offsets (a
+** jump to 'pc' goes to the instruction that was there), line
+** information and the ranges of local variables
+*/
+static void insertcode (lua_State *L, Proto *f, int pc, int n) {
+  int size = f->sizecode;
+  TValue kv[2];
+  int j;
+  luaM_reallocvector(L, f->code, size, size + n, Instruction);
+  for (j = 0; j < size; j++) {
+    Instruction *i = &f->code[j];
+    int dest;
+    switch (GET_OPCODE(*i)) {
+      case OP_JMP: case OP_FORLOOP: case OP_TFORLOOP: case OP_FORPREP:
+        dest = j + 1 + GETARG_sBx(*i);
+        dest += (dest >= pc) ? n : 0;
+        SETARG_sBx(*i, dest - (j + (j >= pc ? n : 0) + 1));
+        break;
+      case OP_SWITCH:
+        setnilvalue(&kv[0]);
+        while (nextcase(L, f, *i, kv)) {
+          dest = j + 1 + cast_int(ivalue(&kv[1]));
+          dest += (dest >= pc) ? n : 0;
+          setcase(L, f, *i, kv, dest - (j + (j >= pc ? n : 0) + 1));
+        }
+        break;
+      default: break;
+    }
+  }
+  memmove(f->code + pc + n, f->code + pc, (size - pc) * sizeof(Instruction));
+  if (f->sizelineinfo == size) {
+    luaM_reallocvector(L, f->lineinfo, size, size + n, int);
+    memmove(f->lineinfo + pc + n, f->lineinfo + pc, (size - pc) * sizeof(int));
+    for (j = pc; j < pc + n; j++) f->lineinfo[j] = f->lineinfo[pc - 1];
+    f->sizelineinfo = size + n;
+  }
+  if (f->sizeicache == size) {
+    luaM_reallocvector(L, f->icache, size, size + n, int);
+    for (j = size; j < size + n; j++) f->icache[j] = 0;
+    f->sizeicache = size + n;
+  }
+  for (j = 0; j < f->sizelocvars; j++) {
+    if (f->locvars[j].startpc >= pc) f->locvars[j].startpc += n;
+    if (f->locvars[j].endpc >= pc) f->locvars[j].endpc += n;
+  }
+  f->sizecode = size + n;
+}
+
+
+#define MAXSCALARS	32  /* most fields of a table replaced by registers */
+
+/* first access to a field in 'scalarize' (0 when there is none before
+   a branch) */
+#define FREAD		1
+#define FSTORE		2
+
+/*
+** scalar replacement: local variable 'v', initialized with a new table,
+** whose table never escapes (it is only indexed with constant keys,
+** never stored, passed, returned, compared, captured or assigned, so it
+** cannot get a metatable either) has that table replaced by registers,
+** one per key. They take the place of 'v' and become local variables
+** themselves: the registers above 'v' in its scope move up to make
+** room, and its constructor becomes loads of the initial values. Keys
+** stored before any read or branch are not initialized. Returns whether
+** 'v' was replaced.
+*/
+static int scalarize (lua_State *L, Proto *f, KIndex *ki, int v) {
+  Instruction *code = f->code;
+  int startpc = f->locvars[v].startpc;
+  int endpc = f->locvars[v].endpc;
+  int r = localreg(f, v);
+  int keys[MAXSCALARS];
+  lu_byte first[MAXSCALARS];  /* first access to each key, if no branch */
+  Instruction init[MAXSCALARS];  /* loads of initial values */
+  int nk = 0, ninit = 0, nnil = 0;
+  int def, pc, j, k;
+  TValue kv[2];
+  Table *templ = NULL;
+  TString *name = f->locvars[v].varname;
+  for (def = startpc - 1; def >= 0; def--)  /* find its definition */
+    if (writesreg(code[def], r)) break;
+  if (def < 0 || GETARG_A(code[def]) != r) return 0;
+  if (GET_OPCODE(code[def]) == OP_NEWTEMPL)
+    templ = hvalue(&f->k[GETARG_Bx(code[def])]);
+  else if (GET_OPCODE(code[def]) != OP_NEWTABLE) return 0;
+  for (pc = 0; pc < f->sizecode; pc++) {  /* no jumps into its range */
+    Instruction i = code[pc];
+    int dest;
+    switch (GET_OPCODE(i)) {
+      case OP_JMP: case OP_FORLOOP: case OP_TFORLOOP: case OP_FORPREP:
+        dest = pc + 1 + GETARG_sBx(i);
+        break;
+      case OP_SWITCH:
+        if (def <= pc && pc < endpc) continue;
+        setnilvalue(&kv[0]);
+        while (nextcase(L, f, i, kv)) {
+          dest = pc + 1 + cast_int(ivalue(&kv[1]));
+          if (def < dest && dest < endpc) return 0;
+        }
+        continue;
+      default: continue;
+    }
+    if (def < dest && dest < endpc && !(def <= pc && pc < endpc)) return 0;
+  }
+  for (pc = def + 1; pc < endpc; pc++) {  /* does the table escape? */
+    int key = fieldkey(f, code[pc], r);
+    if (key < 0) {
+      if (writesreg(code[pc], r) || readsreg(f, code[pc], r)) return 0;
+      continue;
+    }
+    for (j = 0; j < nk; j++)
+      if (luaV_rawequalobj(&f->k[keys[j]], &f->k[key])) break;
+    if (j == nk) {  /* a new key */
+      if (nk == MAXSCALARS) return 0;
+      keys[nk++] = key;
+    }
+  }
+  k = (nk > 0) ? nk - 1 : 0;  /* number of extra registers */
+  if (f->maxstacksize + k >= MAXSTACK) return 0;
+  for (j = 0; j < nk; j++) first[j] = 0;
+  for (pc = def + 1; pc < endpc && !branches(code[pc]); pc++) {
+    int key = fieldkey(f, code[pc], r);  /* first access to a key? */
+    if (key < 0) continue;
+    for (j = 0; !luaV_rawequalobj(&f->k[keys[j]], &f->k[key]); j++) ;
+    if (first[j] == 0)  /* (only stores have 'r' in A: see 'fieldkey') */
+      first[j] = (GETARG_A(code[pc]) == r) ? FSTORE : FREAD;
+  }
+  for (j = 0; j < nk; j++) {  /* keys that must start with nil go first */
+    TValue aux;
+    int key = keys[j];
+    lu_byte fst = first[j];
+    if (fst == FSTORE ||
+        (templ != NULL && !ttisnil(luaH_get(templ, &f->k[key], &aux))))
+      continue;
+    memmove(&keys[nnil + 1], &keys[nnil], (j - nnil) * sizeof(int));
+    memmove(&first[nnil + 1], &first[nnil], j - nnil);
+    keys[nnil] = key;  /* move it after the other such keys */
+    first[nnil++] = fst;
+  }
+  if (templ != NULL) {  /* loads of the initial values of a template */
+    for (j = nnil; j < nk; j++) {
+      TValue aux;
+      const TValue *o = luaH_get(templ, &f->k[keys[j]], &aux);
+      if (ttisnil(o) || first[j] == FSTORE) continue;
+      else if (ttisboolean(o))
+        init[ninit++] = CREATE_ABC(OP_LOADBOOL, r + j, bvalue(o), 0);
+      else {
+        int kidx = addconstant(L, f, ki, o);
+        init[ninit++] = CREATE_ABx(OP_LOADK, r + j, kidx);
+      }
+    }
+  }
+  for (pc = def + 1; pc < endpc; pc++) {  /* rewrite its range */
+    Instruction i = shiftregs(code[pc], r, k);
+    int key = fieldkey(f, code[pc], r);
+    if (key >= 0) {
+      int c = GETARG_C(i);
+      for (j = 0; !luaV_rawequalobj(&f->k[keys[j]], &f->k[key]); j++) ;
+      switch (GET_OPCODE(i)) {
+        case OP_GETTABLE: case OP_GETFIELD: case OP_GETI:
+          i = CREATE_ABC(OP_MOVE, GETARG_A(i), r + j, 0);
+          break;
+        default:  /* a store */
+          i = ISK(c) ? CREATE_ABx(OP_LOADK, r + j, INDEXK(c))
+                     : CREATE_ABC(OP_MOVE, r + j, c, 0);
+          break;
+      }
+    }
+    else if (GET_OPCODE(i) == OP_CLOSURE) {
+      Proto *np = f->p[GETARG_Bx(i)];
+      for (j = 0; j < np->sizeupvalues; j++)
+        if (np->upvalues[j].instack && np->upvalues[j].idx > r)
+          np->upvalues[j].idx += k;
+    }
+    code[pc] = i;
+  }
+  f->maxstacksize += k;
+  if (nnil > 0 || nk == 0) {  /* some keys start with nil? */
+    code[def] = CREATE_ABC(OP_LOADNIL, r, (nnil > 0) ? nnil - 1 : 0, 0);
+    pc = def + 1;
+  }
+  else if (ninit == 0) {  /* all keys are set before use? */
+    code[def] = CREATE_ABx(OP_JMP, 0, 0);  /* (removed by 'markuseless') */
+    SETARG_sBx(code[def], 0);
+    pc = def + 1;
+  }
+  else pc = def;  /* a load takes the place of the constructor */
+  if (pc + ninit > def + 1)
+    insertcode(L, f, def + 1, pc + ninit - (def + 1));
+  for (j = 0; j < ninit; j++)
+    f->code[pc + j] = init[j];
+  if (nk > 1) {  /* registers for the other keys are new variables */
+    luaM_reallocvector(L, f->locvars, f->sizelocvars, f->sizelocvars + k,
+                       LocVar);
+    memmove(f->locvars + v + 1 + k, f->locvars + v + 1,
+            (f->sizelocvars - v - 1) * sizeof(LocVar));
+    f->sizelocvars += k;
+  }
+  for (j = nk - 1; j >= 0; j--) {  /* name them after the fields */
+    const TValue *key = &f->k[keys[j]];
+    if (ttisstring(key))
+      luaO_pushfstring(L, "%s.%s", getstr(name), svalue(key));
+    else
+      luaO_pushfstring(L, "%s[%f]", getstr(name), nvalue(key));
+    f->locvars[v + j].startpc = f->locvars[v].startpc;
+    f->locvars[v + j].endpc = f->locvars[v].endpc;
+    f->locvars[v + j].varname = rawtsvalue(L->top - 1);
+    luaC_objbarrier(L, f, rawtsvalue(L->top - 1));
+    L->top--;
+  }
+  return 1;
+}
+
+
+/*
+** whether local variable 'v' holds a field of a table replaced by
+** registers: 'scalarize' names it after the table and the key
+*/
+static int isfieldvar (Proto *f, int v) {
+  return (strpbrk(getstr(f->locvars[v].varname), ".[") != NULL);
+}
+
+
+/*
+** constant propagation: a local variable initialized with LOADK and
+** never assigned (nor captured by a closure) in its scope is replaced
+** by the constant wherever an instruction reads it. Error messages name
+** fields replaced by registers after their variables (see 'getobjname'
+** in ldebug.c), so those are only replaced where a number constant
+** cannot be named by an error: in arithmetic and comparisons.
+*/
+static int propagate (Proto *f, lu_byte *flags) {
+  Instruction *code = f->code;
+  int changed = 0;
+  int v;
+  for (v = 0; v < f->sizelocvars; v++) {
+    int startpc = f->locvars[v].startpc;
+    int endpc = f->locvars[v].endpc;
+    int r = localreg(f, v);
+    int field = isfieldvar(f, v);
+    int def, pc, kidx;
+    for (def = startpc - 1; def >= 0; def--) {  /* find its definition */
+      if (flags[def + 1] & OTARGET) break;  /* value may come from elsewhere */
+      if (!(flags[def] & ODEAD) && writesreg(code[def], r)) break;
+    }
+    if (def < 0 || (flags[def + 1] & OTARGET) ||
+        GET_OPCODE(code[def]) != OP_LOADK || GETARG_A(code[def]) != r)
+      continue;
+    kidx = GETARG_Bx(code[def]);
+    if (field && !ttisnumber(&f->k[kidx])) continue;
+    for (pc = startpc; pc < endpc; pc++) {  /* is it really constant? */
+      Instruction i = code[pc];
+      if (flags[pc] & ODEAD) continue;
+      if (writesreg(i, r)) break;
+      if (GET_OPCODE(i) == OP_CLOSURE) {
+        Proto *np = f->p[GETARG_Bx(i)];
+        int j;
+        for (j = 0; j < np->sizeupvalues; j++)
+          if (np->upvalues[j].instack && np->upvalues[j].idx == r) break;
+        if (j < np->sizeupvalues) break;  /* captured */
+      }
+    }
+    if (pc < endpc) continue;
+    for (pc = startpc; pc < endpc; pc++) {  /* replace its uses */
+      Instruction *i = &code[pc];
+      OpCode op = GET_OPCODE(*i);
+      if (flags[pc] & ODEAD) continue;
+      if (field && !((OP_ADD <= op && op <= OP_POW) ||
+                     (OP_EQ <= op && op <= OP_LE)))
+        continue;  /* keep its name */
+      if (op == OP_MOVE && GETARG_B(*i) == r) {
+        *i = CREATE_ABx(OP_LOADK, GETARG_A(*i), kidx);
+        changed = 1;
+      }
+      else if (getOpMode(op) == iABC && kidx <= MAXINDEXRK) {
+        if (getBMode(op) == OpArgK && GETARG_B(*i) == r) {
+          SETARG_B(*i, RKASK(kidx));
+          changed = 1;
+        }
+        if (getCMode(op) == OpArgK && GETARG_C(*i) == r) {
+          SETARG_C(*i, RKASK(kidx));
+          changed = 1;
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+
+/*
+** fold arithmetic on two numeric constants and concatenations of
+** constants just loaded into consecutive registers
+*/
+static int fold (lua_State *L, Proto *f, KIndex *ki, lu_byte *flags) {
+  Instruction *code = f->code;
+  int changed = 0;
+  int pc;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction i = code[pc];
+    OpCode op = GET_OPCODE(i);
+    int k;
+    if (flags[pc] & ODEAD) continue;
+    if (OP_ADD <= op && op <= OP_POW) {
+      TValue res;
+      int b = GETARG_B(i), c = GETARG_C(i);
+      if (!ISK(b) || !ISK(c) || !ttisnumber(&f->k[INDEXK(b)]) ||
+          !ttisnumber(&f->k[INDEXK(c)]))
+        continue;
+      if ((op == OP_DIV || op == OP_MOD) && nvalue(&f->k[INDEXK(c)]) == 0)
+        continue;  /* do not attempt to divide by 0 */
+      luaO_arith(op - OP_ADD + LUA_OPADD, &f->k[INDEXK(b)],
+                 &f->k[INDEXK(c)], &res);
+      k = addconstant(L, f, ki, &res);
+    }
+    else if (op == OP_CONCAT) {
+      int b = GETARG_B(i), c = GETARG_C(i);
+      int n = c - b + 1;
+      int j;
+      if (pc < n) continue;
+      for (j = 0; j < n; j++) {  /* LOADK into b..c right before? */
+        Instruction ld = code[pc - n + j];
+        if ((flags[pc - n + j] & (ODEAD | OPIN)) ||
+            (j > 0 && (flags[pc - n + j] & OTARGET)) ||
+            GET_OPCODE(ld) != OP_LOADK || GETARG_A(ld) != b + j)
+          break;
+        if (!ttisstring(&f->k[GETARG_Bx(ld)]) &&
+            !ttisnumber(&f->k[GETARG_Bx(ld)]))
+          break;
+      }
+      if (j < n || (flags[pc] & OTARGET)) continue;
+      luaD_checkstack(L, n);
+      for (j = 0; j < n; j++) {
+        setobj2s(L, L->top, &f->k[GETARG_Bx(code[pc - n + j])]);
+        L->top++;
+      }
+      luaV_concat(L, n);  /* same conversions as at run time */
+      k = addconstant(L, f, ki, L->top - 1);  /* result is anchored */
+      L->top--;
+      for (j = 0; j < n; j++)
+        flags[pc - n + j] |= ODEAD;
+    }
+    else continue;
+    if (k > MAXARG_Bx) continue;
+    code[pc] = CREATE_ABx(OP_LOADK, GETARG_A(i), k);
+    changed = 1;
+  }
+  return changed;
+}
+
+
+/*
+** jump threading: a jump to an unconditional jump goes straight to
+** the final destination
+*/
+static void threadjumps (Proto *f) {
+  Instruction *code = f->code;
+  int pc;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction i = code[pc];
+    int dest, count = 0;
+    if (GET_OPCODE(i) != OP_JMP) continue;
+    dest = pc + 1 + GETARG_sBx(i);
+    while (GET_OPCODE(code[dest]) == OP_JMP && GETARG_A(code[dest]) == 0 &&
+           count++ < f->sizecode)  /* (avoid looping on 'goto' cycles) */
+      dest += 1 + GETARG_sBx(code[dest]);
+    SETARG_sBx(code[pc], dest - (pc + 1));
+  }
+}
+
+
+/*
+** mark reachable instructions, starting at the entry point
+*/
+static void markreachable (lua_State *L, Proto *f, lu_byte *flags,
+                           int *stack) {
+  Instruction *code = f->code;
+  TValue kv[2];
+  int n = 0;
+  stack[n++] = 0;
+  flags[0] |= OLIVE;
+  while (n > 0) {
+    int pc = stack[--n];
+    Instruction i = code[pc];
+    int succ[3];
+    int ns = 0, j;
+    switch (GET_OPCODE(i)) {
+      case OP_JMP:
+        succ[ns++] = pc + 1 + GETARG_sBx(i);
+        break;
+      case OP_RETURN:
+        break;
+      case OP_FORPREP:
+        succ[ns++] = pc + 1;
+        succ[ns++] = pc + 1 + GETARG_sBx(i);
+        succ[ns++] = pc + 2 + GETARG_sBx(i);
+        break;
+      case OP_FORLOOP: case OP_TFORLOOP:
+        succ[ns++] = pc + 1;
+        succ[ns++] = pc + 1 + GETARG_sBx(i);
+        break;
+      case OP_SWITCH:
+        setnilvalue(&kv[0]);
+        while (nextcase(L, f, i, kv)) {  /* its cases */
+          j = pc + 1 + cast_int(ivalue(&kv[1]));
+          if (!(flags[j] & OLIVE)) {
+            flags[j] |= OLIVE;
+            stack[n++] = j;
+          }
+        }
+        succ[ns++] = pc + 1;
+        break;
+      case OP_LOADKX:
+        flags[pc + 1] |= OLIVE;  /* its EXTRAARG */
+        succ[ns++] = pc + 2;
+        break;
+      case OP_SETLIST:
+        if (GETARG_C(i) == 0) {
+          flags[pc + 1] |= OLIVE;  /* its EXTRAARG */
+          succ[ns++] = pc + 2;
+        }
+        else succ[ns++] = pc + 1;
+        break;
+      case OP_LOADBOOL:
+        if (GETARG_C(i)) {
+          flags[pc + 1] |= OPIN;  /* keep the skipped slot */
+          succ[ns++] = pc + 2;
+        }
+        else succ[ns++] = pc + 1;
+        break;
+      default:
+        succ[ns++] = pc + 1;
+        if (testTMode(GET_OPCODE(i))) succ[ns++] = pc + 2;
+        break;
+    }
+    for (j = 0; j < ns; j++) {
+      if (succ[j] < f->sizecode && !(flags[succ[j]] & OLIVE)) {
+        flags[succ[j]] |= OLIVE;
+        stack[n++] = succ[j];
+      }
+    }
+  }
+}
+
+
+/*
+** mark instructions that can go: unreachable code, jumps to the next
+** instruction, moves into the same register, and moves whose source is
+** a temporary just computed (the computation then targets the move's
+** destination directly)
+*/
+static void markuseless (Proto *f, lu_byte *flags) {
+  Instruction *code = f->code;
+  int pc;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction i = code[pc];
+    if (flags[pc] & (ODEAD | OPIN)) continue;
+    if (!(flags[pc] & OLIVE)) {
+      if (pc < f->sizecode - 1)  /* keep final return */
+        flags[pc] |= ODEAD;
+    }
+    else if (GET_OPCODE(i) == OP_JMP) {
+      if (GETARG_A(i) == 0 && GETARG_sBx(i) == 0 &&
+          !(pc > 0 && skipsnext(code[pc - 1])))
+        flags[pc] |= ODEAD;
+    }
+    else if (GET_OPCODE(i) == OP_MOVE) {
+      int t = GETARG_B(i);
+      if (t == GETARG_A(i))
+        flags[pc] |= ODEAD;
+      else if (pc > 0 && (flags[pc - 1] & (OLIVE | ODEAD)) == OLIVE &&
+               !(flags[pc] & OTARGET) && GETARG_A(code[pc - 1]) == t &&
+               t >= activeregs(f, pc) && t >= activeregs(f, pc + 1)) {
+        switch (GET_OPCODE(code[pc - 1])) {
+          case OP_MOVE: case OP_LOADK: case OP_GETUPVAL:
+          case OP_GETTABUP: case OP_GETTABLE: case OP_GETFIELD:
+          case OP_GETI: case OP_ADD: case OP_SUB: case OP_MUL:
+          case OP_DIV: case OP_MOD: case OP_POW: case OP_UNM:
+          case OP_NOT: case OP_LEN: case OP_CONCAT: case OP_CLOSURE:
+            SETARG_A(code[pc - 1], GETARG_A(i));
+            flags[pc] |= ODEAD;
+            break;
+          default: break;
+        }
+      }
+    }
+  }
+}
+
+
+/*
+** remove dead instructions, fixing jump offsets, line information and
+** the ranges of local variables; 'newpc' maps each old position to the
+** next surviving instruction
+*/
+static void compact (lua_State *L, Proto *f, lu_byte *flags, int *newpc) {
+  Instruction *code = f->code;
+  TValue kv[2];
+  int n = f->sizecode;
+  int pc, npc = 0;
+  for (pc = 0; pc < n; pc++) {
+    newpc[pc] = npc;
+    if (!(flags[pc] & ODEAD)) npc++;
+  }
+  newpc[n] = npc;
+  if (npc == n) return;  /* nothing to remove */
+  for (pc = 0; pc < n; pc++) {
+    Instruction i = code[pc];
+    if (flags[pc] & ODEAD) continue;
+    switch (GET_OPCODE(i)) {
+      case OP_JMP: case OP_FORLOOP: case OP_TFORLOOP: case OP_FORPREP: {
+        int dest = newpc[pc + 1 + GETARG_sBx(i)];
+        SETARG_sBx(i, dest - (newpc[pc] + 1));
+        break;
+      }
+      case OP_SWITCH:
+        setnilvalue(&kv[0]);
+        while (nextcase(L, f, i, kv)) {
+          int dest = newpc[pc + 1 + cast_int(ivalue(&kv[1]))];
+          setcase(L, f, i, kv, dest - (newpc[pc] + 1));
+        }
+        break;
+      default: break;
+    }
+    code[newpc[pc]] = i;
+    if (f->lineinfo && pc < f->sizelineinfo)
+      f->lineinfo[newpc[pc]] = f->lineinfo[pc];
+  }
+  for (pc = 0; pc < f->sizelocvars; pc++) {
+    f->locvars[pc].startpc = newpc[f->locvars[pc].startpc];
+    f->locvars[pc].endpc = newpc[f->locvars[pc].endpc];
+  }
+  luaM_reallocvector(L, f->code, n, npc, Instruction);
+  f->sizecode = npc;
+  if (f->sizelineinfo == n) {
+    luaM_reallocvector(L, f->lineinfo, n, npc, int);
+    f->sizelineinfo = npc;
+  }
+  if (f->sizeicache == n) {
+    luaM_reallocvector(L, f->icache, n, npc, int);
+    f->sizeicache = npc;
+  }
+}
+
+
+/*
+** remove the constants that no instruction uses any more (keys and
+** templates of tables replaced by registers, operands of folded
+** operations), renumbering the others; 'map' has room for all of them
+*/
+static void dropconstants (Proto *f, KIndex *ki, int *map) {
+  Instruction *code = f->code;
+  int pc, k, nk = 0;
+  for (k = 0; k < ki->nk; k++) map[k] = -1;
+  for (pc = 0; pc < f->sizecode; pc++) {  /* mark used constants */
+    Instruction i = code[pc];
+    OpCode op = GET_OPCODE(i);
+    if (op == OP_LOADKX)
+      map[GETARG_Ax(code[pc + 1])] = 0;
+    else if (getOpMode(op) == iABx && getBMode(op) == OpArgK)
+      map[GETARG_Bx(i)] = 0;
+    else if (getOpMode(op) == iABC) {
+      if (getBMode(op) == OpArgK && ISK(GETARG_B(i)))
+        map[INDEXK(GETARG_B(i))] = 0;
+      if (getCMode(op) == OpArgK && ISK(GETARG_C(i)))
+        map[INDEXK(GETARG_C(i))] = 0;
+    }
+  }
+  for (k = 0; k < ki->nk; k++) {  /* compact them */
+    if (map[k] < 0) continue;
+    map[k] = nk;
+    f->k[nk] = f->k[k];  /* (moves a constant down the array) */
+    nk++;
+  }
+  if (nk == ki->nk) return;  /* nothing removed */
+  for (k = nk; k < ki->nk; k++)
+    setnilvalue(&f->k[k]);
+  ki->nk = nk;
+  for (pc = 0; pc < f->sizecode; pc++) {  /* renumber them */
+    Instruction *i = &code[pc];
+    OpCode op = GET_OPCODE(*i);
+    if (op == OP_LOADKX)
+      SETARG_Ax(code[pc + 1], map[GETARG_Ax(code[pc + 1])]);
+    else if (getOpMode(op) == iABx && getBMode(op) == OpArgK)
+      SETARG_Bx(*i, map[GETARG_Bx(*i)]);
+    else if (getOpMode(op) == iABC) {
+      if (getBMode(op) == OpArgK && ISK(GETARG_B(*i)))
+        SETARG_B(*i, RKASK(map[INDEXK(GETARG_B(*i))]));
+      if (getCMode(op) == OpArgK && ISK(GETARG_C(*i)))
+        SETARG_C(*i, RKASK(map[INDEXK(GETARG_C(*i))]));
+    }
+  }
+}
+
+
+/*
+** optimize the code of 'f' and of all functions nested in it. Local
+** tables that do not escape are replaced by registers, local variables
+** holding constants are propagated into their uses, arithmetic and
+** concatenation on constants are folded, jumps are threaded, and dead
+** code, redundant moves and unused constants are removed.
+*/
+void luaK_optimize (lua_State *L, Proto *f) {
+  int n = f->sizecode;
+  lu_byte *flags;
+  int *aux;
+  int pc;
+  KIndex ki;
+  TValue v;
+  for (pc = 0; pc < f->sizep; pc++)
+    luaK_optimize(L, f->p[pc]);
+  if (n == 0) return;
+  ki.h = luaH_new(L);
+  ki.nk = f->sizek;
+  luaD_checkstack(L, 1);
+  sethvalue2s(L, L->top, ki.h);  /* anchor it */
+  L->top++;
+  for (pc = 0; pc < f->sizek; pc++) {  /* index the constants */
+    if (ttisnil(&f->k[pc])) continue;
+    pushkkey(L, &f->k[pc]);
+    setivalue(&v, cast(lua_Integer, pc));
+    luaH_set(L, ki.h, L->top - 1, &v);
+    L->top--;
+  }
+  for (pc = 0; pc < n; pc++)  /* work on generic opcodes */
+    SET_OPCODE(f->code[pc], GET_GENOPCODE(f->code[pc]));
+  for (pc = 0; pc < f->sizelocvars; pc++)
+    scalarize(L, f, &ki, pc);
+  n = f->sizecode;
+  flags = luaM_newvector(L, n + 1, lu_byte);
+  aux = luaM_newvector(L, n + 1, int);
+  for (pc = 0; pc <= n; pc++) flags[pc] = 0;
+  marktargets(L, f, flags);
+  while (propagate(f, flags) | fold(L, f, &ki, flags))
+    ;  /* repeat until nothing changes */
+  threadjumps(f);
+  marktargets(L, f, flags);
+  markreachable(L, f, flags, aux);
+  markuseless(f, flags);
+  compact(L, f, flags, aux);
+  luaM_freearray(L, flags, n + 1);
+  luaM_freearray(L, aux, n + 1);
+  n = ki.nk;
+  aux = luaM_newvector(L, n, int);
+  dropconstants(f, &ki, aux);
+  luaM_freearray(L, aux, n);
+  luaK_fuse(f);
+  luaM_reallocvector(L, f->k, f->sizek, ki.nk, TValue);  /* trim it */
+  f->sizek = ki.nk;
+  L->top--;  /* remove 'ki.h' */
+}
+
+/* }====================================================== */
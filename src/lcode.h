@@ -53,6 +53,8 @@ LUAI_FUNC void luaK_reserveregs (FuncState *fs, int n);
 LUAI_FUNC void luaK_checkstack (FuncState *fs, int n);
 LUAI_FUNC int luaK_stringK (FuncState *fs, TString *s);
 LUAI_FUNC int luaK_numberK (FuncState *fs, lua_Number r);
+LUAI_FUNC int luaK_intK (FuncState *fs, lua_Integer i);
+LUAI_FUNC int luaK_tableK (FuncState *fs, Table *t);
 LUAI_FUNC void luaK_dischargevars (FuncState *fs, expdesc *e);
 LUAI_FUNC int luaK_exp2anyreg (FuncState *fs, expdesc *e);
 LUAI_FUNC void luaK_exp2anyregup (FuncState *fs, expdesc *e);
@@ -78,6 +80,11 @@ LUAI_FUNC void luaK_infix (FuncState *fs, BinOpr op, expdesc *v);
 LUAI_FUNC void luaK_posfix (FuncState *fs, BinOpr op, expdesc *v1,
                             expdesc *v2, int line);
 LUAI_FUNC void luaK_setlist (FuncState *fs, int base, int nelems, int tostore);
+LUAI_FUNC void luaK_append (FuncState *fs, int pc);
+LUAI_FUNC int luaK_casetest (FuncState *fs, expdesc *e);
+LUAI_FUNC void luaK_switch (FuncState *fs, int pc, int n);
+LUAI_FUNC void luaK_fuse (Proto *f);
+LUAI_FUNC void luaK_optimize (lua_State *L, Proto *f);
 
 
 #endif
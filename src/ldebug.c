@@ -343,7 +343,7 @@ static int findsetreg (Proto *p, int lastpc, int reg) {
   int jmptarget = 0;  /* any code before this address is conditional */
   for (pc = 0; pc < lastpc; pc++) {
     Instruction i = p->code[pc];
-    OpCode op = GET_OPCODE(i);
+    OpCode op = GET_GENOPCODE(i);
     int a = GETARG_A(i);
     switch (op) {
       case OP_LOADNIL: {
@@ -392,13 +392,19 @@ static const char *getobjname (Proto *p, int lastpc, int reg,
                                const char **name) {
   int pc;
   *name = luaF_getlocalname(p, reg + 1, lastpc);
-  if (*name)  /* is a local? */
+  if (*name) {  /* is a local? */
+    const char *dot = strpbrk(*name, ".[");
+    if (dot != NULL) {  /* a field of a table replaced by registers? */
+      *name = (*dot == '.') ? dot + 1 : "?";  /* (see 'scalarize' in lcode.c) */
+      return "field";
+    }
     return "local";
+  }
   /* else try symbolic execution */
   pc = findsetreg(p, lastpc, reg);
   if (pc != -1) {  /* could find instruction? */
     Instruction i = p->code[pc];
-    OpCode op = GET_OPCODE(i);
+    OpCode op = GET_GENOPCODE(i);
     switch (op) {
       case OP_MOVE: {
         int b = GETARG_B(i);  /* move from 'b' to 'a' */
@@ -407,10 +413,12 @@ static const char *getobjname (Proto *p, int lastpc, int reg,
         break;
       }
       case OP_GETTABUP:
-      case OP_GETTABLE: {
+      case OP_GETTABLE:
+      case OP_GETFIELD:
+      case OP_GETI: {
         int k = GETARG_C(i);  /* key index */
         int t = GETARG_B(i);  /* table index */
-        const char *vn = (op == OP_GETTABLE)  /* name of indexed variable */
+        const char *vn = (op != OP_GETTABUP)  /* name of indexed variable */
                          ? luaF_getlocalname(p, t + 1, pc)
                          : upvalname(p, t);
         kname(p, pc, k, name);
@@ -447,7 +455,7 @@ static const char *getfuncname (lua_State *L, CallInfo *ci, const char **name) {
   Proto *p = ci_func(ci)->p;  /* calling function */
   int pc = currentpc(ci);  /* calling instruction index */
   Instruction i = p->code[pc];  /* calling instruction */
-  switch (GET_OPCODE(i)) {
+  switch (GET_GENOPCODE(i)) {
     case OP_CALL:
     case OP_TAILCALL:  /* get function name */
       return getobjname(p, pc, GETARG_A(i), name);
@@ -458,9 +466,13 @@ static const char *getfuncname (lua_State *L, CallInfo *ci, const char **name) {
     /* all other instructions can call only through metamethods */
     case OP_SELF:
     case OP_GETTABUP:
-    case OP_GETTABLE: tm = TM_INDEX; break;
+    case OP_GETTABLE:
+    case OP_GETFIELD:
+    case OP_GETI: tm = TM_INDEX; break;
     case OP_SETTABUP:
-    case OP_SETTABLE: tm = TM_NEWINDEX; break;
+    case OP_SETTABLE:
+    case OP_SETFIELD:
+    case OP_SETI: tm = TM_NEWINDEX; break;
     case OP_EQ: tm = TM_EQ; break;
     case OP_ADD: tm = TM_ADD; break;
     case OP_SUB: tm = TM_SUB; break;
@@ -554,8 +566,7 @@ l_noret luaG_ordererror (lua_State *L, const TValue *p1, const TValue *p2) {
 }
 
 
-static void addinfo (lua_State *L, const char *msg) {
-  CallInfo *ci = L->ci;
+static void addinfo (lua_State *L, CallInfo *ci, const char *msg) {
   if (isLua(ci)) {  /* is Lua code? */
     char buff[LUA_IDSIZE];  /* add file:line information */
     int line = currentline(ci);
@@ -586,8 +597,30 @@ l_noret luaG_errormsg (lua_State *L) {
 l_noret luaG_runerror (lua_State *L, const char *fmt, ...) {
   va_list argp;
   va_start(argp, fmt);
-  addinfo(L, luaO_pushvfstring(L, fmt, argp));
+  addinfo(L, L->ci, luaO_pushvfstring(L, fmt, argp));
   va_end(argp);
   luaG_errormsg(L);
 }
 
+
+/*
+** raises the error 'luaL_argerror' would raise for argument 'narg' of
+** the running C function not being of type 'tag', for the functions
+** of the core (which do not use lauxlib): the function is named as its
+** caller calls it, or 'fname' when the caller gives no name
+*/
+/* 核心中的C函数的参数类型错误,格式与luaL_argerror相同 */
+l_noret luaG_argerror (lua_State *L, int narg, int tag, const char *fname) {
+  CallInfo *ci = L->ci;
+  StkId o = ci->func + narg;
+  const char *name = NULL;
+  const char *msg = luaO_pushfstring(L, "%s expected, got %s",
+                        ttypename(tag), (o < L->top) ? objtypename(o)
+                                                     : "no value");
+  if (!(ci->callstatus & CIST_TAIL) && isLua(ci->previous))
+    getfuncname(L, ci->previous, &name);
+  msg = luaO_pushfstring(L, "bad argument #%d to " LUA_QS " (%s)", narg,
+                            (name != NULL) ? name : fname, msg);
+  addinfo(L, ci->previous, msg);  /* position of the caller */
+  luaG_errormsg(L);
+}
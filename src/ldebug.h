@@ -32,6 +32,8 @@ LUAI_FUNC l_noret luaG_aritherror (lua_State *L, const TValue *p1,
 LUAI_FUNC l_noret luaG_ordererror (lua_State *L, const TValue *p1,
                                                  const TValue *p2);
 LUAI_FUNC l_noret luaG_runerror (lua_State *L, const char *fmt, ...);
+LUAI_FUNC l_noret luaG_argerror (lua_State *L, int narg, int tag,
+                                               const char *fname);
 LUAI_FUNC l_noret luaG_errormsg (lua_State *L);
 
 #endif
@@ -15,10 +15,12 @@
 #include "lua.h"
 
 #include "lapi.h"
+#include "lcode.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lopcodes.h"
@@ -385,6 +387,7 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
       ci->callstatus = CIST_LUA;
       L->top = ci->top;
       luaC_checkGC(L);  /* stack grow uses memory */
+      luaJ_hot(L, p);  /* compile it if it is called often */
       if (L->hookmask & LUA_MASKCALL)
         callhook(L, ci);
       return 0;
@@ -719,6 +722,9 @@ static void f_parser (lua_State *L, void *ud) {
     checkmode(L, p->mode, "text");
 		/* 进行脚本语法分析 */
     cl = luaY_parser(L, p->z, &p->buff, &p->dyd, p->name, c);
+		/* 模式中有'o'则优化字节码 */
+    if (p->mode && strchr(p->mode, 'o'))  /* optimize it? */
+      luaK_optimize(L, cl->l.p);
   }
   lua_assert(cl->l.nupvalues == cl->l.p->sizeupvalues);
   for (i = 0; i < cl->l.nupvalues; i++) {  /* initialize upvalues */
@@ -12,7 +12,9 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "ltable.h"
 #include "lundump.h"
 
 typedef struct {
@@ -52,6 +54,11 @@ static void DumpNumber(lua_Number x, DumpState* D)
  DumpVar(x,D);
 }
 
+static void DumpInteger(lua_Integer x, DumpState* D)
+{
+ DumpVar(x,D);
+}
+
 static void DumpVector(const void* b, int n, size_t size, DumpState* D)
 {
  DumpInt(n,D);
@@ -73,34 +80,82 @@ static void DumpString(const TString* s, DumpState* D)
  }
 }
 
-#define DumpCode(f,D)	 DumpVector(f->code,f->sizecode,sizeof(Instruction),D)
+static void DumpCode(const Proto* f, DumpState* D)
+{
+ int i,n=f->sizecode;
+ DumpInt(n,D);
+ for (i=0; i<n; i++)			/* undo quickening (see lopcodes.h) */
+ {
+  Instruction c=f->code[i];
+  if (isquickop(GET_OPCODE(c))) SET_OPCODE(c,GET_GENOPCODE(c));
+  DumpVar(c,D);
+ }
+}
 
 static void DumpFunction(const Proto* f, DumpState* D);
+static void DumpConstant(const TValue* o, DumpState* D);
 
-static void DumpConstants(const Proto* f, DumpState* D)
+static void DumpSwitch(Table* h, DumpState* D)
 {
- int i,n=f->sizek;
+ TValue kv[2];				/* a case and its offset */
+ int n=0;
+ setnilvalue(&kv[0]);
+ while (luaH_next(D->L,h,kv)) n++;
  DumpInt(n,D);
- for (i=0; i<n; i++)
+ setnilvalue(&kv[0]);
+ while (luaH_next(D->L,h,kv))
  {
-  const TValue* o=&f->k[i];
-  DumpChar(ttypenv(o),D);
-  switch (ttypenv(o))
-  {
-   case LUA_TNIL:
+  DumpConstant(&kv[0],D);
+  DumpInt(cast_int(ivalue(&kv[1])),D);
+ }
+}
+
+static void DumpConstant(const TValue* o, DumpState* D)
+{
+ int t=ttisnumber(o) ? ttype(o) : ttypenv(o);	/* keep number subtype */
+ if (t==LUA_TTABLE && hvalue(o)->fields==NULL) t=LUAC_TSWITCH;
+ DumpChar(t,D);
+ switch (t)
+ {
+  case LUA_TNIL:
 	break;
-   case LUA_TBOOLEAN:
+  case LUA_TBOOLEAN:
 	DumpChar(bvalue(o),D);
 	break;
-   case LUA_TNUMBER:
-	DumpNumber(nvalue(o),D);
+  case LUA_TNUMFLT:
+	DumpNumber(fltvalue(o),D);
 	break;
-   case LUA_TSTRING:
+  case LUA_TNUMINT:
+	DumpInteger(ivalue(o),D);
+	break;
+  case LUA_TSTRING:
 	DumpString(rawtsvalue(o),D);
 	break;
-    default: lua_assert(0);
+  case LUA_TTABLE:			/* constructor template */
+  {
+	const Table* h=hvalue(o);
+	int i,n=h->fields->shape->nkeys;
+	DumpInt(h->sizearray,D);
+	DumpInt(n,D);
+	for (i=0; i<n; i++)
+	{
+	 DumpString(h->fields->shape->keys[i],D);
+	 DumpConstant(&h->fields->v[i],D);
+	}
+	break;
   }
+  case LUAC_TSWITCH:
+	DumpSwitch(hvalue(o),D);
+	break;
+  default: lua_assert(0);
  }
+}
+
+static void DumpConstants(const Proto* f, DumpState* D)
+{
+ int i,n=f->sizek;
+ DumpInt(n,D);
+ for (i=0; i<n; i++) DumpConstant(&f->k[i],D);
  n=f->sizep;
  DumpInt(n,D);
  for (i=0; i<n; i++) DumpFunction(f->p[i],D);
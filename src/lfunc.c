@@ -14,6 +14,7 @@
 
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -118,6 +119,8 @@ Proto *luaF_newproto (lua_State *L) {
   f->code = NULL;
   f->cache = NULL;
   f->sizecode = 0;
+  f->icache = NULL;
+  f->sizeicache = 0;
   f->lineinfo = NULL;
   f->sizelineinfo = 0;
   f->upvalues = NULL;
@@ -130,17 +133,36 @@ Proto *luaF_newproto (lua_State *L) {
   f->linedefined = 0;
   f->lastlinedefined = 0;
   f->source = NULL;
+  f->jit = NULL;
+  f->native = NULL;
+  f->hotcount = LUAI_JITHOT;
   return f;
 }
 
 
+/*
+** create the inline caches of a prototype, once its code is final
+*/
+/* 代码确定之后,为函数原型创建内联缓存 */
+void luaF_newicache (lua_State *L, Proto *f) {
+  int i;
+  lua_assert(f->icache == NULL);
+  f->icache = luaM_newvector(L, f->sizecode, int);
+  f->sizeicache = f->sizecode;
+  for (i = 0; i < f->sizeicache; i++)
+    f->icache[i] = 0;  /* any slot is valid: it is checked on use */
+}
+
+
 void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->code, f->sizecode);
+  luaM_freearray(L, f->icache, f->sizeicache);
   luaM_freearray(L, f->p, f->sizep);
   luaM_freearray(L, f->k, f->sizek);
   luaM_freearray(L, f->lineinfo, f->sizelineinfo);
   luaM_freearray(L, f->locvars, f->sizelocvars);
   luaM_freearray(L, f->upvalues, f->sizeupvalues);
+  luaJ_free(L, f);
   luaM_free(L, f);
 }
 
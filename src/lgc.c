@@ -89,15 +89,32 @@ static void reallymarkobject (global_State *g, GCObject *o);
 
 
 /*
-** one after last element in a hash array
+** link table 'h' into list pointed by 'p'
 */
-#define gnodelast(h)	gnode(h, cast(size_t, sizenode(h)))
+#define linktable(h,p)	((h)->gclist = *(p), *(p) = obj2gco(h))
 
 
 /*
-** link table 'h' into list pointed by 'p'
+** returns the next node holding a key in table 'h' (NULL if none), with
+** '*i' counting the nodes of its hash part and then, while it grows
+** incrementally, those of its old part
 */
-#define linktable(h,p)	((h)->gclist = *(p), *(p) = obj2gco(h))
+/* 返回表h中下一个持有健的节点,*i先计数新节点,再计数旧节点 */
+static Node *nextnode (Table *h, int *i) {
+  int size = sizenode(h);
+  while (*i < size) {
+    int k = (*i)++;
+    if (ctrlisfull(gctrl(h)[k])) return gnode(h, k);
+  }
+  if (isrehashing(h)) {
+    const lu_byte *ctrl = goldctrl(h);
+    while (*i - size < sizeoldnode(h)) {
+      int k = (*i)++ - size;
+      if (ctrlisfull(ctrl[k])) return goldnode(h, k);
+    }
+  }
+  return NULL;
+}
 
 
 /*
@@ -264,6 +281,15 @@ static void reallymarkobject (global_State *g, GCObject *o) {
       size = sizeudata(gco2u(o));
       break;
     }
+    case LUA_TSHAPE: {
+      Shape *sh = gco2sh(o);
+      int i;
+      for (i = 0; i < sh->nkeys; i++)
+        markobject(g, sh->keys[i]);
+      markobject(g, sh->parent);  /* keeps its place in the transitions */
+      size = sizeshape(sh->nkeys, sh->lsizeindex);
+      break;
+    }
     case LUA_TUPVAL: {
       UpVal *uv = gco2uv(o);
       markvalue(g, uv->v);
@@ -361,11 +387,12 @@ static void restartcollection (global_State *g) {
 */
 
 static void traverseweakvalue (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
-  /* if there is array part, assume it may have white values (do not
-     traverse it just to check) */
-  int hasclears = (h->sizearray > 0);
-  for (n = gnode(h, 0); n < limit; n++) {
+  Node *n;
+  int in;
+  /* if there is array part (or fields), assume it may have white values
+     (do not traverse it just to check); packed arrays hold only numbers */
+  int hasclears = ((h->sizearray > 0 && !ispacked(h)) || nfields(h) > 0);
+  for (in = 0; (n = nextnode(h, &in)) != NULL; ) {
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -387,17 +414,24 @@ static int traverseephemeron (global_State *g, Table *h) {
   int marked = 0;  /* true if an object is marked in this traversal */
   int hasclears = 0;  /* true if table has white keys */
   int prop = 0;  /* true if table has entry "white-key -> white-value" */
-  Node *n, *limit = gnodelast(h);
-  int i;
+  Node *n;
+  int i, in;
   /* traverse array part (numeric keys are 'strong') */
-  for (i = 0; i < h->sizearray; i++) {
+  for (i = 0; i < (ispacked(h) ? 0 : h->sizearray); i++) {
     if (valiswhite(&h->array[i])) {
       marked = 1;
       reallymarkobject(g, gcvalue(&h->array[i]));
     }
   }
+  /* traverse fields (string keys are 'strong' too) */
+  for (i = 0; i < nfields(h); i++) {
+    if (valiswhite(&h->fields->v[i])) {
+      marked = 1;
+      reallymarkobject(g, gcvalue(&h->fields->v[i]));
+    }
+  }
   /* traverse hash part */
-  for (n = gnode(h, 0); n < limit; n++) {
+  for (in = 0; (n = nextnode(h, &in)) != NULL; ) {
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -422,11 +456,13 @@ static int traverseephemeron (global_State *g, Table *h) {
 
 
 static void traversestrongtable (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
-  int i;
-  for (i = 0; i < h->sizearray; i++)  /* traverse array part */
+  Node *n;
+  int i, in;
+  for (i = 0; i < (ispacked(h) ? 0 : h->sizearray); i++)  /* array part */
     markvalue(g, &h->array[i]);
-  for (n = gnode(h, 0); n < limit; n++) {  /* traverse hash part */
+  for (i = 0; i < nfields(h); i++)  /* traverse fields */
+    markvalue(g, &h->fields->v[i]);
+  for (in = 0; (n = nextnode(h, &in)) != NULL; ) {  /* hash part */
     checkdeadkey(n);
     if (ttisnil(gval(n)))  /* entry is empty? */
       removeentry(n);  /* remove it */
@@ -441,8 +477,11 @@ static void traversestrongtable (global_State *g, Table *h) {
 
 static lu_mem traversetable (global_State *g, Table *h) {
   const char *weakkey, *weakvalue;
+  size_t nodes;
   const TValue *mode = gfasttm(g, h->metatable, TM_MODE);
   markobject(g, h->metatable);
+  if (h->fields != NULL)
+    markobject(g, h->fields->shape);  /* keys of the fields */
   if (mode && ttisstring(mode) &&  /* is there a weak mode? */
       ((weakkey = strchr(svalue(mode), 'k')),
        (weakvalue = strchr(svalue(mode), 'v')),
@@ -457,8 +496,11 @@ static lu_mem traversetable (global_State *g, Table *h) {
   }
   else  /* not weak */
     traversestrongtable(g, h);
-  return sizeof(Table) + sizeof(TValue) * h->sizearray +
-                         sizeof(Node) * cast(size_t, sizenode(h));
+  nodes = sizenode(h) + (isrehashing(h) ? sizeoldnode(h) : 0);
+  return sizeof(Table) +
+         (h->fields != NULL ? sizefields(h->fields->size) : 0) +
+         (ispacked(h) ? sizeof(Value) : sizeof(TValue)) * h->sizearray +
+         sizeof(Node) * nodes;
 }
 
 
@@ -476,6 +518,7 @@ static int traverseproto (global_State *g, Proto *f) {
   for (i = 0; i < f->sizelocvars; i++)  /* mark local-variable names */
     markobject(g, f->locvars[i].varname);
   return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
+                         sizeof(int) * f->sizeicache +
                          sizeof(Proto *) * f->sizep +
                          sizeof(TValue) * f->sizek +
                          sizeof(int) * f->sizelineinfo +
@@ -633,8 +676,9 @@ static void convergeephemerons (global_State *g) {
 static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
-    for (n = gnode(h, 0); n < limit; n++) {
+    Node *n;
+    int in;
+    for (in = 0; (n = nextnode(h, &in)) != NULL; ) {
       if (!ttisnil(gval(n)) && (iscleared(g, gkey(n)))) {
         setnilvalue(gval(n));  /* remove value ... */
         removeentry(n);  /* and remove entry from table */
@@ -651,17 +695,25 @@ static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
 static void clearvalues (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
-    int i;
-    for (i = 0; i < h->sizearray; i++) {
+    Node *n;
+    int i, in;
+    for (i = 0; i < (ispacked(h) ? 0 : h->sizearray); i++) {
       TValue *o = &h->array[i];
-      if (iscleared(g, o))  /* value was collected? */
+      if (iscleared(g, o)) {  /* value was collected? */
         setnilvalue(o);  /* remove value */
+        invalidateborder(h);  /* (it may leave a hole) */
+      }
+    }
+    for (i = 0; i < nfields(h); i++) {
+      TValue *o = &h->fields->v[i];
+      if (iscleared(g, o))  /* value was collected? */
+        setnilvalue(o);  /* remove value (field keeps its key) */
     }
-    for (n = gnode(h, 0); n < limit; n++) {
+    for (in = 0; (n = nextnode(h, &in)) != NULL; ) {
       if (!ttisnil(gval(n)) && iscleared(g, gval(n))) {
         setnilvalue(gval(n));  /* remove value ... */
         removeentry(n);  /* and remove entry from table */
+        invalidateborder(h);
       }
     }
   }
@@ -681,6 +733,7 @@ static void freeobj (lua_State *L, GCObject *o) {
     }
     case LUA_TUPVAL: luaF_freeupval(L, gco2uv(o)); break;
     case LUA_TTABLE: luaH_free(L, gco2t(o)); break;
+    case LUA_TSHAPE: luaH_freeshape(L, gco2sh(o)); break;
     case LUA_TTHREAD: luaE_freethread(L, gco2th(o)); break;
     case LUA_TUSERDATA: luaM_freemem(L, o, sizeudata(gco2u(o))); break;
     case LUA_TSHRSTR:
@@ -789,6 +842,9 @@ static void checkSizes (lua_State *L) {
     int hs = g->strt.size / 2;  /* half the size of the string table */
     if (g->strt.nuse < cast(lu_int32, hs))  /* using less than that half? */
       luaS_resize(L, hs);  /* halve its size */
+    hs = g->shapet.size / 2;  /* same for the transition table */
+    if (g->shapet.nuse < hs)
+      luaH_resizeshapes(L, hs);
     luaZ_freebuffer(L, &g->buff);  /* free concatenation buffer */
   }
 }
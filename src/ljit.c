@@ -0,0 +1,1156 @@
+/*
+** $Id: ljit.c $
+** Native code: baseline compiler to x86-64 and precompiled C
+** See Copyright Notice in lua.h
+*/
+
+/*
+** A function that gets hot (see 'luaJ_hot') is translated as a whole,
+** by stitching a template for each of its instructions. Most templates
+** call a C helper with the address of the next instruction, so that the
+** helper decodes its own operands and sets 'savedpc' exactly as the
+** interpreter does (errors, hooks and the debug interface see the same
+** frame). Control flow (jumps, tests and loops) becomes native jumps
+** between templates, so there is no decoding and no dispatch left. The
+** most frequent instructions (moves, constants, integer arithmetic and
+** integer loops) are done inline, with the helper as their slow path.
+**
+** Calls to Lua functions, tail calls and returns go back to
+** 'luaV_execute', which enters the machine code again (at any
+** instruction) when that frame resumes. Machine code never runs line or
+** count hooks: it is not entered while they are set, and it goes back to
+** the interpreter at the next backward jump once they are.
+**
+** 'luac -C' translates functions ahead of time into C that follows the
+** same protocol, using the same helpers (see 'luaJ_loadnative').
+**
+** The compiler is optional and off by default (see LUA_USE_JIT in
+** luaconf.h); the helpers and the loader for 'luac -C' are always built.
+*/
+
+/* 此源文件实现了一个基线编译器,将函数原型整体拼接为x86-64机器码 */
+
+#include <stddef.h>
+#include <string.h>
+
+#define ljit_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "ldebug.h"
+#include "ldo.h"
+#include "lfunc.h"
+#include "lgc.h"
+#include "ljit.h"
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lstate.h"
+#include "ltable.h"
+#include "ltm.h"
+#include "lvm.h"
+
+
+/*
+** Machine code of a function: a header with the offset of each
+** instruction, followed by the code itself, all in one mapping.
+*/
+/* 函数的机器码: 头部记录每条指令的偏移,之后是代码本身 */
+typedef struct JitCode {
+  size_t size;  /* size of the whole mapping */
+  lu_byte *mcode;  /* start of the machine code */
+  unsigned int entry[1];  /* offset in 'mcode' of each instruction */
+} JitCode;
+
+
+/* signature of the machine code: run frame 'ci' from address 'start' */
+typedef int (*JitFunction) (lua_State *L, CallInfo *ci, lu_byte *start);
+
+/*
+** {======================================================
+** Helpers
+** =======================================================
+*/
+
+/* decode the instruction before 'pc' and save 'pc' into the frame */
+/* 解码pc之前的指令,并将pc保存到调用帧中 */
+#define helperbegin \
+  CallInfo *ci = L->ci; \
+  StkId base = ci->u.l.base; \
+  Instruction i = pc[-1]; \
+  ci->u.l.savedpc = pc
+
+#define K		(clLvalue(ci->func)->p->k)
+#define RA(i)	(base+GETARG_A(i))
+#define RB(i)	(base+GETARG_B(i))
+#define RKB(i)	(ISK(GETARG_B(i)) ? K+INDEXK(GETARG_B(i)) : base+GETARG_B(i))
+#define RKC(i)	(ISK(GETARG_C(i)) ? K+INDEXK(GETARG_C(i)) : base+GETARG_C(i))
+
+#define checkGC(L,c)  \
+  luaC_condGC(L, {L->top = (c); luaC_step(L); L->top = ci->top;})
+
+#if !defined luai_runtimecheck
+#define luai_runtimecheck(L, c)		/* void */
+#endif
+
+
+static int h_move (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  setobjs2s(L, RA(i), RB(i));
+  return 0;
+}
+
+
+static int h_loadk (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  setobj2s(L, RA(i), K + GETARG_Bx(i));
+  return 0;
+}
+
+
+static int h_loadkx (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  setobj2s(L, RA(i), K + GETARG_Ax(*pc));
+  return 0;
+}
+
+
+static int h_loadbool (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  setbvalue(RA(i), GETARG_B(i));
+  return 0;
+}
+
+
+static int h_loadnil (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  int b = GETARG_B(i);
+  do {
+    setnilvalue(ra++);
+  } while (b--);
+  return 0;
+}
+
+
+static int h_getupval (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  setobj2s(L, RA(i), clLvalue(ci->func)->upvals[GETARG_B(i)]->v);
+  return 0;
+}
+
+
+static int h_setupval (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  UpVal *uv = clLvalue(ci->func)->upvals[GETARG_B(i)];
+  setobj(L, uv->v, RA(i));
+  luaC_barrier(L, uv, RA(i));
+  return 0;
+}
+
+
+/* inline cache of the instruction before 'pc' (see lvm.c) */
+#define icache(ci,pc) \
+  (&clLvalue((ci)->func)->p->icache[(pc) - clLvalue((ci)->func)->p->code - 1])
+
+/* get t[key] into 'ra', with the fast paths of the interpreter */
+static void gettable (lua_State *L, CallInfo *ci, const Instruction *pc,
+                      const TValue *t, TValue *key, StkId ra) {
+  if (ttistable(t)) {
+    Table *h = hvalue(t);
+    int hit = 0;
+    if (ttisshrstring(key)) {
+      const TValue *res = luaH_getstrcached(h, rawtsvalue(key), icache(ci, pc));
+      if (!ttisnil(res)) {
+        setobj2s(L, ra, res);
+        hit = 1;
+      }
+    }
+    else if (ttisinteger(key))
+      luaH_fastgeti(L, h, ivalue(key), ra, hit);
+    if (hit) return;
+  }
+  luaV_gettable(L, t, key, ra);
+}
+
+
+/* set t[key] = val, with the fast paths of the interpreter */
+static void settable (lua_State *L, CallInfo *ci, const Instruction *pc,
+                      const TValue *t, TValue *key, TValue *val) {
+  if (ttistable(t)) {
+    Table *h = hvalue(t);
+    int hit = 0;
+    if (ttisshrstring(key)) {
+      TValue *slot = cast(TValue *, luaH_getstrcached(h, rawtsvalue(key),
+                                                      icache(ci, pc)));
+      if (luaH_storable(h, slot)) {
+        setobj2t(L, slot, val);
+        hit = 1;
+      }
+    }
+    else if (ttisinteger(key))
+      luaH_fastseti(L, h, ivalue(key), val, hit);
+    if (hit) {
+      invalidateTMcache(h);
+      luaC_barrierback(L, obj2gco(h), val);
+      return;
+    }
+  }
+  luaV_settable(L, t, key, val);
+}
+
+
+static int h_gettabup (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  gettable(L, ci, pc, clLvalue(ci->func)->upvals[GETARG_B(i)]->v, RKC(i),
+           RA(i));
+  return 0;
+}
+
+
+static int h_gettable (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  gettable(L, ci, pc, RB(i), RKC(i), RA(i));
+  return 0;
+}
+
+
+static int h_settabup (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  settable(L, ci, pc, clLvalue(ci->func)->upvals[GETARG_A(i)]->v, RKB(i),
+           RKC(i));
+  return 0;
+}
+
+
+static int h_settable (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  settable(L, ci, pc, RA(i), RKB(i), RKC(i));
+  return 0;
+}
+
+
+static int h_newtable (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  int b = GETARG_B(i);
+  int c = GETARG_C(i);
+  Table *t = luaH_new(L);
+  sethvalue(L, ra, t);
+  if (b != 0 || c != 0)
+    luaH_presize(L, t, luaO_fb2int(b), luaO_fb2int(c));
+  checkGC(L, ra + 1);
+  return 0;
+}
+
+
+static int h_newtempl (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  Table *t = luaH_new(L);
+  sethvalue(L, ra, t);
+  luaH_copy(L, t, hvalue(K + GETARG_Bx(i)));
+  checkGC(L, ra + 1);
+  return 0;
+}
+
+
+static int h_self (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  StkId rb = RB(i);
+  setobjs2s(L, ra+1, rb);
+  gettable(L, ci, pc, rb, RKC(i), ra);
+  return 0;
+}
+
+
+/* arithmetic with the integer and float fast paths of the interpreter */
+#define arithhelper(name,iop,op,tm) \
+static int name (lua_State *L, const Instruction *pc) { \
+  helperbegin; \
+  StkId ra = RA(i); \
+  TValue *rb = RKB(i); \
+  TValue *rc = RKC(i); \
+  lua_Integer ir; \
+  if (ttisinteger(rb) && ttisinteger(rc) && \
+      !iop(L, ir, ivalue(rb), ivalue(rc))) { \
+    setivalue(ra, ir); \
+  } \
+  else if (ttisnumber(rb) && ttisnumber(rc)) { \
+    lua_Number nb = nvalue(rb), nc = nvalue(rc); \
+    setnvalue(ra, op(L, nb, nc)); \
+  } \
+  else luaV_arith(L, ra, rb, rc, tm); \
+  return 0; \
+}
+
+/* float-only operations never take the integer path */
+#define luai_nointop(L,r,a,b)	((void)(r), (void)(a), (void)(b), 1)
+
+arithhelper(h_add, luai_intadd, luai_numadd, TM_ADD)
+arithhelper(h_sub, luai_intsub, luai_numsub, TM_SUB)
+arithhelper(h_mul, luai_intmul, luai_nummul, TM_MUL)
+arithhelper(h_div, luai_nointop, luai_numdiv, TM_DIV)
+arithhelper(h_mod, luai_intmod, luai_nummod, TM_MOD)
+arithhelper(h_pow, luai_nointop, luai_numpow, TM_POW)
+
+
+static int h_unm (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  TValue *rb = RB(i);
+  lua_Integer ir;
+  if (ttisinteger(rb) && !luai_intunm(L, ir, ivalue(rb))) {
+    setivalue(ra, ir);
+  }
+  else if (ttisnumber(rb)) {
+    lua_Number nb = nvalue(rb);
+    setnvalue(ra, luai_numunm(L, nb));
+  }
+  else luaV_arith(L, ra, rb, rb, TM_UNM);
+  return 0;
+}
+
+
+static int h_not (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  int res = l_isfalse(RB(i));  /* next assignment may change this value */
+  setbvalue(RA(i), res);
+  return 0;
+}
+
+
+static int h_len (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  luaV_objlen(L, RA(i), RB(i));
+  return 0;
+}
+
+
+/* OP_APPEND: returns true when it did the ADD and SETTABLE after it too */
+static int h_append (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  StkId rb = RB(i);
+  if (ttistable(rb) && hvalue(rb)->metatable == NULL) {
+    Table *h = hvalue(rb);
+    TValue *v = RKC(pc[1]);  /* value of the SETTABLE */
+    setivalue(ra, luaH_append(L, h, v));
+    invalidateTMcache(h);
+    luaC_barrierback(L, obj2gco(h), v);
+    return 1;
+  }
+  luaV_objlen(L, ra, rb);
+  return 0;
+}
+
+
+static int h_concat (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  int b = GETARG_B(i);
+  int c = GETARG_C(i);
+  StkId ra, rb;
+  L->top = base + c + 1;  /* mark the end of concat operands */
+  luaV_concat(L, c - b + 1);
+  base = ci->u.l.base;  /* 'luav_concat' may invoke TMs and move the stack */
+  ra = RA(i);
+  rb = b + base;
+  setobjs2s(L, ra, rb);
+  checkGC(L, (ra >= rb ? ra + 1 : rb));
+  L->top = ci->top;  /* restore top */
+  return 0;
+}
+
+
+/* close upvalues for a jump; the jump itself is done by the template */
+static int h_jmpclose (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  luaF_close(L, base + GETARG_A(i) - 1);
+  return 0;
+}
+
+
+/*
+** tests return true to skip the jump that follows them (see 'condjump'
+** in lvm.c)
+*/
+static int h_eq (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  TValue *rb = RKB(i);
+  TValue *rc = RKC(i);
+  return cast_int(equalobj(L, rb, rc)) != GETARG_A(i);
+}
+
+
+static int h_lt (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  return luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i);
+}
+
+
+static int h_le (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  return luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i);
+}
+
+
+static int h_test (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  return GETARG_C(i) ? l_isfalse(ra) : !l_isfalse(ra);
+}
+
+
+static int h_testset (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  TValue *rb = RB(i);
+  if (GETARG_C(i) ? l_isfalse(rb) : !l_isfalse(rb))
+    return 1;
+  setobjs2s(L, RA(i), rb);
+  return 0;
+}
+
+
+/* returns true after setting 'savedpc' to the case of R(A), if any */
+static int h_switch (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  TValue aux;
+  const TValue *o = luaH_get(hvalue(K + GETARG_Bx(i)), RA(i), &aux);
+  if (!ttisinteger(o)) return 0;
+  ci->u.l.savedpc += ivalue(o);
+  return 1;
+}
+
+
+/*
+** call: C functions run right here; for a Lua function, leave its new
+** frame to 'luaV_execute'
+*/
+static int h_call (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  int b = GETARG_B(i);
+  int nresults = GETARG_C(i) - 1;
+  if (b != 0) L->top = ra+b;  /* else previous instruction set top */
+  if (!luaD_precall(L, ra, nresults))  /* Lua function? */
+    return JIT_NEWFRAME;
+  if (nresults >= 0) L->top = ci->top;  /* adjust results */
+  /* the called function may have set a hook */
+  return (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) ? JIT_INTERP : 0;
+}
+
+
+/* returns true to jump back */
+static int h_forloop (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  if (ttisinteger(ra)) {  /* integer loop? */
+    lu_integer idx = cast(lu_integer, ivalue(ra));
+    lu_integer limit = cast(lu_integer, ivalue(ra+1));
+    lua_Integer step = ivalue(ra+2);
+    if (step > 0 ? limit - idx >= cast(lu_integer, step)
+                 : idx - limit >= 0u - cast(lu_integer, step)) {
+      lua_Integer nidx = cast(lua_Integer, idx + cast(lu_integer, step));
+      setivalue(ra, nidx);  /* update internal index... */
+      setivalue(ra+3, nidx);  /* ...and external index */
+      return 1;
+    }
+  }
+  else {  /* floating loop */
+    lua_Number step = fltvalue(ra+2);
+    lua_Number idx = luai_numadd(L, fltvalue(ra), step);
+    lua_Number limit = fltvalue(ra+1);
+    if (luai_numlt(L, 0, step) ? luai_numle(L, idx, limit)
+                               : luai_numle(L, limit, idx)) {
+      setnvalue(ra, idx);  /* update internal index... */
+      setnvalue(ra+3, idx);  /* ...and external index */
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+static int h_forprep (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  return luaV_forprep(L, RA(i));
+}
+
+
+static int h_tforcall (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  StkId cb = ra + 3;  /* call base */
+  if (luaV_tforcall(L, ra, GETARG_C(i)))
+    return 0;  /* iterator ran inline */
+  setobjs2s(L, cb+2, ra+2);
+  setobjs2s(L, cb+1, ra+1);
+  setobjs2s(L, cb, ra);
+  L->top = cb + 3;  /* func. + 2 args (state and index) */
+  luaD_call(L, cb, GETARG_C(i), 1);
+  L->top = ci->top;
+  return 0;
+}
+
+
+/* returns true to jump back */
+static int h_tforloop (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  if (!ttisnil(ra + 1)) {  /* continue loop? */
+    if (!luaV_keepspos(ra))
+      setobjs2s(L, ra, ra + 1);  /* save control variable */
+    return 1;
+  }
+  return 0;
+}
+
+
+static int h_setlist (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  int n = GETARG_B(i);
+  int c = GETARG_C(i);
+  int first;
+  int j;
+  Table *h;
+  if (n == 0) n = cast_int(L->top - ra) - 1;
+  if (c == 0) c = GETARG_Ax(*pc);  /* next instruction is EXTRAARG */
+  luai_runtimecheck(L, ttistable(ra));
+  h = hvalue(ra);
+  first = (c-1)*LFIELDS_PER_FLUSH;  /* index before the first item */
+  if (first + n > h->sizearray)  /* needs more space? */
+    luaH_resizearray(L, h, first + n);  /* pre-allocate it at once */
+  for (j = 1; j <= n; j++) {  /* in order, to keep arrays packed */
+    TValue *val = ra+j;
+    luaH_setint(L, h, first + j, val);
+    luaC_barrierback(L, obj2gco(h), val);
+  }
+  L->top = ci->top;  /* correct top (in case of previous open call) */
+  return 0;
+}
+
+
+static int h_closure (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  LClosure *cl = clLvalue(ci->func);
+  luaV_closure(L, cl->p->p[GETARG_Bx(i)], cl->upvals, base, ra);
+  checkGC(L, ra + 1);
+  return 0;
+}
+
+
+static int h_vararg (lua_State *L, const Instruction *pc) {
+  helperbegin;
+  StkId ra = RA(i);
+  int b = GETARG_B(i) - 1;
+  int j;
+  int n = cast_int(base - ci->func) - clLvalue(ci->func)->p->numparams - 1;
+  if (b < 0) {  /* B == 0? */
+    b = n;  /* get all var. arguments */
+    luaD_checkstack(L, n);
+    base = ci->u.l.base;  /* previous call may change the stack */
+    ra = RA(i);
+    L->top = ra + n;
+  }
+  for (j = 0; j < b; j++) {
+    if (j < n) {
+      setobjs2s(L, ra + j, base - n + j);
+    }
+    else {
+      setnilvalue(ra + j);
+    }
+  }
+  return 0;
+}
+
+LUAI_DDEF const JitHelper luaJ_helper[NUM_OPCODES] = {
+  h_move, h_loadk, h_loadkx, h_loadbool, h_loadnil, h_getupval,
+  h_gettabup, h_gettable, h_gettable, h_gettable,
+  h_settabup, h_setupval, h_settable, h_settable, h_settable, h_newtable,
+  h_newtempl, h_self, h_add, h_sub, h_mul, h_div, h_mod, h_pow, h_unm,
+  h_not, h_len, h_concat, h_jmpclose, h_eq, h_lt, h_le, h_test, h_testset,
+  h_switch, h_call, NULL, NULL, h_forloop, h_forprep, h_tforcall, h_tforloop,
+  h_setlist, h_closure, h_vararg, NULL,
+  NULL, NULL, NULL, NULL, NULL, NULL,  /* quickened variants */
+  NULL, NULL, NULL, NULL, NULL, NULL, h_append  /* superinstructions */
+};
+
+/* }====================================================== */
+
+
+#if defined(LUA_USE_JIT)	/* { */
+
+#include <sys/mman.h>
+
+
+/* maximum size of the code for one instruction */
+#define MAXTEMPLATE	256
+
+/* size of prologue plus exit sequence */
+#define PROLOGUESIZE	64
+
+
+/*
+** {======================================================
+** Code emission
+** =======================================================
+*/
+
+typedef struct JitState {
+  const Proto *p;
+  lu_byte *mcode;  /* buffer for the machine code */
+  size_t size;  /* size of 'mcode' */
+  size_t pos;  /* current position in 'mcode' */
+  unsigned int *entry;  /* offset of each instruction */
+  size_t exit;  /* offset of the exit sequence */
+  int overflow;  /* true if the code did not fit in 'mcode' */
+} JitState;
+
+
+static void emit (JitState *J, const char *b, size_t n) {
+  if (J->pos + n > J->size)
+    J->overflow = 1;
+  else {
+    memcpy(J->mcode + J->pos, b, n);
+    J->pos += n;
+  }
+}
+
+
+static void emit32 (JitState *J, int x) {
+  emit(J, cast(const char *, &x), 4);
+}
+
+
+static void emitptr (JitState *J, const void *p) {
+  emit(J, cast(const char *, &p), sizeof(p));
+}
+
+
+/* rel32 to offset 'target', for an instruction that ends after it */
+static void emitrel (JitState *J, size_t target) {
+  emit32(J, cast_int(cast(ptrdiff_t, target) -
+                     cast(ptrdiff_t, J->pos + 4)));
+}
+
+
+/* mov rax, imm64 */
+static void emitmovrax (JitState *J, const void *p) {
+  emit(J, "\x48\xb8", 2);
+  emitptr(J, p);
+}
+
+
+/* call 'h' with L and the address of instruction 'pc + 1' */
+/* mov r13, ci->u.l.base */
+static void emitloadbase (JitState *J) {
+  emit(J, "\x4c\x8b\xab", 3);
+  emit32(J, cast_int(offsetof(CallInfo, u.l.base)));
+}
+
+
+/*
+** call 'h' with L and the address of instruction 'pc + 1'; the helper
+** may have moved the stack, so reload its base
+*/
+static void emitcall (JitState *J, JitHelper h, int pc) {
+  emit(J, "\x4c\x89\xe7", 3);  /* mov rdi, r12 */
+  emit(J, "\x48\xbe", 2);  /* mov rsi, imm64 */
+  emitptr(J, J->p->code + pc + 1);
+  emit(J, "\x48\xb8", 2);  /* mov rax, imm64 */
+  emit(J, cast(const char *, &h), sizeof(h));
+  emit(J, "\xff\xd0", 2);  /* call rax */
+  emitloadbase(J);
+}
+
+
+
+/* leave the machine code, returning eax */
+static void emitexit (JitState *J) {
+  emit(J, "\xe9", 1);  /* jmp exit */
+  emitrel(J, J->exit);
+}
+
+
+/* leave the machine code, to interpret from instruction 'pc' */
+static void emitinterp (JitState *J, int pc) {
+  emitmovrax(J, J->p->code + pc);
+  emit(J, "\x48\x89\x83", 3);  /* mov [rbx + savedpc], rax */
+  emit32(J, cast_int(offsetof(CallInfo, u.l.savedpc)));
+  emit(J, "\xb8", 1);  /* mov eax, JIT_INTERP */
+  emit32(J, JIT_INTERP);
+  emitexit(J);
+}
+
+
+/* jmp to instruction 'target' (jcc when 'cc' is given) */
+static void emitjump (JitState *J, const char *cc, int target) {
+  if (cc) emit(J, cc, 2);
+  else emit(J, "\xe9", 1);
+  emitrel(J, J->entry[target]);
+}
+
+
+/*
+** jump to instruction 'target' of the same template (from instruction
+** 'pc'); a backward jump goes back to the interpreter if a line or count
+** hook has been set in the meantime
+*/
+static void emitgoto (JitState *J, int pc, int target) {
+  if (target > pc)
+    emitjump(J, NULL, target);
+  else {
+    emit(J, "\x41\xf6\x84\x24", 4);  /* test byte [r12 + hookmask], imm8 */
+    emit32(J, cast_int(offsetof(lua_State, hookmask)));
+    emit(J, "\x0c", 1);  /* imm8 = LUA_MASKLINE | LUA_MASKCOUNT */
+    emitjump(J, "\x0f\x84", target);  /* jz target */
+    emitinterp(J, target);
+  }
+}
+
+
+/* conditional 'emitgoto', taken when the last helper returned true */
+static void emitcondgoto (JitState *J, int pc, int target) {
+  size_t skip;
+  emit(J, "\x85\xc0", 2);  /* test eax, eax */
+  if (target > pc) {
+    emitjump(J, "\x0f\x85", target);  /* jnz target */
+    return;
+  }
+  emit(J, "\x74\x00", 2);  /* jz over the jump */
+  skip = J->pos;
+  emitgoto(J, pc, target);
+  if (!J->overflow)
+    J->mcode[skip - 1] = cast_byte(J->pos - skip);
+}
+
+
+/*
+** {======================================================
+** Inline templates; register r13 holds 'base'
+** =======================================================
+*/
+
+/* offsets of the value and of the tag of register 'r' */
+#define valoff(r)  \
+	cast_int((r) * sizeof(TValue) + offsetof(TValue, value_))
+#define tagoff(r)	cast_int((r) * sizeof(TValue) + offsetof(TValue, tt_))
+
+
+/* 'op' (a 3-byte instruction) with operand [r13 + 'off'] */
+static void emitmem (JitState *J, const char *op, int off) {
+  emit(J, op, 3);
+  emit32(J, off);
+}
+
+#define MOV_RAX_MEM	"\x49\x8b\x85"	/* mov rax, [r13 + d] */
+#define MOV_RCX_MEM	"\x49\x8b\x8d"	/* mov rcx, [r13 + d] */
+#define MOV_RDX_MEM	"\x49\x8b\x95"	/* mov rdx, [r13 + d] */
+#define MOV_MEM_RAX	"\x49\x89\x85"	/* mov [r13 + d], rax */
+#define MOV_MEM_RCX	"\x49\x89\x8d"	/* mov [r13 + d], rcx */
+
+
+/* set tag of register 'r' to 'tt' */
+static void emitsettag (JitState *J, int r, int tt) {
+  emitmem(J, "\x41\xc7\x85", tagoff(r));  /* mov dword [r13 + d], imm32 */
+  emit32(J, tt);
+}
+
+
+/* jcc (or jmp when 'cc' is NULL) to a later label; returns the label */
+static size_t emitforward (JitState *J, const char *cc) {
+  if (cc) emit(J, cc, 2);
+  else emit(J, "\xe9", 1);
+  emit32(J, 0);
+  return J->pos;
+}
+
+
+/* make jump 'label' go to the current position */
+static void patchhere (JitState *J, size_t label) {
+  if (!J->overflow) {
+    int rel = cast_int(J->pos - label);
+    memcpy(J->mcode + label - 4, &rel, 4);
+  }
+}
+
+
+/* jump to the returned label unless register 'r' is an integer */
+static size_t emitcheckint (JitState *J, int r) {
+  emitmem(J, "\x41\x81\xbd", tagoff(r));  /* cmp dword [r13 + d], imm32 */
+  emit32(J, LUA_TNUMINT);
+  return emitforward(J, "\x0f\x85");  /* jne */
+}
+
+
+static void emitmove (JitState *J, int a, int b) {
+  emitmem(J, MOV_RAX_MEM, valoff(b));
+  emitmem(J, MOV_RCX_MEM, valoff(b) + 8);
+  emitmem(J, MOV_MEM_RAX, valoff(a));
+  emitmem(J, MOV_MEM_RCX, valoff(a) + 8);
+}
+
+
+static void emitloadk (JitState *J, int a, const TValue *k) {
+  emitmovrax(J, k);
+  emit(J, "\x48\x8b\x08", 3);  /* mov rcx, [rax] */
+  emit(J, "\x48\x8b\x50\x08", 4);  /* mov rdx, [rax + 8] */
+  emitmem(J, MOV_MEM_RCX, valoff(a));
+  emitmem(J, "\x49\x89\x95", valoff(a) + 8);  /* mov [r13 + d], rdx */
+}
+
+
+/*
+** load operand 'rk' into 'reg' (rax or rcx), if it is an integer;
+** registers are checked at run time (jumping to 'slow'), constants now
+*/
+static int emitintoperand (JitState *J, int rk, int isrcx, size_t *slow,
+                           int *nslow) {
+  if (ISK(rk)) {
+    const TValue *k = &J->p->k[INDEXK(rk)];
+    lua_Integer n;
+    if (!ttisinteger(k)) return 0;
+    n = ivalue(k);
+    emit(J, isrcx ? "\x48\xb9" : "\x48\xb8", 2);  /* mov reg, imm64 */
+    emit(J, cast(const char *, &n), sizeof(n));
+  }
+  else {
+    slow[(*nslow)++] = emitcheckint(J, rk);
+    emitmem(J, isrcx ? MOV_RCX_MEM : MOV_RAX_MEM, valoff(rk));
+  }
+  return 1;
+}
+
+
+/*
+** integer addition or subtraction, with the helper as the slow path
+** (non-integer operands or overflow)
+*/
+static void emitarith (JitState *J, int pc, JitHelper h, const char *op) {
+  Instruction i = J->p->code[pc];
+  size_t slow[3], done;
+  int nslow = 0;
+  size_t mark = J->pos;
+  if (emitintoperand(J, GETARG_B(i), 0, slow, &nslow) &&
+      emitintoperand(J, GETARG_C(i), 1, slow, &nslow)) {
+    emit(J, op, 3);  /* rax = rax op rcx */
+    slow[nslow++] = emitforward(J, "\x0f\x80");  /* jo */
+    emitmem(J, MOV_MEM_RAX, valoff(GETARG_A(i)));
+    emitsettag(J, GETARG_A(i), LUA_TNUMINT);
+    done = emitforward(J, NULL);
+    while (nslow > 0) patchhere(J, slow[--nslow]);
+    emitcall(J, h, pc);
+    patchhere(J, done);
+  }
+  else {  /* constant is not an integer: always use the helper */
+    J->pos = mark;
+    emitcall(J, h, pc);
+  }
+}
+
+
+/*
+** integer loop (see 'OP_FORLOOP' in lvm.c), with the helper for
+** floating loops
+*/
+static void emitforloop (JitState *J, int pc, int target) {
+  int a = GETARG_A(J->p->code[pc]);
+  size_t slow, neg, exit1, exit2, upd;
+  slow = emitcheckint(J, a);
+  emitmem(J, MOV_RAX_MEM, valoff(a));  /* rax = idx */
+  emitmem(J, MOV_RDX_MEM, valoff(a + 1));  /* rdx = limit */
+  emitmem(J, MOV_RCX_MEM, valoff(a + 2));  /* rcx = step */
+  emit(J, "\x48\x85\xc9", 3);  /* test rcx, rcx */
+  neg = emitforward(J, "\x0f\x88");  /* js */
+  emit(J, "\x48\x29\xc2", 3);  /* sub rdx, rax */
+  emit(J, "\x48\x39\xca", 3);  /* cmp rdx, rcx */
+  exit1 = emitforward(J, "\x0f\x82");  /* jb: limit - idx < step */
+  upd = emitforward(J, NULL);
+  patchhere(J, neg);
+  emit(J, "\x48\x89\xc6", 3);  /* mov rsi, rax */
+  emit(J, "\x48\x29\xd6", 3);  /* sub rsi, rdx */
+  emit(J, "\x48\x89\xcf", 3);  /* mov rdi, rcx */
+  emit(J, "\x48\xf7\xdf", 3);  /* neg rdi */
+  emit(J, "\x48\x39\xfe", 3);  /* cmp rsi, rdi */
+  exit2 = emitforward(J, "\x0f\x82");  /* jb: idx - limit < -step */
+  patchhere(J, upd);
+  emit(J, "\x48\x01\xc8", 3);  /* add rax, rcx */
+  emitmem(J, MOV_MEM_RAX, valoff(a));  /* update internal index... */
+  emitmem(J, MOV_MEM_RAX, valoff(a + 3));  /* ...and external index */
+  emitsettag(J, a + 3, LUA_TNUMINT);
+  emitgoto(J, pc, target);
+  patchhere(J, slow);
+  emitcall(J, h_forloop, pc);
+  emitcondgoto(J, pc, target);
+  patchhere(J, exit1);
+  patchhere(J, exit2);
+}
+
+/*
+** OP_SWITCH: the helper leaves the case in 'savedpc', and its machine
+** code is found through 'entry'; cases are always forward, so there is
+** no hook to check
+*/
+static void emitswitch (JitState *J, int pc) {
+  size_t miss;
+  emitcall(J, h_switch, pc);
+  emit(J, "\x85\xc0", 2);  /* test eax, eax */
+  miss = emitforward(J, "\x0f\x84");  /* jz: next instruction */
+  emit(J, "\x48\x8b\x83", 3);  /* mov rax, [rbx + savedpc] */
+  emit32(J, cast_int(offsetof(CallInfo, u.l.savedpc)));
+  emit(J, "\x48\xb9", 2);  /* mov rcx, imm64 */
+  emitptr(J, J->p->code);
+  emit(J, "\x48\x29\xc8", 3);  /* sub rax, rcx */
+  emit(J, "\x48\xc1\xe8\x02", 4);  /* shr rax, 2 (an instruction index) */
+  emit(J, "\x48\xb9", 2);  /* mov rcx, imm64 */
+  emitptr(J, J->entry);
+  emit(J, "\x8b\x04\x81", 3);  /* mov eax, [rcx + rax*4] */
+  emit(J, "\x48\xb9", 2);  /* mov rcx, imm64 */
+  emitptr(J, J->mcode);
+  emit(J, "\x48\x01\xc8", 3);  /* add rax, rcx */
+  emit(J, "\xff\xe0", 2);  /* jmp rax */
+  patchhere(J, miss);
+}
+
+/* }====================================================== */
+
+
+static void emitinstruction (JitState *J, int pc) {
+  Instruction i = J->p->code[pc];
+  OpCode op = GET_GENOPCODE(i);
+  switch (op) {
+    case OP_JMP: {
+      if (GETARG_A(i) != 0)  /* close upvalues? */
+        emitcall(J, h_jmpclose, pc);
+      emitgoto(J, pc, pc + 1 + GETARG_sBx(i));
+      break;
+    }
+    case OP_MOVE: {
+      emitmove(J, GETARG_A(i), GETARG_B(i));
+      break;
+    }
+    case OP_LOADK: {
+      emitloadk(J, GETARG_A(i), &J->p->k[GETARG_Bx(i)]);
+      break;
+    }
+    case OP_LEN: {
+      if (GET_OPCODE(i) == OP_APPEND) {
+        emitcall(J, h_append, pc);
+        emitcondgoto(J, pc, pc + 3);  /* skip the ADD and the SETTABLE */
+      }
+      else emitcall(J, h_len, pc);
+      break;
+    }
+    case OP_ADD: {
+      emitarith(J, pc, h_add, "\x48\x01\xc8");  /* add rax, rcx */
+      break;
+    }
+    case OP_SUB: {
+      emitarith(J, pc, h_sub, "\x48\x29\xc8");  /* sub rax, rcx */
+      break;
+    }
+    case OP_LOADBOOL: {
+      emitcall(J, h_loadbool, pc);
+      if (GETARG_C(i))  /* skip next instruction? */
+        emitjump(J, NULL, pc + 2);
+      break;
+    }
+    case OP_EQ: case OP_LT: case OP_LE: case OP_TEST: case OP_TESTSET: {
+      emitcall(J, luaJ_helper[op], pc);
+      emitcondgoto(J, pc, pc + 2);  /* skip the jump that follows */
+      break;
+    }
+    case OP_SWITCH: {
+      emitswitch(J, pc);
+      break;
+    }
+    case OP_CALL: {
+      emitcall(J, h_call, pc);
+      emit(J, "\x85\xc0", 2);  /* test eax, eax */
+      emit(J, "\x0f\x85", 2);  /* jnz exit */
+      emitrel(J, J->exit);
+      break;
+    }
+    case OP_TAILCALL: case OP_RETURN: {
+      emitinterp(J, pc);  /* the interpreter does it */
+      break;
+    }
+    case OP_FORLOOP: {
+      emitforloop(J, pc, pc + 1 + GETARG_sBx(i));
+      break;
+    }
+    case OP_TFORLOOP: {
+      emitcall(J, h_tforloop, pc);
+      emitcondgoto(J, pc, pc + 1 + GETARG_sBx(i));
+      break;
+    }
+    case OP_FORPREP: {
+      emitcall(J, h_forprep, pc);
+      emit(J, "\x85\xc0", 2);  /* test eax, eax */
+      emitjump(J, "\x0f\x88", pc + 2 + GETARG_sBx(i));  /* js: skip loop */
+      emitjump(J, "\x0f\x85", pc + 1 + GETARG_sBx(i));  /* jnz: FORLOOP */
+      break;
+    }
+    case OP_EXTRAARG: break;  /* never executed by itself */
+    default: {
+      emitcall(J, luaJ_helper[op], pc);
+      break;
+    }
+  }
+}
+
+
+/*
+** prologue: keep L in r12, ci in rbx and base in r13, and jump to the
+** start address;
+** the exit sequence that follows it returns eax
+*/
+static void emitprologue (JitState *J) {
+  emit(J, "\x53\x41\x54\x41\x55", 5);  /* push rbx; push r12; push r13 */
+  emit(J, "\x49\x89\xfc", 3);  /* mov r12, rdi */
+  emit(J, "\x48\x89\xf3", 3);  /* mov rbx, rsi */
+  emitloadbase(J);
+  emit(J, "\xff\xe2", 2);  /* jmp rdx */
+  J->exit = J->pos;
+  emit(J, "\x41\x5d\x41\x5c\x5b\xc3", 6);  /* pop r13; pop r12; pop rbx; ret */
+}
+
+
+/* emit the whole function; offsets are right once 'entry' is filled */
+static void emitfunction (JitState *J) {
+  int pc;
+  J->pos = 0;
+  J->overflow = 0;
+  emitprologue(J);
+  for (pc = 0; pc < J->p->sizecode; pc++) {
+    J->entry[pc] = cast(unsigned int, J->pos);
+    emitinstruction(J, pc);
+    lua_assert(J->overflow || J->pos - J->entry[pc] <= MAXTEMPLATE);
+  }
+}
+
+/* }====================================================== */
+
+
+/* offset of the machine code inside the mapping, after the header */
+#define codeoffset(n) \
+  ((offsetof(JitCode, entry) + (n) * sizeof(unsigned int) + 15) & ~15u)
+
+
+void luaJ_compile (lua_State *L, Proto *p) {
+  JitState J;
+  JitCode *jc;
+  size_t start = codeoffset(p->sizecode);
+  size_t size = start + PROLOGUESIZE + cast(size_t, p->sizecode) * MAXTEMPLATE;
+  void *m = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  UNUSED(L);
+  if (m == MAP_FAILED) return;  /* keep interpreting it */
+  jc = cast(JitCode *, m);
+  jc->size = size;
+  jc->mcode = cast(lu_byte *, m) + start;
+  J.p = p;
+  J.mcode = jc->mcode;
+  J.size = size - start;
+  J.entry = jc->entry;
+  emitfunction(&J);  /* first pass computes the offsets... */
+  emitfunction(&J);  /* ...second pass uses them for the jumps */
+  if (J.overflow || mprotect(m, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(m, size);
+    return;
+  }
+  p->jit = jc;
+}
+
+
+void luaJ_free (lua_State *L, Proto *p) {
+  UNUSED(L);
+  if (p->jit != NULL)
+    munmap(p->jit, p->jit->size);
+}
+
+#endif	/* } */
+
+
+int luaJ_execute (lua_State *L, CallInfo *ci) {
+  Proto *p = clLvalue(ci->func)->p;
+  if (p->native != NULL)  /* precompiled? */
+    return (*p->native)(L, ci);
+  else {
+#if defined(LUA_USE_JIT)
+    JitCode *jc = p->jit;
+    int pc = cast_int(ci->u.l.savedpc - p->code);
+    union { lu_byte *m; JitFunction f; } u;
+    u.m = jc->mcode;
+    return (*u.f)(L, ci, jc->mcode + jc->entry[pc]);
+#else
+    lua_assert(0);  /* 'luaJ_canrun' was false */
+    return JIT_INTERP;
+#endif
+  }
+}
+
+
+
+/*
+** {======================================================
+** Precompiled C ('luac -C')
+** =======================================================
+*/
+
+typedef struct LoadS {
+  const char *s;
+  size_t size;
+} LoadS;
+
+
+static const char *getS (lua_State *L, void *ud, size_t *size) {
+  LoadS *ls = (LoadS *)ud;
+  UNUSED(L);
+  if (ls->size == 0) return NULL;
+  *size = ls->size;
+  ls->size = 0;
+  return ls->s;
+}
+
+
+/* attach native code to 'p' and its nested functions, in preorder */
+static int attach (Proto *p, const NativeFunction *f, int n, int i) {
+  int j;
+  if (i >= n) return n + 1;  /* too few functions */
+  p->native = f[i++];
+  p->hotcount = 0;  /* never compile it */
+  for (j = 0; j < p->sizep; j++)
+    i = attach(p->p[j], f, n, i);
+  return i;
+}
+
+
+/*
+** load the binary chunk 'chunk' (as 'lua_load' does) and attach to its
+** functions the code that 'luac -C' generated for them
+*/
+int luaJ_loadnative (lua_State *L, const char *chunk, size_t size,
+                     const char *name, const NativeFunction *f, int n) {
+  LoadS ls;
+  int status;
+  ls.s = chunk;
+  ls.size = size;
+  status = lua_load(L, getS, &ls, name, "b");
+  if (status == LUA_OK) {
+    lua_lock(L);
+    if (attach(clLvalue(L->top - 1)->p, f, n, 0) != n) {
+      L->top--;  /* remove loaded function */
+      luaO_pushfstring(L, "%s: precompiled code does not match chunk", name);
+      status = LUA_ERRSYNTAX;
+    }
+    lua_unlock(L);
+  }
+  return status;
+}
+
+/* }====================================================== */
+
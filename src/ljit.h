@@ -0,0 +1,62 @@
+/*
+** $Id: ljit.h $
+** Native code: baseline compiler to x86-64 and precompiled C
+** See Copyright Notice in lua.h
+*/
+
+#ifndef ljit_h
+#define ljit_h
+
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lstate.h"
+
+
+/* results of 'luaJ_execute' */
+#define JIT_INTERP	1	/* continue interpreting at 'savedpc' */
+#define JIT_NEWFRAME	2	/* a Lua function was called: run its frame */
+
+
+/*
+** helper for each opcode: executes the instruction before 'pc', which
+** it saves as the frame's 'savedpc'. Tests return true to skip the next
+** instruction, loops return true to jump back, OP_FORPREP returns the
+** result of 'luaV_forprep' and OP_CALL returns 0 or a 'luaJ_execute'
+** result. The entry for OP_JMP only closes upvalues. Instructions left
+** to the interpreter (returns and tail calls) have no helper.
+*/
+typedef int (*JitHelper) (lua_State *L, const Instruction *pc);
+
+LUAI_DDEC const JitHelper luaJ_helper[NUM_OPCODES];
+
+
+/* whether a frame of 'p' can run as native code now */
+/* 函数原型p的帧当前是否可以以本地代码执行 */
+#define luaJ_canrun(L,p) \
+	(((p)->jit != NULL || (p)->native != NULL) && \
+	 !((L)->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)))
+
+LUAI_FUNC int luaJ_execute (lua_State *L, CallInfo *ci);
+LUAI_FUNC int luaJ_loadnative (lua_State *L, const char *chunk, size_t size,
+                               const char *name, const NativeFunction *f,
+                               int n);
+
+
+#if defined(LUA_USE_JIT)
+
+/* count a call or a loop iteration of 'p'; compile it once it is hot */
+/* 记录函数原型p的一次调用或循环,足够频繁时编译它 */
+#define luaJ_hot(L,p) \
+	{ if ((p)->hotcount > 0 && --(p)->hotcount == 0) luaJ_compile(L, p); }
+
+LUAI_FUNC void luaJ_compile (lua_State *L, Proto *p);
+LUAI_FUNC void luaJ_free (lua_State *L, Proto *p);
+
+#else
+
+#define luaJ_hot(L,p)		((void)0)
+#define luaJ_free(L,p)		((void)0)
+
+#endif
+
+#endif
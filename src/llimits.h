@@ -21,6 +21,10 @@ typedef LUAI_UMEM lu_mem;
 
 typedef LUAI_MEM l_mem;
 
+/* unsigned version of lua_Integer (for modular arithmetic) */
+/* 无符号的lua_Integer */
+typedef LUAI_UINTEGER lu_integer;
+
 
 
 /* chars used as small naturals (so that `char' is reserved for characters) */
@@ -23,8 +23,26 @@
 
 
 
+/*
+** pushes an integral float as an integer when it fits (keeping -0 and
+** values out of the integer range as floats)
+*/
+static void pushnumint (lua_State *L, lua_Number d) {
+  if (d >= (lua_Number)LUA_MININTEGER && d < -(lua_Number)LUA_MININTEGER &&
+      (d != 0 || 1/d > 0))
+    lua_pushinteger(L, (lua_Integer)d);
+  else
+    lua_pushnumber(L, d);
+}
+
+
 static int math_abs (lua_State *L) {
-  lua_pushnumber(L, l_mathop(fabs)(luaL_checknumber(L, 1)));
+  if (lua_isinteger(L, 1) && lua_tointeger(L, 1) != LUA_MININTEGER) {
+    lua_Integer n = lua_tointeger(L, 1);
+    lua_pushinteger(L, (n < 0) ? -n : n);
+  }
+  else
+    lua_pushnumber(L, l_mathop(fabs)(luaL_checknumber(L, 1)));
   return 1;
 }
 
@@ -80,12 +98,18 @@ static int math_atan2 (lua_State *L) {
 }
 
 static int math_ceil (lua_State *L) {
-  lua_pushnumber(L, l_mathop(ceil)(luaL_checknumber(L, 1)));
+  if (lua_isinteger(L, 1))
+    lua_settop(L, 1);  /* integer is its own ceiling */
+  else
+    pushnumint(L, l_mathop(ceil)(luaL_checknumber(L, 1)));
   return 1;
 }
 
 static int math_floor (lua_State *L) {
-  lua_pushnumber(L, l_mathop(floor)(luaL_checknumber(L, 1)));
+  if (lua_isinteger(L, 1))
+    lua_settop(L, 1);  /* integer is its own floor */
+  else
+    pushnumint(L, l_mathop(floor)(luaL_checknumber(L, 1)));
   return 1;
 }
 
@@ -207,14 +231,14 @@ static int math_random (lua_State *L) {
     case 1: {  /* only upper limit */
       lua_Number u = luaL_checknumber(L, 1);
       luaL_argcheck(L, (lua_Number)1.0 <= u, 1, "interval is empty");
-      lua_pushnumber(L, l_mathop(floor)(r*u) + (lua_Number)(1.0));  /* [1, u] */
+      pushnumint(L, l_mathop(floor)(r*u) + (lua_Number)(1.0));  /* [1, u] */
       break;
     }
     case 2: {  /* lower and upper limits */
       lua_Number l = luaL_checknumber(L, 1);
       lua_Number u = luaL_checknumber(L, 2);
       luaL_argcheck(L, l <= u, 2, "interval is empty");
-      lua_pushnumber(L, l_mathop(floor)(r*(u-l+1)) + l);  /* [l, u] */
+      pushnumint(L, l_mathop(floor)(r*(u-l+1)) + l);  /* [l, u] */
       break;
     }
     default: return luaL_error(L, "wrong number of arguments");
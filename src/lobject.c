@@ -28,6 +28,28 @@
 LUAI_DDEF const TValue luaO_nilobject_ = {NILCONSTANT};
 
 
+#if defined(LUA_NANTRICK)
+
+/* tags of the codes of boxed values (code 0 is not used) */
+/* 从编码得到类型标志 */
+LUAI_DDEF const lu_byte luaO_code2tag[16] = {
+  0, LUA_TNIL, LUA_TBOOLEAN, LUA_TLIGHTUSERDATA, LUA_TLCF, LUA_TNUMINT,
+  LUA_TDEADKEY, ctb(LUA_TSHRSTR), ctb(LUA_TLNGSTR), ctb(LUA_TTABLE),
+  ctb(LUA_TLCL), ctb(LUA_TCCL), ctb(LUA_TUSERDATA), ctb(LUA_TTHREAD), 0, 0
+};
+
+/* codes of all tags, for tags only known at run time */
+/* 从类型标志得到编码 */
+#define TC4(t)	tagcode(t), tagcode(t+1), tagcode(t+2), tagcode(t+3)
+#define TC16(t)	TC4(t), TC4(t+4), TC4(t+8), TC4(t+12)
+LUAI_DDEF const lu_byte luaO_tag2code[BIT_ISCOLLECTABLE << 1] = {
+  TC16(0), TC16(16), TC16(32), TC16(48),
+  TC16(64), TC16(80), TC16(96), TC16(112)
+};
+
+#endif
+
+
 /*
 ** converts an integer to a "floating point byte", represented as
 ** (eeeeexxx), where the real value is (1xxx) * 2^(eeeee - 1) if
@@ -73,8 +95,8 @@ int luaO_ceillog2 (unsigned int x) {
   return l + log_2[x];
 }
 
-/* 进行算数操作 */
-lua_Number luaO_arith (int op, lua_Number v1, lua_Number v2) {
+/* 浮点数算数操作 */
+static lua_Number numarith (int op, lua_Number v1, lua_Number v2) {
   switch (op) {
     case LUA_OPADD: return luai_numadd(NULL, v1, v2);    /* 加 */
     case LUA_OPSUB: return luai_numsub(NULL, v1, v2);    /* 减 */
@@ -87,18 +109,43 @@ lua_Number luaO_arith (int op, lua_Number v1, lua_Number v2) {
   }
 }
 
+
+/*
+** try to do an arithmetic operation over integers; returns 0 when
+** the operation must be done over floats (division, power, overflows)
+*/
+/* 整数算数操作,失败时返回0 */
+static int intarith (int op, lua_Integer i1, lua_Integer i2, lua_Integer *r) {
+  switch (op) {
+    case LUA_OPADD: return !luai_intadd(NULL, *r, i1, i2);
+    case LUA_OPSUB: return !luai_intsub(NULL, *r, i1, i2);
+    case LUA_OPMUL: return !luai_intmul(NULL, *r, i1, i2);
+    case LUA_OPMOD: return !luai_intmod(NULL, *r, i1, i2);
+    case LUA_OPUNM: return !luai_intunm(NULL, *r, i1);
+    default: return 0;  /* LUA_OPDIV and LUA_OPPOW always use floats */
+  }
+}
+
+
+/* 进行算数操作,两个整数的结果尽量保持为整数 */
+void luaO_arith (int op, const TValue *p1, const TValue *p2, TValue *res) {
+  lua_Integer i;
+  if (ttisinteger(p1) && ttisinteger(p2) &&
+      intarith(op, ivalue(p1), ivalue(p2), &i)) {
+    setivalue(res, i);
+  }
+  else {
+    lua_Number n = numarith(op, nvalue(p1), nvalue(p2));
+    setnvalue(res, n);
+  }
+}
+
 /* 将asnii字符的16进制c转换乘对应的整型值 */
 int luaO_hexavalue (int c) {
   if (lisdigit(c)) return c - '0';
   else return ltolower(c) - 'a' + 10;
 }
 
-/* 这里定义 lua_strx2number函数,将字符串转换成整型 */
-#if !defined(lua_strx2number)
-
-#include <math.h>
-
-
 static int isneg (const char **s) {
   if (**s == '-') { (*s)++; return 1; }
   else if (**s == '+') (*s)++;
@@ -106,6 +153,12 @@ static int isneg (const char **s) {
 }
 
 
+/* 这里定义 lua_strx2number函数,将字符串转换成整型 */
+#if !defined(lua_strx2number)
+
+#include <math.h>
+
+
 static lua_Number readhexa (const char **s, lua_Number r, int *count) {
   for (; lisxdigit(cast_uchar(**s)); (*s)++) {  /* read integer part */
     r = (r * cast_num(16.0)) + cast_num(luaO_hexavalue(cast_uchar(**s)));
@@ -166,7 +219,7 @@ static lua_Number lua_strx2number (const char *s, char **endptr) {
  */
 int luaO_str2d (const char *s, size_t len, lua_Number *result) {
   char *endptr;
-	/* 判断字符串是否是无限 'nN' */
+	/* 判断字符串是否是无限 'nN' */
   if (strpbrk(s, "nN"))  /* reject 'inf' and 'nan' */
     return 0;
 	/* 字符串是16进制 */
@@ -180,13 +233,51 @@ int luaO_str2d (const char *s, size_t len, lua_Number *result) {
 }
 
 
+/*
+** convert a numeral without fractional part or exponent to an integer;
+** fails (returns 0) if the numeral has other characters or if its value
+** does not fit in a lua_Integer
+*/
+/* 将字符串转换成整数,超出整数范围时失败 */
+int luaO_str2int (const char *s, size_t len, lua_Integer *result) {
+  const char *e = s + len;
+  lu_integer a = 0;
+  lu_integer lim = cast(lu_integer, LUA_MAXINTEGER);
+  int empty = 1;
+  int neg;
+  while (lisspace(cast_uchar(*s))) s++;  /* skip initial spaces */
+  neg = isneg(&s);
+  if (neg) lim++;  /* one more for the minimum integer */
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {  /* hexa? */
+    for (s += 2; lisxdigit(cast_uchar(*s)); s++) {
+      int d = luaO_hexavalue(cast_uchar(*s));
+      if (a > (lim - d) / 16) return 0;  /* overflow */
+      a = a * 16 + d;
+      empty = 0;
+    }
+  }
+  else {  /* decimal */
+    for (; lisdigit(cast_uchar(*s)); s++) {
+      int d = *s - '0';
+      if (a > (lim - d) / 10) return 0;  /* overflow */
+      a = a * 10 + d;
+      empty = 0;
+    }
+  }
+  while (lisspace(cast_uchar(*s))) s++;  /* skip trailing spaces */
+  if (empty || s != e) return 0;  /* something wrong in the numeral */
+  *result = cast(lua_Integer, neg ? 0u - a : a);
+  return 1;
+}
+
+
 /* 对栈中压入字符串 */
 static void pushstr (lua_State *L, const char *str, size_t l) {
   setsvalue2s(L, L->top++, luaS_newlstr(L, str, l));
 }
 
 
-/* this function handles only `%d', `%c', %f, %p, and `%s' formats */
+/* this function handles only `%d', `%I', `%c', %f, %p, and `%s' formats */
 /* 压入一个带有格式化类型字符串 */
 const char *luaO_pushvfstring (lua_State *L, const char *fmt, va_list argp) {
   int n = 0;
@@ -213,7 +304,17 @@ const char *luaO_pushvfstring (lua_State *L, const char *fmt, va_list argp) {
         break;
       }
       case 'd': {
-        setnvalue(L->top++, cast_num(va_arg(argp, int)));
+        setivalue(L->top++, cast(lua_Integer, va_arg(argp, int)));
+        break;
+      }
+      case 'I': {
+        lua_Integer i = cast(lua_Integer, va_arg(argp, LUA_INTEGER));
+        if (luai_intfits(i)) {
+          setivalue(L->top++, i);
+        }
+        else {
+          setnvalue(L->top++, cast_num(i));
+        }
         break;
       }
       case 'f': {
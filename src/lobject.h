@@ -23,11 +23,13 @@
 #define LUA_TPROTO	LUA_NUMTAGS
 #define LUA_TUPVAL	(LUA_NUMTAGS+1)
 #define LUA_TDEADKEY	(LUA_NUMTAGS+2)
+#define LUA_TSHAPE	(LUA_NUMTAGS+3)
 
 /*
-** number of all possible tags (including LUA_TNONE but excluding DEADKEY)
+** number of all possible tags (including LUA_TNONE but excluding DEADKEY
+** and SHAPE)
 */
-/* 不包括DEADKEY类型的类型总计数 */
+/* 不包括DEADKEY与SHAPE类型的类型总计数 */
 #define LUA_TOTALTAGS	(LUA_TUPVAL+2)
 
 
@@ -62,6 +64,16 @@
 #define LUA_TCCL	(LUA_TFUNCTION | (2 << 4))  /* C closure */
 
 
+/*
+** LUA_TNUMBER variants:
+** 0 - float number (lua_Number)
+** 1 - integer number (lua_Integer)
+*/
+/* 数字类型: 浮点数与整数 */
+#define LUA_TNUMFLT	(LUA_TNUMBER | (0 << 4))  /* float numbers */
+#define LUA_TNUMINT	(LUA_TNUMBER | (1 << 4))  /* integer numbers */
+
+
 /* Variant tags for strings */
 /* 字符串类型 */
 #define LUA_TSHRSTR	(LUA_TSTRING | (0 << 4))  /* short strings */
@@ -112,7 +124,8 @@ typedef struct GCheader {
 typedef union Value Value;
 
 /* 数字区域 */
-#define numfield	lua_Number n;    /* numbers */
+#define numfield	lua_Number n;    /* float numbers */
+#define intfield	lua_Integer i;   /* integer numbers */
 
 
 
@@ -136,6 +149,11 @@ typedef struct lua_TValue TValue;
 /* 取对象的值相关 */
 #define val_(o)		((o)->value_)
 #define num_(o)		(val_(o).n)
+#define ivalue_(o)	(val_(o).i)
+#define gcvalue_(o)	(val_(o).gc)
+#define pvalue_(o)	(val_(o).p)
+#define bvalue_(o)	(val_(o).b)
+#define fvalue_(o)	(val_(o).f)
 
 
 /* raw type tag of a TValue */
@@ -163,7 +181,9 @@ typedef struct lua_TValue TValue;
 /*
  * 检查对象类型
  */
-#define ttisnumber(o)		checktag((o), LUA_TNUMBER)                      /* 判断对象是否是数字类型 */
+#define ttisnumber(o)		checktype((o), LUA_TNUMBER)                     /* 判断对象是否是数字类型(整数或浮点数) */
+#define ttisfloat(o)		checktag((o), LUA_TNUMFLT)                      /* 浮点数 */
+#define ttisinteger(o)		checktag((o), LUA_TNUMINT)                    /* 整数 */
 #define ttisnil(o)		checktag((o), LUA_TNIL)                           /* 判断对象是否为空对象类型 */
 #define ttisboolean(o)		checktag((o), LUA_TBOOLEAN)                   /* 判断对象是否为布尔对象类型 */
 #define ttislightuserdata(o)	checktag((o), LUA_TLIGHTUSERDATA)         /* 判断对象是否为轻型用户数据类型 */
@@ -185,23 +205,28 @@ typedef struct lua_TValue TValue;
 
 /* Macros to access values */
 /* 测试对象类型并且返回这个对象的值 */
-#define nvalue(o)	check_exp(ttisnumber(o), num_(o))                     /* 获取数字的值 */
-#define gcvalue(o)	check_exp(iscollectable(o), val_(o).gc)             /* 获取可回首对象的值 */
-#define pvalue(o)	check_exp(ttislightuserdata(o), val_(o).p)            /* 获取轻型用户数据的值 */
-#define rawtsvalue(o)	check_exp(ttisstring(o), &val_(o).gc->ts)         /* 获取原始字符串的值 */
+#define fltvalue(o)	check_exp(ttisfloat(o), num_(o))                    /* 获取浮点数的值 */
+#define ivalue(o)	check_exp(ttisinteger(o), ivalue_(o))                 /* 获取整数的值 */
+/* value of any number, converted to a float */
+/* 获取数字的值(整数转为浮点数) */
+#define nvalue(o)	check_exp(ttisnumber(o), \
+	(ttisinteger(o) ? cast_num(ivalue_(o)) : num_(o)))
+#define gcvalue(o)	check_exp(iscollectable(o), gcvalue_(o))             /* 获取可回首对象的值 */
+#define pvalue(o)	check_exp(ttislightuserdata(o), pvalue_(o))            /* 获取轻型用户数据的值 */
+#define rawtsvalue(o)	check_exp(ttisstring(o), &gcvalue_(o)->ts)         /* 获取原始字符串的值 */
 #define tsvalue(o)	(&rawtsvalue(o)->tsv)                               /* 获取原始字符串的值的缓冲指针 */
-#define rawuvalue(o)	check_exp(ttisuserdata(o), &val_(o).gc->u)        /* 获取原始值 */
+#define rawuvalue(o)	check_exp(ttisuserdata(o), &gcvalue_(o)->u)        /* 获取原始值 */
 #define uvalue(o)	(&rawuvalue(o)->uv)
-#define clvalue(o)	check_exp(ttisclosure(o), &val_(o).gc->cl)          /* 闭包函数的值 */
-#define clLvalue(o)	check_exp(ttisLclosure(o), &val_(o).gc->cl.l)       /* lua闭包函数的值 */
-#define clCvalue(o)	check_exp(ttisCclosure(o), &val_(o).gc->cl.c)       /* c闭包函数的值 */
-#define fvalue(o)	check_exp(ttislcf(o), val_(o).f)                      /* 获取函数 */
-#define hvalue(o)	check_exp(ttistable(o), &val_(o).gc->h)               /* 获取哈希表的值 */
-#define bvalue(o)	check_exp(ttisboolean(o), val_(o).b)                  /* 获取布尔类型的值 */
-#define thvalue(o)	check_exp(ttisthread(o), &val_(o).gc->th)           /* 获取线程 */
+#define clvalue(o)	check_exp(ttisclosure(o), &gcvalue_(o)->cl)          /* 闭包函数的值 */
+#define clLvalue(o)	check_exp(ttisLclosure(o), &gcvalue_(o)->cl.l)       /* lua闭包函数的值 */
+#define clCvalue(o)	check_exp(ttisCclosure(o), &gcvalue_(o)->cl.c)       /* c闭包函数的值 */
+#define fvalue(o)	check_exp(ttislcf(o), fvalue_(o))                      /* 获取函数 */
+#define hvalue(o)	check_exp(ttistable(o), &gcvalue_(o)->h)               /* 获取哈希表的值 */
+#define bvalue(o)	check_exp(ttisboolean(o), bvalue_(o))                  /* 获取布尔类型的值 */
+#define thvalue(o)	check_exp(ttisthread(o), &gcvalue_(o)->th)           /* 获取线程 */
 /* a dead value may get the 'gc' field, but cannot access its contents */
 /* dead值，可以访问 'gc'区域，但是不能访问它的内容 */
-#define deadvalue(o)	check_exp(ttisdeadkey(o), cast(void *, val_(o).gc))
+#define deadvalue(o)	check_exp(ttisdeadkey(o), cast(void *, gcvalue_(o)))
 
 /* 对象的值是false */
 #define l_isfalse(o)	(ttisnil(o) || (ttisboolean(o) && bvalue(o) == 0))
@@ -230,29 +255,37 @@ typedef struct lua_TValue TValue;
 /* 设置对象属性 */
 #define settt_(o,t)	((o)->tt_=(t))
 
+/* set a collectable object 'x' with tag 't' */
+/* 设置可回收对象的值与类型 */
+#define setgcvalue_(o,x,t)	{ gcvalue_(o)=(x); settt_(o, t); }
+
 /* 给对象设置数字的值 */
 #define setnvalue(obj,x) \
-  { TValue *io=(obj); num_(io)=(x); settt_(io, LUA_TNUMBER); }
+  { TValue *io=(obj); num_(io)=(x); settt_(io, LUA_TNUMFLT); }
+
+/* 给对象设置整数的值 */
+#define setivalue(obj,x) \
+  { TValue *io=(obj); ivalue_(io)=(x); settt_(io, LUA_TNUMINT); }
 
 /* 设置对象为nil值 */
 #define setnilvalue(obj) settt_(obj, LUA_TNIL)
 
 /* 设置对象为C轻量级函数 */
 #define setfvalue(obj,x) \
-  { TValue *io=(obj); val_(io).f=(x); settt_(io, LUA_TLCF); }
+  { TValue *io=(obj); fvalue_(io)=(x); settt_(io, LUA_TLCF); }
 
 /* 设置对象为轻量级用户数据 */
 #define setpvalue(obj,x) \
-  { TValue *io=(obj); val_(io).p=(x); settt_(io, LUA_TLIGHTUSERDATA); }
+  { TValue *io=(obj); pvalue_(io)=(x); settt_(io, LUA_TLIGHTUSERDATA); }
 
 /* 设置对象为布尔类型 */
 #define setbvalue(obj,x) \
-  { TValue *io=(obj); val_(io).b=(x); settt_(io, LUA_TBOOLEAN); }
+  { TValue *io=(obj); bvalue_(io)=(x); settt_(io, LUA_TBOOLEAN); }
 
 /* 设置对象为可回收对象 */
 #define setgcovalue(L,obj,x) \
   { TValue *io=(obj); GCObject *i_g=(x); \
-    val_(io).gc=i_g; settt_(io, ctb(gch(i_g)->tt)); }
+    setgcvalue_(io, i_g, ctb(gch(i_g)->tt)); }
 
 /* 设置给字符串对象设置值
  * L 虚拟机状态
@@ -262,37 +295,37 @@ typedef struct lua_TValue TValue;
 #define setsvalue(L,obj,x) \
   { TValue *io=(obj); \
     TString *x_ = (x); \
-    val_(io).gc=cast(GCObject *, x_); settt_(io, ctb(x_->tsv.tt)); \
+    setgcvalue_(io, cast(GCObject *, x_), ctb(x_->tsv.tt)); \
     checkliveness(G(L),io); }
 
 /* 设置用户数据给对象 */
 #define setuvalue(L,obj,x) \
   { TValue *io=(obj); \
-    val_(io).gc=cast(GCObject *, (x)); settt_(io, ctb(LUA_TUSERDATA)); \
+    setgcvalue_(io, cast(GCObject *, (x)), ctb(LUA_TUSERDATA)); \
     checkliveness(G(L),io); }
 
 /* 设置给对象的线程值 */
 #define setthvalue(L,obj,x) \
   { TValue *io=(obj); \
-    val_(io).gc=cast(GCObject *, (x)); settt_(io, ctb(LUA_TTHREAD)); \
+    setgcvalue_(io, cast(GCObject *, (x)), ctb(LUA_TTHREAD)); \
     checkliveness(G(L),io); }
 
 /* 设置给对象的lua函数 */
 #define setclLvalue(L,obj,x) \
   { TValue *io=(obj); \
-    val_(io).gc=cast(GCObject *, (x)); settt_(io, ctb(LUA_TLCL)); \
+    setgcvalue_(io, cast(GCObject *, (x)), ctb(LUA_TLCL)); \
     checkliveness(G(L),io); }
 
 /* 设置给对象的轻量C函数 */
 #define setclCvalue(L,obj,x) \
   { TValue *io=(obj); \
-    val_(io).gc=cast(GCObject *, (x)); settt_(io, ctb(LUA_TCCL)); \
+    setgcvalue_(io, cast(GCObject *, (x)), ctb(LUA_TCCL)); \
     checkliveness(G(L),io); }
 
 /* 设置给对象设置哈希表值 */
 #define sethvalue(L,obj,x) \
   { TValue *io=(obj); \
-    val_(io).gc=cast(GCObject *, (x)); settt_(io, ctb(LUA_TTABLE)); \
+    setgcvalue_(io, cast(GCObject *, (x)), ctb(LUA_TTABLE)); \
     checkliveness(G(L),io); }
 
 /* 设置为对象已死亡 */
@@ -337,81 +370,104 @@ typedef struct lua_TValue TValue;
 #if defined(LUA_NANTRICK)
 
 /*
-** numbers are represented in the 'd_' field. All other values have the
-** value (NNMARK | tag) in 'tt__'. A number with such pattern would be
-** a "signaled NaN", which is never generated by regular operations by
-** the CPU (nor by 'strtod')
+** Every value is a single 64-bit word. Floats are stored as they are
+** (NaNs always in the canonical form 'NBCANONNAN'); all other values are
+** negative quiet NaNs: the 13 top bits set, a 4-bit code for the tag and
+** a 47-bit payload (a pointer, a boolean or an integer). Code 0 is not
+** used, so every NaN the CPU may produce is still read as a float.
 */
-
-/* allows for external implementation for part of the trick */
-/* 允许trick部分的扩展继承 */
-#if !defined(NNMARK)	/* { */
-
-/* 如果没有定义LUA_IEEEENDIAN IEEE小端字序 */
-#if !defined(LUA_IEEEENDIAN)
-#error option 'LUA_NANTRICK' needs 'LUA_IEEEENDIAN'
-#endif
-
-
-#define NNMARK		0x7FF7A500
-#define NNMASK		0x7FFFFF00
+/* NaN技巧: 所有的值打包成一个64位字,非浮点数的值放入NaN的空闲位中 */
+
+#define NBSHIFT		47
+#define NBPAYLOAD	((cast(lu_integer, 1) << NBSHIFT) - 1)
+#define NBMARK		(~cast(lu_integer, 0) << 51)  /* 13 top bits */
+#define NBCANONNAN	(cast(lu_integer, 0x7FF8) << 48)
+#define NBINTSIGN	(cast(lu_integer, 1) << (NBSHIFT - 1))
+
+/* codes of boxed tags; collectable values have the highest codes */
+#define tagcode(t)  \
+	((t) == LUA_TNIL ? 1 : (t) == LUA_TBOOLEAN ? 2 : \
+	 (t) == LUA_TLIGHTUSERDATA ? 3 : (t) == LUA_TLCF ? 4 : \
+	 (t) == LUA_TNUMINT ? 5 : (t) == LUA_TDEADKEY ? 6 : \
+	 (t) == ctb(LUA_TSHRSTR) ? 7 : (t) == ctb(LUA_TLNGSTR) ? 8 : \
+	 (t) == ctb(LUA_TTABLE) ? 9 : (t) == ctb(LUA_TLCL) ? 10 : \
+	 (t) == ctb(LUA_TCCL) ? 11 : (t) == ctb(LUA_TUSERDATA) ? 12 : \
+	 (t) == ctb(LUA_TTHREAD) ? 13 : 0)
+#define FIRSTGCCODE	7
+
+/* boxed word with code 'c' (and an empty payload) */
+#define nbbox(c)	(NBMARK | (cast(lu_integer, c) << NBSHIFT))
+/* boxed word for a constant tag 't' */
+#define nbtag(t)	nbbox(tagcode(t))
 
 #undef TValuefields
 #undef NILCONSTANT
+#define TValuefields	union { lu_integer w__; lua_Number d__; } u
+#define NILCONSTANT	{nbtag(LUA_TNIL)}
 
-/* 如果不采用IEEEENDIAN字节序则自行定义 */
-#if (LUA_IEEEENDIAN == 0)	/* { */
-
-/* little endian */
-#define TValuefields  \
-	union { struct { Value v__; int tt__; } i; double d__; } u
-#define NILCONSTANT	{{{NULL}, tag2tt(LUA_TNIL)}}
-/* field-access macros */
-#define v_(o)		((o)->u.i.v__)
-#define d_(o)		((o)->u.d__)
-#define tt_(o)		((o)->u.i.tt__)
-
-#else				/* }{ */
-
-/* big endian */
-#define TValuefields  \
-	union { struct { int tt__; Value v__; } i; double d__; } u
-#define NILCONSTANT	{{tag2tt(LUA_TNIL), {NULL}}}
 /* field-access macros */
-#define v_(o)		((o)->u.i.v__)
+#define w_(o)		((o)->u.w__)
 #define d_(o)		((o)->u.d__)
-#define tt_(o)		((o)->u.i.tt__)
+#define isboxed(o)	(w_(o) >= nbbox(1))
+#define nbcode(o)	cast_int((w_(o) >> NBSHIFT) & 0xF)
+#define payload_(o)	(w_(o) & NBPAYLOAD)
 
-#endif				/* } */
-
-#endif			/* } */
-
-
-/* correspondence with standard representation */
 #undef val_
-#define val_(o)		v_(o)
 #undef num_
+#undef ivalue_
+#undef gcvalue_
+#undef pvalue_
+#undef bvalue_
+#undef fvalue_
 #define num_(o)		d_(o)
-
-
-#undef numfield
-#define numfield	/* no such field; numbers are the entire struct */
-
-/* basic check to distinguish numbers from non-numbers */
-#undef ttisnumber
-#define ttisnumber(o)	((tt_(o) & NNMASK) != NNMARK)
-
-#define tag2tt(t)	(NNMARK | (t))
+#define ivalue_(o)  \
+	(cast(lua_Integer, payload_(o) ^ NBINTSIGN) - \
+	 cast(lua_Integer, NBINTSIGN))
+#define gcvalue_(o)	cast(GCObject *, cast(size_t, payload_(o)))
+#define pvalue_(o)	cast(void *, cast(size_t, payload_(o)))
+#define bvalue_(o)	cast_int(payload_(o))
+#define fvalue_(o)	cast(lua_CFunction, cast(size_t, payload_(o)))
 
 #undef rttype
-#define rttype(o)	(ttisnumber(o) ? LUA_TNUMBER : tt_(o) & 0xff)
+#define rttype(o)	(isboxed(o) ? luaO_code2tag[nbcode(o)] : LUA_TNUMFLT)
 
 #undef settt_
-#define settt_(o,t)	(tt_(o) = tag2tt(t))
+#define settt_(o,t)	(w_(o) = payload_(o) | nbtag(t))
+
+/* pointers must fit in the payload */
+#define nbptr(o,x,c)  \
+	{ size_t p_ = cast(size_t, (x)); lua_assert(p_ <= NBPAYLOAD); \
+	  w_(o) = nbbox(c) | cast(lu_integer, p_); }
+
+#undef setgcvalue_
+#define setgcvalue_(o,x,t)	nbptr(o, x, luaO_tag2code[t])
 
 #undef setnvalue
 #define setnvalue(obj,x) \
-	{ TValue *io_=(obj); num_(io_)=(x); lua_assert(ttisnumber(io_)); }
+	{ TValue *io_=(obj); lua_Number n_=(x); \
+	  if (n_ != n_) w_(io_) = NBCANONNAN;  /* NaN? */ \
+	  else d_(io_) = n_; }
+
+#undef setivalue
+#define setivalue(obj,x) \
+	{ TValue *io_=(obj); lua_Integer i_=(x); lua_assert(luai_intfits(i_)); \
+	  w_(io_) = nbtag(LUA_TNUMINT) | (cast(lu_integer, i_) & NBPAYLOAD); }
+
+#undef setnilvalue
+#define setnilvalue(obj)	(w_(obj) = nbtag(LUA_TNIL))
+
+#undef setfvalue
+#define setfvalue(obj,x) \
+	{ TValue *io_=(obj); nbptr(io_, x, tagcode(LUA_TLCF)); }
+
+#undef setpvalue
+#define setpvalue(obj,x) \
+	{ TValue *io_=(obj); nbptr(io_, x, tagcode(LUA_TLIGHTUSERDATA)); }
+
+#undef setbvalue
+#define setbvalue(obj,x) \
+	{ TValue *io_=(obj); \
+	  w_(io_) = nbtag(LUA_TBOOLEAN) | cast(lu_integer, (x) != 0); }
 
 #undef setobj
 #define setobj(L,obj1,obj2) \
@@ -425,17 +481,19 @@ typedef struct lua_TValue TValue;
 */
 
 #undef checktag
-#undef checktype
-#define checktag(o,t)	(tt_(o) == tag2tt(t))
-#define checktype(o,t)	(ctb(tt_(o) | VARBITS) == ctb(tag2tt(t) | VARBITS))
+#define checktag(o,t)	((w_(o) & ~NBPAYLOAD) == nbtag(t))
+
+#undef ttisnumber
+#undef ttisfloat
+#define ttisfloat(o)	(!isboxed(o))
+#define ttisnumber(o)	(ttisfloat(o) || ttisinteger(o))
 
 #undef ttisequal
 #define ttisequal(o1,o2)  \
-	(ttisnumber(o1) ? ttisnumber(o2) : (tt_(o1) == tt_(o2)))
+	(isboxed(o1) ? ((w_(o1) ^ w_(o2)) & ~NBPAYLOAD) == 0 : !isboxed(o2))
 
-
-#undef luai_checknum
-#define luai_checknum(L,o,c)	{ if (!ttisnumber(o)) c; }
+#undef iscollectable
+#define iscollectable(o)	(w_(o) >= nbbox(FIRSTGCCODE))
 
 #endif
 /* }====================================================== */
@@ -461,6 +519,8 @@ union Value {
   lua_CFunction f; /* light C functions */
 	/* 数字 */
   numfield         /* numbers */
+	/* 整数 */
+  intfield         /* integer numbers */
 };
 
 /* lua元素结构体 
@@ -548,6 +608,14 @@ typedef struct LocVar {
 } LocVar;
 
 
+/*
+** Native code for a function: runs the frame 'ci' from its 'savedpc'
+** (see ljit.c)
+*/
+/* 函数的本地代码,从savedpc开始执行调用帧ci */
+typedef int (*NativeFunction) (struct lua_State *L, struct CallInfo *ci);
+
+
 /*
 ** Function Prototypes
 */
@@ -566,6 +634,8 @@ typedef struct Proto {
   LocVar *locvars;  /* information about local variables (debug information) */
 	/* upvalue信息 */
   Upvaldesc *upvalues;  /* upvalue information */
+	/* 内联缓存,每条指令一个,记录健所在的节点索引 */
+  int *icache;  /* inline caches (node slots), one per instruction */
 	/* 这个函数原型最后创建的closure */
   union Closure *cache;  /* last created closure with this prototype */
 	/* 源代码,调试所需 */
@@ -574,11 +644,18 @@ typedef struct Proto {
   int sizeupvalues;  /* size of 'upvalues' */
   int sizek;  /* size of `k' */
   int sizecode;
+  int sizeicache;
   int sizelineinfo;
   int sizep;  /* size of `p' */
   int sizelocvars;
   int linedefined;
   int lastlinedefined;
+	/* 编译后的机器码 */
+  struct JitCode *jit;  /* machine code for this function (see ljit.c) */
+	/* 预编译的C代码 */
+  NativeFunction native;  /* code precompiled by 'luac -C' */
+	/* 距离编译还剩余的调用与循环次数 */
+  int hotcount;  /* calls and loop iterations left before compiling it */
 	/* 可回收对象的列表 */
   GCObject *gclist;
 	/* 固定参数的数量 */
@@ -644,11 +721,7 @@ typedef union Closure {
 ** Tables
 */
 /* 哈希表的健 */
-typedef union TKey {
-  struct {
-    TValuefields;
-    struct Node *next;  /* for chaining */
-  } nk;
+typedef struct TKey {
   TValue tvk;
 } TKey;
 
@@ -658,24 +731,108 @@ typedef struct Node {
   TKey i_key;             /* 节点的健 */
 } Node;
 
+/*
+** shapes describe the keys of record-like tables: a shaped table keeps
+** no hash part, only the values of its string keys in 'fields', in the
+** order of 'keys'. Shapes are shared by all tables with the same keys
+** added in the same order (see ltable.c).
+*/
+/* 形状: 记录类型的表的健的布局,由健相同(且加入次序相同)的表共享 */
+typedef struct Shape {
+  CommonHeader;
+	/* 健的数量 */
+  lu_byte nkeys;
+	/* 健索引的大小,以log2计算 */
+  lu_byte lsizeindex;  /* log2 of size of the key index */
+	/* 在转换表中的哈希值 */
+  unsigned int hash;  /* hash of ('parent', last key) */
+	/* 少了最后一个健的形状 */
+  struct Shape *parent;  /* shape without the last key */
+	/* 转换表中的下一个形状 */
+  struct Shape *hnext;  /* chain in the transition table */
+	/* 健,其后是健的索引 */
+  TString *keys[1];  /* 'nkeys' keys, followed by their index */
+} Shape;
+
+
+/*
+** old hash part of a table that grows incrementally (see ltable.c),
+** allocated only while its entries move to the new part
+*/
+/* 渐进增长的表的旧哈希部分,只在其中的健迁移时存在 */
+typedef struct OldPart {
+	/* 旧节点数组,其后是它们的控制字节 */
+  Node *node;  /* old nodes, followed by their control bytes */
+	/* 新节点中尚未计入垃圾回收器债务的内存大小 */
+  lu_mem debt;  /* size of the new part not charged to the collector yet */
+	/* 下一个要迁移的节点 */
+  int next;  /* entries in 'node' before this one were moved */
+	/* 旧节点数量,以log2计算 */
+  lu_byte lsizenode;  /* log2 of size of 'node' array */
+} OldPart;
+
+
+/*
+** header of a hash part, right before its nodes (see 'gnodehead')
+*/
+/* 哈希部分的头部,位于节点之前 */
+typedef union NodeHeader {
+  struct {
+	/* 渐进增长时尚未迁移完的旧哈希部分,否则为NULL */
+    OldPart *old;  /* old hash part while it is moved, or NULL */
+	/* 还可以使用的空节点数量 */
+    int hfree;  /* number of empty nodes that may still be used */
+	/* luaH_next最后返回的元素的位置 */
+    int lastnext;  /* the last entry returned by 'luaH_next' */
+	/* 已计数的节点数量 */
+    int ncounted;  /* keys in nodes before this one were counted */
+	/* 已计数的健的数量(见ltable.c) */
+    int nlive;  /* number of keys counted (see 'countkeys') */
+  } h;
+  L_Umaxalign dummy;  /* ensures maximum alignment for the nodes */
+} NodeHeader;
+
+
+/*
+** fields of a shaped table (see ltable.c), allocated only for tables
+** that have a shape
+*/
+/* 有形状的表的字段 */
+typedef struct Fields {
+	/* 表的形状 */
+  Shape *shape;  /* keys of the table */
+	/* 字段数组的长度 */
+  lu_byte size;  /* size of 'v' */
+	/* 健的值,次序与形状中的健相同 */
+  TValue v[1];  /* values of the keys in 'shape' */
+} Fields;
+
+
 /* 表 */
 typedef struct Table {
   CommonHeader;
   lu_byte flags;  /* 1<<p means tagmethod(p) is not present */
 	/* 节点数量,以log2计算 */
   lu_byte lsizenode;  /* log2 of size of `node' array */
+	/* 紧凑的队列部分中所有值的类型,队列部分不紧凑时为LUA_TNIL */
+  lu_byte packtt;  /* tag of all values in a packed `array', or LUA_TNIL */
+	/* 哈希部分是否可能有适合放入队列部分的整数健 */
+  lu_byte intkeys;  /* hash part may have keys for the array part */
 	/* 节点原表 */
   struct Table *metatable;
 	/* 队列部分 */
   TValue *array;  /* array part */
-	/* 表节点链表 */
-  Node *node;
-	/* 任意空闲的位置在这个位置之前 */
-  Node *lastfree;  /* any free position is before this position */
+	/* 表节点数组,其前是头部,其后是节点的控制字节(空或者健哈希值的标记) */
+  Node *node;  /* hash part, after its header and followed by its control
+                  bytes (see ltable.c) */
+	/* 有形状的表的形状和字段,没有形状的表为NULL */
+  Fields *fields;  /* shape and values of a shaped table, or NULL */
 	/* 可回收对象列表 */
   GCObject *gclist;
 	/* 哈希队列长度,根长度 */
   int sizearray;  /* size of `array' array */
+	/* 表是序列时为其长度,否则为-1(见invalidateborder) */
+  int border;  /* length of a sequence, or -1 (see invalidateborder) */
 } Table;
 
 
@@ -704,12 +861,20 @@ typedef struct Table {
 /* nil值 */
 LUAI_DDEC const TValue luaO_nilobject_;
 
+#if defined(LUA_NANTRICK)
+/* tag <-> 4-bit code conversion for boxed values */
+LUAI_DDEC const lu_byte luaO_code2tag[16];
+LUAI_DDEC const lu_byte luaO_tag2code[BIT_ISCOLLECTABLE << 1];
+#endif
+
 
 LUAI_FUNC int luaO_int2fb (unsigned int x);
 LUAI_FUNC int luaO_fb2int (int x);
 LUAI_FUNC int luaO_ceillog2 (unsigned int x);
-LUAI_FUNC lua_Number luaO_arith (int op, lua_Number v1, lua_Number v2);
+LUAI_FUNC void luaO_arith (int op, const TValue *p1, const TValue *p2,
+                           TValue *res);
 LUAI_FUNC int luaO_str2d (const char *s, size_t len, lua_Number *result);
+LUAI_FUNC int luaO_str2int (const char *s, size_t len, lua_Integer *result);
 LUAI_FUNC int luaO_hexavalue (int c);
 LUAI_FUNC const char *luaO_pushvfstring (lua_State *L, const char *fmt,
                                                        va_list argp);
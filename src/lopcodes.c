@@ -23,10 +23,15 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "GETUPVAL",
   "GETTABUP",
   "GETTABLE",
+  "GETFIELD",
+  "GETI",
   "SETTABUP",
   "SETUPVAL",
   "SETTABLE",
+  "SETFIELD",
+  "SETI",
   "NEWTABLE",
+  "NEWTEMPL",
   "SELF",
   "ADD",
   "SUB",
@@ -44,6 +49,7 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "LE",
   "TEST",
   "TESTSET",
+  "SWITCH",
   "CALL",
   "TAILCALL",
   "RETURN",
@@ -55,6 +61,19 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSURE",
   "VARARG",
   "EXTRAARG",
+  "QADDF",
+  "QSUBF",
+  "QMULF",
+  "QEQS",
+  "QLTN",
+  "QLEN",
+  "GETTABUP_F",
+  "GETFIELD_F",
+  "GETTABUP_C",
+  "SELF_C",
+  "MOVE_C",
+  "LOADK_C",
+  "APPEND",
   NULL
 };
 
@@ -71,10 +90,15 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_GETUPVAL */
  ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUP */
  ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLE */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETFIELD */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETI */
  ,opmode(0, 0, OpArgK, OpArgK, iABC)		/* OP_SETTABUP */
  ,opmode(0, 0, OpArgU, OpArgN, iABC)		/* OP_SETUPVAL */
  ,opmode(0, 0, OpArgK, OpArgK, iABC)		/* OP_SETTABLE */
+ ,opmode(0, 0, OpArgK, OpArgK, iABC)		/* OP_SETFIELD */
+ ,opmode(0, 0, OpArgK, OpArgK, iABC)		/* OP_SETI */
  ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_NEWTABLE */
+ ,opmode(0, 1, OpArgK, OpArgN, iABx)		/* OP_NEWTEMPL */
  ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_SELF */
  ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADD */
  ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUB */
@@ -92,6 +116,7 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LE */
  ,opmode(1, 0, OpArgN, OpArgU, iABC)		/* OP_TEST */
  ,opmode(1, 1, OpArgR, OpArgU, iABC)		/* OP_TESTSET */
+ ,opmode(0, 0, OpArgK, OpArgN, iABx)		/* OP_SWITCH */
  ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_CALL */
  ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_TAILCALL */
  ,opmode(0, 0, OpArgU, OpArgN, iABC)		/* OP_RETURN */
@@ -103,5 +128,35 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
  ,opmode(0, 0, OpArgU, OpArgU, iAx)		/* OP_EXTRAARG */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QADDF */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QSUBF */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_QMULF */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_QEQS */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_QLTN */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_QLEN */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUP_F */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETFIELD_F */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUP_C */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_SELF_C */
+ ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_MOVE_C */
+ ,opmode(0, 1, OpArgK, OpArgN, iABx)		/* OP_LOADK_C */
+ ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_APPEND */
+};
+
+
+LUAI_DDEF const lu_byte luaP_opgeneric[NUM_OPCODES - OP_FIRSTQUICK] = {
+  OP_ADD,	/* OP_QADDF */
+  OP_SUB,	/* OP_QSUBF */
+  OP_MUL,	/* OP_QMULF */
+  OP_EQ,	/* OP_QEQS */
+  OP_LT,	/* OP_QLTN */
+  OP_LE,	/* OP_QLEN */
+  OP_GETTABUP,	/* OP_GETTABUP_F */
+  OP_GETFIELD,	/* OP_GETFIELD_F */
+  OP_GETTABUP,	/* OP_GETTABUP_C */
+  OP_SELF,	/* OP_SELF_C */
+  OP_MOVE,	/* OP_MOVE_C */
+  OP_LOADK,	/* OP_LOADK_C */
+  OP_LEN	/* OP_APPEND */
 };
 
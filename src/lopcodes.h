@@ -188,12 +188,17 @@ OP_GETUPVAL,/*	A B	R(A) := UpValue[B]				*/
 
 OP_GETTABUP,/*	A B C	R(A) := UpValue[B][RK(C)]			*/
 OP_GETTABLE,/*	A B C	R(A) := R(B)[RK(C)]				*/
+OP_GETFIELD,/*	A B C	R(A) := R(B)[RK(C)]	(K(C) is a short string) */
+OP_GETI,/*	A B C	R(A) := R(B)[RK(C)]	(K(C) is an integer)	*/
 
 OP_SETTABUP,/*	A B C	UpValue[A][RK(B)] := RK(C)			*/
 OP_SETUPVAL,/*	A B	UpValue[B] := R(A)				*/
 OP_SETTABLE,/*	A B C	R(A)[RK(B)] := RK(C)				*/
+OP_SETFIELD,/*	A B C	R(A)[RK(B)] := RK(C)	(K(B) is a short string) */
+OP_SETI,/*	A B C	R(A)[RK(B)] := RK(C)	(K(B) is an integer)	*/
 
 OP_NEWTABLE,/*	A B C	R(A) := {} (size = B,C)				*/
+OP_NEWTEMPL,/*	A Bx	R(A) := copy of the template Kst(Bx)		*/
 
 OP_SELF,/*	A B C	R(A+1) := R(B); R(A) := R(B)[RK(C)]		*/
 
@@ -216,6 +221,7 @@ OP_LE,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++		*/
 
 OP_TEST,/*	A C	if not (R(A) <=> C) then pc++			*/
 OP_TESTSET,/*	A B C	if (R(B) <=> C) then R(A) := R(B) else pc++	*/
+OP_SWITCH,/*	A Bx	if R(A) is a key of Kst(Bx) then pc += Kst(Bx)[R(A)] */
 
 OP_CALL,/*	A B C	R(A), ... ,R(A+C-2) := R(A)(R(A+1), ... ,R(A+B-1)) */
 OP_TAILCALL,/*	A B C	return R(A)(R(A+1), ... ,R(A+B-1))		*/
@@ -234,11 +240,41 @@ OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
 
 OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 
-OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
+OP_EXTRAARG,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/* quickened opcodes (see notes below) */
+OP_QADDF,/*	A B C	R(A) := RK(B) + RK(C)		(both floats)	*/
+OP_QSUBF,/*	A B C	R(A) := RK(B) - RK(C)		(both floats)	*/
+OP_QMULF,/*	A B C	R(A) := RK(B) * RK(C)		(both floats)	*/
+OP_QEQS,/*	A B C	if ((RK(B) == RK(C)) ~= A) then pc++ (short strings) */
+OP_QLTN,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++	(numbers) */
+OP_QLEN,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++	(numbers) */
+
+/* superinstructions (see notes below) */
+OP_GETTABUP_F,/* A B C	OP_GETTABUP, then the OP_GETFIELD after it	*/
+OP_GETFIELD_F,/* A B C	OP_GETFIELD, then the OP_GETFIELD after it	*/
+OP_GETTABUP_C,/* A B C	OP_GETTABUP, then the OP_CALL after it		*/
+OP_SELF_C,/*	A B C	OP_SELF, then the OP_CALL after it		*/
+OP_MOVE_C,/*	A B	OP_MOVE, then the OP_CALL after it		*/
+OP_LOADK_C,/*	A Bx	OP_LOADK, then the OP_CALL after it		*/
+OP_APPEND/*	A B	OP_LEN, then the OP_ADD and OP_SETTABLE after it */
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_EXTRAARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_APPEND) + 1)
+
+/* first quickened opcode */
+#define OP_FIRSTQUICK	OP_QADDF
+
+/* first superinstruction */
+#define OP_FIRSTFUSED	OP_GETTABUP_F
+
+#define isquickop(o)	((o) >= OP_FIRSTQUICK && (o) < OP_FIRSTFUSED)
+
+/* generic opcode of an instruction, which may be quickened or fused */
+#define GET_GENOPCODE(i)  \
+	(GET_OPCODE(i) < OP_FIRSTQUICK ? GET_OPCODE(i) : \
+	 cast(OpCode, luaP_opgeneric[GET_OPCODE(i) - OP_FIRSTQUICK]))
 
 
 
@@ -258,11 +294,41 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
 
   (*) In OP_LOADKX, the next 'instruction' is always EXTRAARG.
 
+  (*) In OP_NEWTEMPL, Kst(Bx) is a table built by the compiler for a
+  constructor with only constant string keys: the new table gets a copy
+  of its parts, which already have all the keys (see 'constructor' in
+  lparser.c).
+
   (*) For comparisons, A specifies what condition the test should accept
   (true or false).
 
   (*) All `skips' (pc++) assume that next instruction is a jump.
 
+  (*) In OP_SWITCH, Kst(Bx) is a table built by the compiler for a run
+  of 'if'/'elseif' tests of the same local variable against distinct
+  constants: it maps each constant to the offset of the block of its
+  test. When R(A) is not a key, the next instruction (a jump) goes to
+  where the last test of the run would go (see 'luaK_switch').
+
+  (*) Quickened opcodes are never generated by the compiler. The VM
+  writes one over a generic instruction after seeing the operand types
+  it is specialized for, and writes the generic opcode back when its
+  guard fails. They keep the operands of their generic opcode, never
+  call metamethods, and must not be seen outside the VM: code that
+  inspects instructions uses GET_GENOPCODE.
+
+  (*) Superinstructions are written by the code generator over the
+  first instruction of a frequent pair (luaK_fuse). The second
+  instruction stays in place, so jumps to it still work; the VM runs it
+  right after the first one, without dispatching it. Everything else
+  sees the first instruction (GET_GENOPCODE).
+
+  (*) OP_APPEND covers 'LEN c t; ADD c c 1; SETTABLE t c v', the code
+  of 't[#t+1] = v' (see 'luaK_append'). For a table without metatable
+  the VM appends 'v' at once and skips the other two instructions;
+  otherwise it runs them after OP_LEN, as with any superinstruction.
+  Machine code (ljit.c) does the same, through its own helper.
+
 ===========================================================================*/
 
 
@@ -293,6 +359,9 @@ LUAI_DDEC const lu_byte luaP_opmodes[NUM_OPCODES];
 
 LUAI_DDEC const char *const luaP_opnames[NUM_OPCODES+1];  /* opcode names */
 
+/* generic opcodes of the quickened and fused ones */
+LUAI_DDEC const lu_byte luaP_opgeneric[NUM_OPCODES - OP_FIRSTQUICK];
+
 
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
@@ -560,6 +560,8 @@ static void close_func (LexState *ls) {
   leaveblock(fs);
   luaM_reallocvector(L, f->code, f->sizecode, fs->pc, Instruction);
   f->sizecode = fs->pc;
+  luaK_fuse(f);  /* superinstructions */
+  luaF_newicache(L, f);
   luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
   f->sizelineinfo = fs->pc;
   luaM_reallocvector(L, f->k, f->sizek, fs->nk, TValue);
@@ -640,21 +642,82 @@ static void yindex (LexState *ls, expdesc *v) {
 */
 
 
+/*
+** While all the `record' keys of a constructor are distinct constant
+** short strings, they are kept as the keys of a template: a table
+** built by the compiler, which OP_NEWTEMPL copies to create the new
+** table with all its keys. Constant values go into the template too
+** (their stores are not emitted); other values are stored by
+** OP_SETFIELD. Any other key ends the template, emitting the pending
+** stores of constant values.
+*/
 struct ConsControl {
   expdesc v;  /* last list item read */
   expdesc *t;  /* table descriptor */
   int nh;  /* total number of `record' elements */
   int na;  /* total number of array elements */
   int tostore;  /* number of array elements pending to be stored */
+  int ntk;  /* number of keys in the template (-1 if there is none) */
+  int tk[MAXSHAPE];  /* keys of the template (constant indices) */
+  int tv[MAXSHAPE];  /* their constant values (or -1 if not constant) */
 };
 
 
+/* 健rkkey是否可以加入模板 */
+static int templatekey (FuncState *fs, struct ConsControl *cc, int rkkey) {
+  int i;
+  if (!ISK(rkkey) || !ttisshrstring(&fs->f->k[INDEXK(rkkey)]) ||
+      cc->ntk == MAXSHAPE)
+    return 0;
+  for (i = 0; i < cc->ntk; i++)
+    if (cc->tk[i] == INDEXK(rkkey)) return 0;  /* repeated key */
+  return 1;
+}
+
+
+/* 放弃模板,生成其中常量值的存储指令 */
+static void flushtemplate (FuncState *fs, struct ConsControl *cc) {
+  int i;
+  for (i = 0; i < cc->ntk; i++)
+    if (cc->tv[i] >= 0)
+      luaK_codeABC(fs, OP_SETTABLE, cc->t->u.info,
+                   RKASK(cc->tk[i]), RKASK(cc->tv[i]));
+  cc->ntk = -1;
+}
+
+
+/* 创建模板,将构造函数的OP_NEWTABLE(在pc处)换成OP_NEWTEMPL */
+static void maketemplate (FuncState *fs, struct ConsControl *cc, int pc) {
+  lua_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  Table *t;
+  int i;
+  if (fs->nk > MAXARG_Bx) {  /* template would not fit in the instruction? */
+    flushtemplate(fs, cc);
+    return;
+  }
+  t = luaH_new(L);
+  sethvalue(L, L->top, t);  /* anchor it */
+  incr_top(L);
+  luaH_presize(L, t, luaO_fb2int(GETARG_B(f->code[pc])), cc->ntk);
+  for (i = 0; i < cc->ntk; i++) {
+    TValue *o = luaH_addfield(L, t, rawtsvalue(&f->k[cc->tk[i]]));
+    if (cc->tv[i] >= 0)
+      setobj2t(L, o, &f->k[cc->tv[i]]);
+  }
+  invalidateTMcache(t);  /* copies may become metatables */
+  f->code[pc] = CREATE_ABx(OP_NEWTEMPL, GETARG_A(f->code[pc]),
+                           luaK_tableK(fs, t));
+  L->top--;
+}
+
+
 static void recfield (LexState *ls, struct ConsControl *cc) {
   /* recfield -> (NAME | `['exp1`]') = exp1 */
   FuncState *fs = ls->fs;
   int reg = ls->fs->freereg;
   expdesc key, val;
-  int rkkey;
+  int rkkey, rkval;
   if (ls->t.token == TK_NAME) {
     checklimit(fs, cc->nh, MAX_INT, "items in a constructor");
     checkname(ls, &key);
@@ -664,8 +727,18 @@ static void recfield (LexState *ls, struct ConsControl *cc) {
   cc->nh++;
   checknext(ls, '=');
   rkkey = luaK_exp2RK(fs, &key);
+  if (cc->ntk >= 0 && !templatekey(fs, cc, rkkey))
+    flushtemplate(fs, cc);
   expr(ls, &val);
-  luaK_codeABC(fs, OP_SETTABLE, cc->t->u.info, rkkey, luaK_exp2RK(fs, &val));
+  rkval = luaK_exp2RK(fs, &val);
+  if (cc->ntk < 0)
+    luaK_codeABC(fs, OP_SETTABLE, cc->t->u.info, rkkey, rkval);
+  else {  /* a key of the template */
+    cc->tk[cc->ntk] = INDEXK(rkkey);
+    cc->tv[cc->ntk++] = ISK(rkval) ? INDEXK(rkval) : -1;
+    if (!ISK(rkval))
+      luaK_codeABC(fs, OP_SETFIELD, cc->t->u.info, rkkey, rkval);
+  }
   fs->freereg = reg;  /* free registers */
 }
 
@@ -734,7 +807,7 @@ static void constructor (LexState *ls, expdesc *t) {
   int line = ls->linenumber;
   int pc = luaK_codeABC(fs, OP_NEWTABLE, 0, 0, 0);
   struct ConsControl cc;
-  cc.na = cc.nh = cc.tostore = 0;
+  cc.na = cc.nh = cc.tostore = cc.ntk = 0;
   cc.t = t;
   init_exp(t, VRELOCABLE, pc);
   init_exp(&cc.v, VVOID, 0);  /* no value (yet) */
@@ -750,6 +823,8 @@ static void constructor (LexState *ls, expdesc *t) {
   lastlistfield(fs, &cc);
   SETARG_B(fs->f->code[pc], luaO_int2fb(cc.na)); /* set initial array size */
   SETARG_C(fs->f->code[pc], luaO_int2fb(cc.nh));  /* set initial table size */
+  if (cc.ntk > 0)  /* keys make a template? */
+    maketemplate(fs, &cc, pc);
 }
 
 /* }====================================================================== */
@@ -943,6 +1018,11 @@ static void simpleexp (LexState *ls, expdesc *v) {
       v->u.nval = ls->t.seminfo.r;
       break;
     }
+    case TK_INT: {
+      init_exp(v, VKINT, 0);
+      v->u.ival = ls->t.seminfo.i;
+      break;
+    }
     case TK_STRING: {
       codestring(ls, v, ls->t.seminfo.ts);
       break;
@@ -1321,7 +1401,7 @@ static void fornum (LexState *ls, TString *varname, int line) {
   if (testnext(ls, ','))
     exp1(ls);  /* optional step */
   else {  /* default step = 1 */
-    luaK_codek(fs, fs->freereg, luaK_numberK(fs, 1));
+    luaK_codek(fs, fs->freereg, luaK_intK(fs, 1));
     luaK_reserveregs(fs, 1);
   }
   forbody(ls, base, line, 1, 1);
@@ -1371,12 +1451,24 @@ static void forstat (LexState *ls, int line) {
 }
 
 
-static void test_then_block (LexState *ls, int *escapelist) {
+/*
+** minimum number of consecutive clauses of an 'if' testing the same
+** local variable against constants to code them as an OP_SWITCH
+*/
+#define MINSWITCH	4
+
+
+/*
+** returns the position of the test of the clause when it is a case
+** test (see 'luaK_casetest'), or -1
+*/
+static int test_then_block (LexState *ls, int *escapelist) {
   /* test_then_block -> [IF | ELSEIF] cond THEN block */
   BlockCnt bl;
   FuncState *fs = ls->fs;
   expdesc v;
   int jf;  /* instruction to skip 'then' code (if condition is false) */
+  int test = -1;
   luaX_next(ls);  /* skip IF or ELSEIF */
   expr(ls, &v);  /* read condition */
   checknext(ls, TK_THEN);
@@ -1387,12 +1479,13 @@ static void test_then_block (LexState *ls, int *escapelist) {
     skipnoopstat(ls);  /* skip other no-op statements */
     if (block_follow(ls, 0)) {  /* 'goto' is the entire block? */
       leaveblock(fs);
-      return;  /* and that is it */
+      return -1;  /* and that is it */
     }
     else  /* must skip over 'then' part if condition is false */
       jf = luaK_jump(fs);
   }
   else {  /* regular case (not goto/break) */
+    test = luaK_casetest(fs, &v);
     luaK_goiftrue(ls->fs, &v);  /* skip over block if condition is false */
     enterblock(fs, &bl, 0);
     jf = v.f;
@@ -1403,16 +1496,36 @@ static void test_then_block (LexState *ls, int *escapelist) {
       ls->t.token == TK_ELSEIF)  /* followed by 'else'/'elseif'? */
     luaK_concat(fs, escapelist, luaK_jump(fs));  /* must jump over it */
   luaK_patchtohere(fs, jf);
+  return test;
 }
 
 
+/*
+** runs of at least MINSWITCH clauses whose conditions are case tests of
+** the same variable become an OP_SWITCH, which goes straight to the
+** block of the matching clause
+*/
+/* 连续多个以同一局部变量与常量比较为条件的子句被编译为OP_SWITCH */
 static void ifstat (LexState *ls, int line) {
   /* ifstat -> IF cond THEN block {ELSEIF cond THEN block} [ELSE block] END */
   FuncState *fs = ls->fs;
   int escapelist = NO_JUMP;  /* exit list for finished parts */
-  test_then_block(ls, &escapelist);  /* IF cond THEN block */
-  while (ls->t.token == TK_ELSEIF)
-    test_then_block(ls, &escapelist);  /* ELSEIF cond THEN block */
+  int first = -1;  /* test of the first clause of the current run */
+  int n = 0;  /* number of clauses in the current run */
+  int test = test_then_block(ls, &escapelist);  /* IF cond THEN block */
+  for (;;) {
+    if (test >= 0 && n > 0 &&
+        GETARG_B(fs->f->code[test]) == GETARG_B(fs->f->code[first]))
+      n++;  /* run goes on */
+    else {
+      if (n >= MINSWITCH) luaK_switch(fs, first, n);
+      first = test;
+      n = (test >= 0);
+    }
+    if (ls->t.token != TK_ELSEIF) break;
+    test = test_then_block(ls, &escapelist);  /* ELSEIF cond THEN block */
+  }
+  if (n >= MINSWITCH) luaK_switch(fs, first, n);
   if (testnext(ls, TK_ELSE))
     block(ls);  /* `else' part */
   check_match(ls, TK_END, TK_IF, line);
@@ -1481,10 +1594,13 @@ static void exprstat (LexState *ls) {
   /* stat -> func | assignment */
   FuncState *fs = ls->fs;
   struct LHS_assign v;
+  int pc = fs->pc;
   suffixedexp(ls, &v.v);
   if (ls->t.token == '=' || ls->t.token == ',') { /* stat -> assignment ? */
     v.prev = NULL;
     assignment(ls, &v, 1);
+    if (v.v.k == VINDEXED && fs->pc - pc > 2)  /* maybe 't[#t+1] = v'? */
+      luaK_append(fs, pc);
   }
   else {  /* stat -> func */
     check_condition(ls, v.v.k == VCALL, "syntax error");
@@ -23,6 +23,7 @@ typedef enum {
   VFALSE,
   VK,		/* info = index of constant in `k' */
   VKNUM,	/* nval = numerical value */
+  VKINT,	/* ival = integer value */
   VNONRELOC,	/* info = result register */
   VLOCAL,	/* info = local register */
   VUPVAL,       /* info = index of upvalue in 'upvalues' */
@@ -47,6 +48,7 @@ typedef struct expdesc {
     } ind;
     int info;  /* for generic use */
     lua_Number nval;  /* for VKNUM */
+    lua_Integer ival;  /* for VKINT */
   } u;
   int t;  /* patch list of `exit when true' */
   int f;  /* patch list of `exit when false' */
@@ -65,6 +65,14 @@ typedef struct stringtable {
   int size;
 } stringtable;
 
+/* 形状转换表 */
+typedef struct shapetable {
+  struct Shape **hash;
+	/* 形状的个数 */
+  int nuse;  /* number of shapes */
+  int size;
+} shapetable;
+
 
 /*
 ** information about a call
@@ -150,6 +158,8 @@ typedef struct global_State {
   lu_mem GCestimate;  /* an estimate of the non-garbage memory in use */
 	/* 哈希字符串表 */
   stringtable strt;  /* hash table for strings */
+	/* 形状转换表 */
+  shapetable shapet;  /* shapes by (parent, last key) */
   TValue l_registry;
 	/* 哈希算法随机种子 */
   unsigned int seed;  /* randomized seed for hashes */
@@ -255,6 +265,7 @@ union GCObject {
   struct Table h;          /* 哈希表 */
   struct Proto p;          /* lua函数 */
   struct UpVal uv;         /* upval值 */
+  struct Shape sh;         /* 表的形状 */
 	/* 线程状态 */
   struct lua_State th;  /* thread */
 };
@@ -276,6 +287,7 @@ union GCObject {
 #define gco2t(o)	check_exp((o)->gch.tt == LUA_TTABLE, &((o)->h))
 #define gco2p(o)	check_exp((o)->gch.tt == LUA_TPROTO, &((o)->p))
 #define gco2uv(o)	check_exp((o)->gch.tt == LUA_TUPVAL, &((o)->uv))
+#define gco2sh(o)	check_exp((o)->gch.tt == LUA_TSHAPE, &((o)->sh))
 #define gco2th(o)	check_exp((o)->gch.tt == LUA_TTHREAD, &((o)->th))
 
 /* macro to convert any Lua object into a GCObject */
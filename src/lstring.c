@@ -108,7 +108,8 @@ static TString *createstrobj (lua_State *L, const char *str, size_t l,
   ts->tsv.len = l;
   ts->tsv.hash = h;
   ts->tsv.extra = 0;
-  memcpy(ts+1, str, l*sizeof(char));
+  if (str != NULL)
+    memcpy(ts+1, str, l*sizeof(char));
   ((char *)(ts+1))[l] = '\0';  /* ending 0 */
   return ts;
 }
@@ -171,6 +172,19 @@ TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
 }
 
 
+/*
+** new long string of length 'l' with undefined contents (to be filled
+** right away, before it is hashed or compared)
+*/
+/* 生成一个内容未定义的长字符串,由调用者填充 */
+TString *luaS_createlngstrobj (lua_State *L, size_t l) {
+  lua_assert(l > LUAI_MAXSHORTLEN);
+  if (l + 1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
+    luaM_toobig(L);
+  return createstrobj(L, NULL, l, LUA_TLNGSTR, G(L)->seed, NULL);
+}
+
+
 /*
 ** new zero-terminated string
 */
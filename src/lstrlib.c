@@ -915,21 +915,33 @@ static int str_format (lua_State *L) {
           break;
         }
         case 'd': case 'i': {
-          lua_Number n = luaL_checknumber(L, arg);
-          LUA_INTFRM_T ni = (LUA_INTFRM_T)n;
-          lua_Number diff = n - (lua_Number)ni;
-          luaL_argcheck(L, -1 < diff && diff < 1, arg,
-                        "not a number in proper range");
+          LUA_INTFRM_T ni;
+          if (lua_isinteger(L, arg))  /* no conversion needed */
+            ni = (LUA_INTFRM_T)lua_tointeger(L, arg);
+          else {
+            lua_Number n = luaL_checknumber(L, arg);
+            lua_Number diff;
+            ni = (LUA_INTFRM_T)n;
+            diff = n - (lua_Number)ni;
+            luaL_argcheck(L, -1 < diff && diff < 1, arg,
+                          "not a number in proper range");
+          }
           addlenmod(form, LUA_INTFRMLEN);
           nb = sprintf(buff, form, ni);
           break;
         }
         case 'o': case 'u': case 'x': case 'X': {
-          lua_Number n = luaL_checknumber(L, arg);
-          unsigned LUA_INTFRM_T ni = (unsigned LUA_INTFRM_T)n;
-          lua_Number diff = n - (lua_Number)ni;
-          luaL_argcheck(L, -1 < diff && diff < 1, arg,
-                        "not a non-negative number in proper range");
+          unsigned LUA_INTFRM_T ni;
+          if (lua_isinteger(L, arg) && lua_tointeger(L, arg) >= 0)
+            ni = (unsigned LUA_INTFRM_T)lua_tointeger(L, arg);
+          else {
+            lua_Number n = luaL_checknumber(L, arg);
+            lua_Number diff;
+            ni = (unsigned LUA_INTFRM_T)n;
+            diff = n - (lua_Number)ni;
+            luaL_argcheck(L, -1 < diff && diff < 1, arg,
+                          "not a non-negative number in proper range");
+          }
           addlenmod(form, LUA_INTFRMLEN);
           nb = sprintf(buff, form, ni);
           break;
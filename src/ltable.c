@@ -11,11 +11,62 @@
 ** Non-negative integer keys are all candidates to be kept in the array
 ** part. The actual size of the array is the largest `n' such that at
 ** least half the slots between 0 and n are in use.
-** Hash uses a mix of chained scatter table with Brent's variation.
-** A main invariant of these tables is that, if an element is not
-** in its main position (i.e. the `original' position that its hash gives
-** to it), then the colliding element is in its own main position.
-** Hence even when the load factor reaches 100%, performance remains good.
+** While all its values are numbers of the same subtype, stored without
+** holes, the array part is packed: it keeps only their 'Value's (half
+** the size of TValues). A store that breaks this (another type, a hole,
+** removing an element other than the last) unpacks it; a resize packs
+** it again when its values allow. Packed values have no address as
+** TValues, so functions returning pointers to values copy them out.
+** Hash uses open addressing. Besides its nodes, the hash part has one
+** control byte per node: CEMPTY for a node that never held a key, or
+** a 7-bit tag taken from the hash of the key it holds. Nodes are probed
+** in aligned groups of GROUPSIZE, comparing all control bytes of a group
+** with the tag at once, so only keys whose tag matches are compared. A
+** search stops at the first group with an empty node. As keys are never
+** removed (a removed entry keeps its key with a nil value), no
+** tombstones are needed; new keys reuse such entries when probing.
+** Only nodes holding keys are initialized (when they get their key), so
+** that allocating a large hash part does not touch all its memory; the
+** contents of other nodes must not be used.
+** When the hash part is full, 'rehash' counts the keys to choose new
+** sizes for both parts. The table remembers whether its hash part ever
+** got a key that could go to the array part ('intkeys'); without one,
+** a full array part keeps its size and is not counted, as the new key
+** cannot change it either (a part with nils may have to shrink). A
+** packed array part is counted from its size alone.
+** Hash parts of LUAI_INCRHASH nodes or more grow incrementally: the
+** new part (twice as large, or as large when most entries of the full
+** part were removed) takes the new keys, while the entries of
+** the old part move to it a few at a time, at each insertion (not at
+** collector steps, which would move entries under a traversal). Keys
+** are counted the same way while the last free nodes of a part are
+** used, so that choosing the size of the new part takes no pass over
+** the full one, and the collector is charged for the new part as the
+** entries move rather than all at once. The old part, the position of
+** its next entry to move and that charge are kept apart (in an
+** 'OldPart'), allocated only while the part grows. Until the
+** old part is empty, searches, traversals and the collector look in
+** both parts; only 'luaH_resize' (and so 'rehash') and 'luaH_copy'
+** move all its entries in one step. A hash part keeps in a header,
+** right before its nodes, the count of its empty nodes that may still
+** be used, the old part while it grows, and the position of the last
+** entry returned by 'luaH_next', so that a traversal through
+** 'lua_next' finds the key it gets back there without searching for
+** it (but for keys in an old part); generic 'for' loops keep that
+** position themselves (see 'luaV_tforcall'). Searches never move
+** entries, so pointers to values stay valid until the next insertion
+** of a key. These, the shape below, and the count of a packed array
+** part are kept out of the 'Table' itself, so that tables that do not
+** use them stay small.
+** Tables built by constructors with a few fields start with a shape
+** instead of a hash part: the shape lists their short-string keys, and
+** the table keeps only the values, in the same order, in a 'Fields'
+** block with its shape.
+** Adding a key moves the table to the shape with that extra key, taken
+** from a global transition table, so tables getting the same keys in
+** the same order share their shape. Any other key that cannot go to the
+** array part (or a key beyond MAXSHAPE) moves the fields to a hash part
+** for good. As in the hash part, a removed field keeps its key.
 */
 
 #include <string.h>
@@ -47,77 +98,261 @@
 
 #define MAXASIZE	(1 << MAXBITS)
 
-/* t 哈希表
- * n 节点的数量
- */
-#define hashpow2(t,n)		(gnode(t, lmod((n), sizenode(t))))
 
-/* 通过字符串类型的哈希值 */
-#define hashstr(t,str)		hashpow2(t, (str)->tsv.hash)
-#define hashboolean(t,p)	hashpow2(t, p)
+/*
+** a packed array part with 'size' elements takes one more 'Value',
+** right before them, for its count of present elements (see
+** 'sizepacked'); an empty one takes no memory and has no count
+*/
+/* 有size个元素的紧凑的队列部分占用的Value数量(多一个用于保存计数) */
+#define packedslots(size)	((size) == 0 ? 0 : (size) + 1)
+/* 紧凑的队列部分的内存块 */
+#define packedblock(t)	((t)->sizearray == 0 ? NULL : packedarray(t) - 1)
+/* 可能为空的紧凑的队列部分中存在的值的数量 */
+#define npacked(t)	((t)->sizearray == 0 ? 0 : sizepacked(t))
 
 
 /*
-** for some types, it is better to avoid modulus by power of 2, as
-** they tend to have many 2 factors.
+** {=============================================================
+** Control bytes and probing
+** ==============================================================
 */
-/* 进行哈希表模个数的运算 
- * ((sizenode(t)-1)|1) 保证操作数不为0
- */
-#define hashmod(t,n)	(gnode(t, ((n) % ((sizenode(t)-1)|1))))
 
-/* 哈希指针值 */
-#define hashpointer(t,p)	hashmod(t, IntPoint(p))
+/* 每组节点的数量 */
+#define GROUPSIZE	16
+
+/* 从未持有健的节点的控制字节 */
+#define CEMPTY		0x80	/* node never held a key */
+/* 小于一组的哈希表中多余的控制字节 */
+#define CSENTINEL	0xFF	/* padding in tables smaller than a group */
+/* 旧节点中已迁移到新节点的健 */
+#define CMOVED		0xFE	/* old node whose entry was moved */
+
+/* 健的标记: 哈希值的最高7位 */
+#define htag(h)		cast_byte((h) >> 25)
+
+/* size个节点的组的数量 */
+#define ngroups(size)	(((size) + GROUPSIZE - 1) / GROUPSIZE)
+
+/* 控制字节的数量(至少一组) */
+#define sizectrl(size)	((size) < GROUPSIZE ? GROUPSIZE : (size))
+
+/* size个节点加上头部和控制字节的内存大小 */
+#define nodebytes(size)	(sizeof(NodeHeader) + \
+	cast(size_t, size) * sizeof(Node) + sizectrl(cast(size_t, size)))
+
+/* 释放有size个节点的哈希部分nd */
+#define freenodes(L,nd,size) \
+	luaM_freemem(L, cast(NodeHeader *, nd) - 1, nodebytes(size))
+
+/*
+** maximum number of keys in a hash part with 'size' nodes: a single
+** group may be full, larger parts keep 1/8 of their nodes empty so that
+** searches for absent keys stop early
+*/
+/* 哈希部分最多可容纳的健数量 */
+#define maxload(size)	((size) <= GROUPSIZE ? (size) : (size) - (size) / 8)
+
+/*
+** number of old nodes moved at each insertion while a hash part grows
+** incrementally. A new part has room for the old entries plus at least
+** 7/32 of the old size (see 'fullhash'), so moving 5 nodes or more per
+** insertion empties the old part before that room is used up;
+** moving more shortens the time during which searches look in two parts.
+*/
+/* 渐进增长时每次插入迁移的旧节点数量 */
+#define MIGRATESTEP	32
+
+/*
+** the keys of a hash part of LUAI_INCRHASH nodes or more are counted
+** COUNTSTEP nodes at each insertion once only COUNTFROM of its free
+** nodes are left, so that the count is ready when the part is full (see
+** 'fullhash'): the last maxload/8 free nodes are more than 1/10 of the
+** nodes, so moving 10 nodes or more per insertion counts them all.
+*/
+/* 大的哈希部分剩余空闲节点不多于COUNTFROM时,每次插入计数COUNTSTEP个节点的健 */
+#define COUNTSTEP	16
+#define COUNTFROM(size)	(maxload(size) / 8)
 
 /* 空哈希节点 */
-#define dummynode		(&dummynode_)
+#define dummynode		(&dummynode_.n)
 /* 阶段n是否为空 */
 #define isdummy(n)		((n) == dummynode)
-/* 空的哈希节点 */
-static const Node dummynode_ = {
-  {NILCONSTANT},  /* value */
-  {{NILCONSTANT, NULL}}  /* key */
+/* 空的哈希节点,其前是头部,其后是它的控制字节(与其他哈希部分一样) */
+static const struct {
+  NodeHeader h;  /* (right before the node, see 'gnodehead') */
+  Node n;
+  lu_byte ctrl[GROUPSIZE];  /* (right after the node, see 'gctrl') */
+} dummynode_ = {
+  {{NULL, 0, 0, 0, 0}},  /* header: no old part, no free nodes, no keys */
+  {{NILCONSTANT},  /* value */
+   {{NILCONSTANT}}},  /* key */
+  {CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY,
+   CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY, CEMPTY}
 };
 
 
+/* index of the lowest bit set in non-zero mask 'm' */
+/* 掩码中最低位的1的索引 */
+#if defined(__GNUC__)
+#define lowbit(m)	__builtin_ctz(m)
+#else
+static int lowbit (unsigned int m) {
+  int i = 0;
+  while (!(m & 1u)) { m >>= 1; i++; }
+  return i;
+}
+#endif
+
+
+/*
+** 'matchbyte' returns a mask with bit 'i' set for each control byte
+** g[i] equal to 'b'; 'matchfull' does the same for the bytes of nodes
+** holding a key (high bit clear)
+*/
+/* 比较一组控制字节 */
+#if LUA_USE_SSE2
+
+#include <emmintrin.h>
+
+static unsigned int matchbyte (const lu_byte *g, lu_byte b) {
+  __m128i c = _mm_loadu_si128(cast(const __m128i *, g));
+  return cast(unsigned int,
+    _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(cast(char, b)))));
+}
+
+static unsigned int matchfull (const lu_byte *g) {
+  __m128i c = _mm_loadu_si128(cast(const __m128i *, g));
+  return cast(unsigned int, ~_mm_movemask_epi8(c)) & 0xFFFFu;
+}
+
+#else
+
+static unsigned int matchbyte (const lu_byte *g, lu_byte b) {
+  unsigned int m = 0;
+  int i;
+  for (i = 0; i < GROUPSIZE; i++)
+    if (g[i] == b) m |= 1u << i;
+  return m;
+}
+
+static unsigned int matchfull (const lu_byte *g) {
+  unsigned int m = 0;
+  int i;
+  for (i = 0; i < GROUPSIZE; i++)
+    if (ctrlisfull(g[i])) m |= 1u << i;
+  return m;
+}
+
+#endif
+
+
+/*
+** run 'hit' for each node 'n' in the probe sequence of hash 'h' whose
+** control byte matches the tag of 'h', in the 'size' nodes 'nd' with
+** control bytes 'ct'. Groups are visited in triangular order (which
+** covers all of them, as their number is a power of 2) until one with an
+** empty node.
+*/
+/* 沿着哈希值h的探测序列,对每个标记匹配的节点n执行hit */
+#define probepart(nd,ct,size,h,n,hit) { \
+  unsigned int pmask_ = ngroups(size) - 1; \
+  unsigned int pg_ = cast(unsigned int, lmod(h, size)) / GROUPSIZE; \
+  unsigned int pstep_ = 0; \
+  lu_byte ptag_ = htag(h); \
+  for (;;) { \
+    const lu_byte *pc_ = (ct) + pg_ * GROUPSIZE; \
+    unsigned int pm_ = matchbyte(pc_, ptag_); \
+    while (pm_ != 0) { \
+      Node *n = &(nd)[pg_ * GROUPSIZE + lowbit(pm_)]; \
+      hit \
+      pm_ &= pm_ - 1; \
+    } \
+    if (matchbyte(pc_, CEMPTY) != 0 || pstep_ == pmask_) break; \
+    pg_ = (pg_ + ++pstep_) & pmask_; \
+  } }
+
+/* probes the hash part of 't' and then its old part, if any */
+/* 探测表t的哈希部分,以及尚未迁移完的旧节点 */
+#define probe(t,h,n,hit) { \
+  probepart((t)->node, gctrl(t), sizenode(t), h, n, hit) \
+  if (isrehashing(t)) \
+    probepart(goldnode(t, 0), goldctrl(t), sizeoldnode(t), h, n, hit) }
+
+/* }============================================================= */
+
+
+/*
+** final mix of a hash value (from MurmurHash3), so that keys differing
+** in a few bits spread over all nodes and tags
+*/
+/* 哈希值的最终混合 */
+static unsigned int mixhash (unsigned int h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+
+/* 通过字符串类型的哈希值 */
+#define hashstr(str)		mixhash((str)->tsv.hash)
+
+
+/*
+** hash for integers: fold the high half of the value into the low half
+** (so that keys differing only in high bits do not collide)
+*/
+/* 整数健的哈希算法 */
+static unsigned int hashint (lua_Integer i) {
+  lu_integer ui = cast(lu_integer, i);
+  if (sizeof(ui) > sizeof(unsigned int))
+    ui ^= ui >> (sizeof(ui) * CHAR_BIT / 2);
+  return mixhash(cast(unsigned int, ui));
+}
+
+
 /*
 ** hash for lua_Numbers
 */
-/* 使用lua_Numbers进行哈希算法
- * t 哈希表
- * n lua_Number类型
- */
-static Node *hashnum (const Table *t, lua_Number n) {
+/* 使用lua_Numbers进行哈希算法 */
+static unsigned int hashnum (lua_Number n) {
   int i;
   luai_hashnum(i, n);
-	/* 如果计算出的i最高位为1 */
-  if (i < 0) {
-		/* 强制转换成 */
-    if (cast(unsigned int, i) == 0u - i)  /* use unsigned to avoid overflows */
-      i = 0;  /* handle INT_MIN */
-		/* 必须是整值 */
-    i = -i;  /* must be a positive value */
-  }
-	/* 获取哈希树的节点位置 */
-  return hashmod(t, i);
+  return mixhash(cast(unsigned int, i));
 }
 
 
 /*
-** returns the `main' position of an element in a table (that is, the index
-** of its hash value)
+** hash for pointers: all their bits count (objects are aligned, and
+** addresses of a heap share their high bits)
 */
-/* 返回在哈希表中的一个元素的主位置
- * t 哈希表指针
+/* 哈希指针值 */
+static unsigned int hashpointer (size_t p) {
+  if (sizeof(p) > sizeof(unsigned int))
+    p ^= p >> (sizeof(p) * CHAR_BIT / 2);
+  return mixhash(cast(unsigned int, p));
+}
+
+
+/*
+** returns the hash of a key; its low bits give the key's `main' position
+** in a table, its high bits its tag
+*/
+/* 返回健的哈希值
  * key 健的值
- * 返回新的节点
  */
-static Node *mainposition (const Table *t, const TValue *key) {
+static unsigned int hashkey (const TValue *key) {
 	/* 判断新值的类型 */
   switch (ttype(key)) {
-		/* 数字型 */
-    case LUA_TNUMBER:
-      return hashnum(t, nvalue(key));
+		/* 整数 */
+    case LUA_TNUMINT:
+      return hashint(ivalue(key));
+		/* 浮点数(整数值的浮点数健已经被转换成了整数) */
+    case LUA_TNUMFLT:
+      return hashnum(fltvalue(key));
 		/* 长字符串类型 */
     case LUA_TLNGSTR: {
 			/* 获取字符串类型指针 */
@@ -129,93 +364,391 @@ static Node *mainposition (const Table *t, const TValue *key) {
         s->tsv.extra = 1;  /* now it has its hash */
       }
 			/* 以哈希值再次进行哈希 */
-      return hashstr(t, rawtsvalue(key));
+      return hashstr(rawtsvalue(key));
     }
 		/* 短字符串直接进行哈希 */
     case LUA_TSHRSTR:
-      return hashstr(t, rawtsvalue(key));
+      return hashstr(rawtsvalue(key));
 		/* 布尔值进行哈希 */
     case LUA_TBOOLEAN:
-      return hashboolean(t, bvalue(key));
+      return mixhash(cast(unsigned int, bvalue(key)));
 		/* 轻型用户数据类型 */
     case LUA_TLIGHTUSERDATA:
-      return hashpointer(t, pvalue(key));
+      return hashpointer(cast(size_t, pvalue(key)));
 		/* 函数类型 */
     case LUA_TLCF:
-      return hashpointer(t, fvalue(key));
+      return hashpointer(cast(size_t, fvalue(key)));
 		/* 默认直接哈希可回收类型 */
     default:
-      return hashpointer(t, gcvalue(key));
+      return hashpointer(cast(size_t, gcvalue(key)));
   }
 }
 
 
+/*
+** {=============================================================
+** Shapes
+** ==============================================================
+*/
+
+/* 转换表的初始大小 */
+#define MINSHAPETSIZE	32
+
+/* 新的有形状的表的形状(没有健) */
+#define emptyshape	(cast(Shape *, &emptyshape_))
+
+/* the shape without keys is never collected (it is always black) nor
+   kept in the transition table */
+/* 没有健的形状,它不会被回收(总为黑色),也不在转换表中 */
+static const Shape emptyshape_ = {
+  NULL, LUA_TSHAPE, bitmask(BLACKBIT),  /* header */
+  0, 0, 0, NULL, NULL, {NULL}
+};
+
+/* 健的索引: 开放定址,存放健的位置加1(0为空) */
+#define shapeindex(s)	cast(lu_byte *, (s)->keys + (s)->nkeys)
+
+
+/*
+** returns the position of 'key' in shape 's', or -1 if it has no such key
+*/
+/* 返回健key在形状s中的位置,没有则返回-1 */
+static int shapefind (const Shape *s, const TString *key) {
+  if (s->nkeys > 0) {
+    const lu_byte *idx = shapeindex(s);
+    int mask = twoto(s->lsizeindex) - 1;
+    int i = cast_int(key->tsv.hash & mask);
+    while (idx[i] != 0) {
+      if (s->keys[idx[i] - 1] == key)
+        return idx[i] - 1;
+      i = (i + 1) & mask;
+    }
+  }
+  return -1;
+}
+
+
+/* 重新设置转换表的大小 */
+void luaH_resizeshapes (lua_State *L, int newsize) {
+  shapetable *st = &G(L)->shapet;
+  Shape **nh = luaM_newvector(L, newsize, Shape *);
+  int i;
+  for (i = 0; i < newsize; i++) nh[i] = NULL;
+  for (i = 0; i < st->size; i++) {  /* rehash all shapes */
+    Shape *s = st->hash[i];
+    while (s != NULL) {
+      Shape *next = s->hnext;
+      int h = lmod(s->hash, newsize);
+      s->hnext = nh[h];
+      nh[h] = s;
+      s = next;
+    }
+  }
+  luaM_freearray(L, st->hash, st->size);
+  st->hash = nh;
+  st->size = newsize;
+}
+
+
+/* 创建形状parent加上健key后的形状 */
+static Shape *newshape (lua_State *L, Shape *parent, TString *key,
+                        unsigned int h) {
+  int n = parent->nkeys + 1;
+  int lsi = luaO_ceillog2(2 * n);  /* index at most half full */
+  int mask = twoto(lsi) - 1;
+  Shape *s = &luaC_newobj(L, LUA_TSHAPE, sizeshape(n, lsi), NULL, 0)->sh;
+  lu_byte *idx;
+  int i;
+  s->nkeys = cast_byte(n);
+  s->lsizeindex = cast_byte(lsi);
+  s->hash = h;
+  s->parent = parent;
+  for (i = 0; i < n - 1; i++)
+    s->keys[i] = parent->keys[i];
+  s->keys[n - 1] = key;
+  idx = shapeindex(s);
+  memset(idx, 0, mask + 1);
+  for (i = 0; i < n; i++) {
+    int j = cast_int(s->keys[i]->tsv.hash & mask);
+    while (idx[j] != 0) j = (j + 1) & mask;
+    idx[j] = cast_byte(i + 1);
+  }
+  return s;
+}
+
+
+/*
+** returns the shape with the keys of 'parent' plus 'key', creating it
+** if needed. Dead shapes (waiting to be swept) are not reused, as their
+** keys may be dead too.
+*/
+/* 返回形状parent加上健key后的形状,需要时创建它 */
+static Shape *transition (lua_State *L, Shape *parent, TString *key) {
+  global_State *g = G(L);
+  unsigned int h = hashpointer(cast(size_t, parent)) ^ key->tsv.hash;
+  Shape *s;
+  Shape **list;
+  if (g->shapet.size > 0) {
+    for (s = g->shapet.hash[lmod(h, g->shapet.size)];
+         s != NULL; s = s->hnext) {
+      if (s->parent == parent && s->keys[s->nkeys - 1] == key &&
+          !isdead(g, obj2gco(s)))
+        return s;
+    }
+  }
+  if (g->shapet.nuse >= g->shapet.size)
+    luaH_resizeshapes(L, g->shapet.size == 0 ? MINSHAPETSIZE
+                                             : g->shapet.size * 2);
+  s = newshape(L, parent, key, h);
+  list = &g->shapet.hash[lmod(h, g->shapet.size)];
+  s->hnext = *list;
+  *list = s;
+  g->shapet.nuse++;
+  return s;
+}
+
+
+/*
+** adds short-string key 'key' (not one of its keys yet) to the fields
+** of shaped table 't', which has less than MAXSHAPE of them; returns
+** the new field, which is nil
+*/
+/* 向有形状的表t增加短字符串健key,返回新的(nil)字段 */
+TValue *luaH_addfield (lua_State *L, Table *t, TString *key) {
+  Shape *s;
+  int n = t->fields->shape->nkeys + 1;
+  if (n > t->fields->size) {  /* grow fields before creating the shape, */
+    int size = t->fields->size * 2;  /* as it is not anchored until then */
+    if (size < n) size = n;
+    if (size > MAXSHAPE) size = MAXSHAPE;
+    t->fields = cast(Fields *, luaM_realloc_(L, t->fields,
+                               sizefields(t->fields->size), sizefields(size)));
+    t->fields->size = cast_byte(size);
+  }
+  s = transition(L, t->fields->shape, key);
+  t->fields->shape = s;
+  luaC_objbarrierback(L, obj2gco(t), s);
+  setnilvalue(&t->fields->v[n - 1]);
+  return &t->fields->v[n - 1];
+}
+
+
+/* 释放形状s */
+void luaH_freeshape (lua_State *L, Shape *s) {
+  shapetable *st = &G(L)->shapet;
+  Shape **p = &st->hash[lmod(s->hash, st->size)];
+  while (*p != s) p = &(*p)->hnext;
+  *p = s->hnext;  /* remove it from the transition table */
+  st->nuse--;
+  luaM_freemem(L, s, sizeshape(s->nkeys, s->lsizeindex));
+}
+
+/* }============================================================= */
+
+
 /*
 ** returns the index for `key' if `key' is an appropriate key to live in
 ** the array part of the table, -1 otherwise.
 */
 static int arrayindex (const TValue *key) {
-  if (ttisnumber(key)) {
-    lua_Number n = nvalue(key);
-    int k;
-    lua_number2int(k, n);
-    if (luai_numeq(cast_num(k), n))
-      return k;
+  if (ttisinteger(key)) {
+    lua_Integer k = ivalue(key);
+    if (0 < k && k <= MAXASIZE)
+      return cast_int(k);
   }
   return -1;  /* `key' did not match some condition */
 }
 
 
+/*
+** floats with integral values are always kept as integer keys;
+** 'normkey' returns the key to be used for 'key' ('aux' holds the
+** converted key when needed)
+*/
+/* 整数值的浮点数健转换成整数健 */
+static const TValue *normkey (const TValue *key, TValue *aux) {
+  lua_Integer k;
+  if (ttisfloat(key) && luaV_flttointeger(fltvalue(key), &k, 0)) {
+    setivalue(aux, k);
+    return aux;
+  }
+  return key;
+}
+
+
 /*
 ** returns the index of a `key' for table traversals. First goes all
-** elements in the array part, then elements in the hash part. The
+** elements in the array part, then elements in the hash part (or the
+** fields), then those in the old hash part while it is moved. The
 ** beginning of a traversal is signaled by -1.
 */
-static int findindex (lua_State *L, Table *t, StkId key) {
+static int findindex (lua_State *L, Table *t, StkId skey) {
   int i;
-  if (ttisnil(key)) return -1;  /* first iteration */
+  TValue aux;
+  const TValue *key;
+  if (ttisnil(skey)) return -1;  /* first iteration */
+  key = normkey(skey, &aux);
   i = arrayindex(key);
   if (0 < i && i <= t->sizearray)  /* is `key' inside array part? */
     return i-1;  /* yes; that's the index (corrected to C) */
+  if (t->fields != NULL) {
+    i = ttisshrstring(key) ? shapefind(t->fields->shape, rawtsvalue(key)) : -1;
+    if (i < 0)
+      luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
+    /* fields are numbered after array elements */
+    return i + t->sizearray;
+  }
   else {
-    Node *n = mainposition(t, key);
-    for (;;) {  /* check whether `key' is somewhere in the chain */
-      /* key may be dead already, but it is ok to use it in `next' */
-      if (luaV_rawequalobj(gkey(n), key) ||
-            (ttisdeadkey(gkey(n)) && iscollectable(key) &&
-             deadvalue(gkey(n)) == gcvalue(key))) {
-        i = cast_int(n - gnode(t, 0));  /* key index in hash table */
-        /* hash elements are numbered after array ones */
-        return i + t->sizearray;
-      }
-      else n = gnext(n);
-      if (n == NULL)
-        luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
+    unsigned int h;
+    int dead = -1;
+    Node *nd = t->node;
+    const lu_byte *ct = gctrl(t);
+    int size = sizenode(t);
+    int base = t->sizearray;  /* hash elements are numbered after array ones */
+    i = gnodehead(t)->lastnext - base;  /* where the last returned key was */
+    if (0 <= i && i < size && ctrlisfull(ct[i]) &&
+        luaV_rawequalobj(gkey(gnode(t, i)), key))
+      return gnodehead(t)->lastnext;  /* key was the last one returned */
+    h = hashkey(key);
+    for (;;) {
+      probepart(nd, ct, size, h, n,
+        if (luaV_rawequalobj(gkey(n), key))
+          return cast_int(n - nd) + base;  /* key index in this part */
+        /* key may be dead already, but it is ok to use it in `next';
+           a live copy of it (inserted again later) takes precedence */
+        else if (dead < 0 && ttisdeadkey(gkey(n)) && iscollectable(key) &&
+                 deadvalue(gkey(n)) == gcvalue(key))
+          dead = cast_int(n - nd) + base;)
+      if (nd != t->node || !isrehashing(t)) break;
+      base += size;  /* old nodes are numbered after new ones */
+      nd = goldnode(t, 0);
+      ct = goldctrl(t);
+      size = sizeoldnode(t);
     }
+    if (dead < 0)
+      luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
+    return dead;
   }
 }
 
 
-int luaH_next (lua_State *L, Table *t, StkId key) {
-  int i = findindex(L, t, key);  /* find original element */
-  for (i++; i < t->sizearray; i++) {  /* try first array part */
+/*
+** puts in 'key' and 'key+1' the entry that follows the one at position
+** 'pos' (the index from 'findindex' plus 1, so 0 starts a traversal)
+** and returns its position, or returns 0 when there are no more
+** entries. Does not move entries of an old hash part (that would
+** change their positions), so a table may be traversed while it grows.
+*/
+/* 取得位置pos之后的元素,返回它的位置(没有更多元素时返回0) */
+int luaH_nextpos (lua_State *L, Table *t, int pos, StkId key) {
+  int i = pos - 1;
+  UNUSED(L);  /* (only checked by 'setobj2s' with assertions on) */
+  lua_assert(pos >= 0);
+  if (ispacked(t)) {  /* try first array part */
+    if (++i < t->sizearray && i < sizepacked(t)) {
+      setivalue(key, cast(lua_Integer, i + 1));
+      getpacked(t, i, key+1);
+      return i + 1;
+    }
+    if (i < t->sizearray) i = t->sizearray;  /* others are nil */
+  }
+  else for (i++; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
-      setnvalue(key, cast_num(i+1));
+      setivalue(key, cast(lua_Integer, i + 1));
       setobj2s(L, key+1, &t->array[i]);
-      return 1;
+      return i + 1;
+    }
+  }
+  if (t->fields != NULL) {  /* then fields */
+    for (i -= t->sizearray; i < t->fields->shape->nkeys; i++) {
+      if (!ttisnil(&t->fields->v[i])) {
+        setsvalue2s(L, key, t->fields->shape->keys[i]);
+        setobj2s(L, key+1, &t->fields->v[i]);
+        return i + t->sizearray + 1;
+      }
     }
+    return 0;
   }
   for (i -= t->sizearray; i < sizenode(t); i++) {  /* then hash part */
-    if (!ttisnil(gval(gnode(t, i)))) {  /* a non-nil value? */
+    if (ctrlisfull(gctrl(t)[i]) && !ttisnil(gval(gnode(t, i)))) {
       setobj2s(L, key, gkey(gnode(t, i)));
       setobj2s(L, key+1, gval(gnode(t, i)));
-      return 1;
+      gnodehead(t)->lastnext = i + t->sizearray;
+      return i + t->sizearray + 1;
+    }
+  }
+  if (isrehashing(t)) {  /* then old part (its keys are searched for) */
+    const lu_byte *ctrl = goldctrl(t);
+    for (i -= sizenode(t); i < sizeoldnode(t); i++) {
+      if (ctrlisfull(ctrl[i]) && !ttisnil(gval(goldnode(t, i)))) {
+        setobj2s(L, key, gkey(goldnode(t, i)));
+        setobj2s(L, key+1, gval(goldnode(t, i)));
+        return i + sizenode(t) + t->sizearray + 1;
+      }
     }
   }
   return 0;  /* no more elements */
 }
 
 
+/* the same, from the entry with key 'key' (nil starts a traversal) */
+int luaH_next (lua_State *L, Table *t, StkId key) {
+  return luaH_nextpos(L, t, findindex(L, t, key) + 1, key);
+}
+
+
+/*
+** returns a node in the probe sequence of hash 'h' that can take a new
+** key: an empty node (while the load limit allows it) or one whose entry
+** was removed (nil value). Searches for absent keys stop at the first
+** group with an empty node, so the key must go there or before. Returns
+** NULL when the table must grow.
+*/
+/* 从一个哈希表中获取可以放置新健的位置 */
+static Node *getfreepos (Table *t, unsigned int h) {
+  unsigned int mask = ngroups(sizenode(t)) - 1;
+  unsigned int g = cast(unsigned int, lmod(h, sizenode(t))) / GROUPSIZE;
+  unsigned int step = 0;
+  if (isdummy(t->node)) return NULL;
+  for (;;) {
+    const lu_byte *c = gctrl(t) + g * GROUPSIZE;
+    unsigned int empty = matchbyte(c, CEMPTY);
+    unsigned int m;
+    if (empty != 0 && gnodehead(t)->hfree > 0)
+      return gnode(t, g * GROUPSIZE + lowbit(empty));
+    for (m = matchfull(c); m != 0; m &= m - 1) {  /* a removed entry? */
+      Node *n = gnode(t, g * GROUPSIZE + lowbit(m));
+      if (ttisnil(gval(n))) return n;
+    }
+    if (empty != 0 || step == mask)
+      return NULL;  /* no more empty nodes may be used */
+    g = (g + ++step) & mask;
+  }
+}
+
+
+/*
+** puts key 'key' with hash 'h' in free node 'n'
+*/
+/* 将健放入空闲节点n */
+static TValue *setkey (lua_State *L, Table *t, Node *n, const TValue *key,
+                       unsigned int h) {
+  UNUSED(L);  /* (only checked by 'setobj2t' with assertions on) */
+  if (gctrl(t)[n - t->node] == CEMPTY) {  /* uses an empty node? */
+    gnodehead(t)->hfree--;
+    setnilvalue(gval(n));  /* initialize it */
+  }
+  if (n - t->node < gnodehead(t)->ncounted)  /* node was counted already? */
+    gnodehead(t)->nlive++;  /* count its new key */
+  gctrl(t)[n - t->node] = htag(h);
+  if (arrayindex(key) > 0)
+    t->intkeys = 1;  /* key may go to the array part in a rehash */
+  setobj2t(L, gkey(n), key);
+  lua_assert(ttisnil(gval(n)));
+  return gval(n);
+}
+
+
 /*
 ** {=============================================================
 ** Rehash
@@ -261,6 +794,15 @@ static int numusearray (const Table *t, int *nums) {
   int ttlg;  /* 2^lg */
   int ause = 0;  /* summation of `nums' */
   int i = 1;  /* count to traverse all array keys */
+  if (ispacked(t)) {  /* keys are 1..sizepacked: count each slice at once */
+    int n = npacked(t);
+    for (lg=0, ttlg=1; i <= n; lg++, ttlg*=2) {
+      int lim = (ttlg < n) ? ttlg : n;
+      nums[lg] += lim - i + 1;
+      i = lim + 1;
+    }
+    return n;
+  }
   for (lg=0, ttlg=1; lg<=MAXBITS; lg++, ttlg*=2) {  /* for each slice */
     int lc = 0;  /* counter */
     int lim = ttlg;
@@ -281,14 +823,38 @@ static int numusearray (const Table *t, int *nums) {
 }
 
 
+/*
+** true when no element of the array part of 't' is nil: its border
+** covers it (see 'noteborder'), or it is a packed array with all its
+** elements, or (the slow way) none of them is nil
+*/
+/* 队列部分是否没有nil元素 */
+static int arrayisfull (const Table *t) {
+  int i = t->sizearray;
+  if (t->border >= i || i == 0)
+    return 1;
+  else if (ispacked(t))
+    return (sizepacked(t) == i);
+  else if (ttisnil(&t->array[i - 1]))  /* quick check for a hole */
+    return 0;
+  while (i--) {
+    if (ttisnil(&t->array[i]))
+      return 0;
+  }
+  return 1;
+}
+
+
+/* 'nums' is NULL when the hash part has no keys for the array part */
 static int numusehash (const Table *t, int *nums, int *pnasize) {
   int totaluse = 0;  /* total number of elements */
   int ause = 0;  /* summation of `nums' */
   int i = sizenode(t);
   while (i--) {
     Node *n = &t->node[i];
-    if (!ttisnil(gval(n))) {
-      ause += countint(gkey(n), nums);
+    if (ctrlisfull(gctrl(t)[i]) && !ttisnil(gval(n))) {
+      if (nums != NULL)
+        ause += countint(gkey(n), nums);
       totaluse++;
     }
   }
@@ -296,6 +862,17 @@ static int numusehash (const Table *t, int *nums, int *pnasize) {
   return totaluse;
 }
 
+
+static int numusefields (const Table *t) {
+  int totaluse = 0;
+  int i;
+  for (i = 0; i < nfields(t); i++) {
+    if (!ttisnil(&t->fields->v[i]))
+      totaluse++;
+  }
+  return totaluse;
+}
+
 /* 设置哈希表队列向量
  * L 虚拟机状态
  * t 哈希表
@@ -303,13 +880,137 @@ static int numusehash (const Table *t, int *nums, int *pnasize) {
  */
 static void setarrayvector (lua_State *L, Table *t, int size) {
   int i;
+  if (ispacked(t)) {  /* new elements are not present */
+    int n = npacked(t);
+    Value *a = packedblock(t);
+    luaM_reallocvector(L, a, packedslots(t->sizearray), packedslots(size),
+                       Value);
+    t->array = (a == NULL) ? NULL : cast(TValue *, a + 1);
+    t->sizearray = size;
+    if (size > 0)
+      sizepacked(t) = (n < size) ? n : size;
+  }
+  else {
 	/* 重新分配size个TValue对象 */
-  luaM_reallocvector(L, t->array, t->sizearray, size, TValue);
-  for (i=t->sizearray; i<size; i++)
-     setnilvalue(&t->array[i]);
-  t->sizearray = size;
+    luaM_reallocvector(L, t->array, t->sizearray, size, TValue);
+    for (i=t->sizearray; i<size; i++)
+       setnilvalue(&t->array[i]);
+    t->sizearray = size;
+  }
+}
+
+
+/*
+** {=============================================================
+** Packed array part
+** ==============================================================
+*/
+
+#if defined(LUA_NANTRICK)
+#define PACKEMPTY	LUA_TNIL  /* arrays are never packed */
+#else
+/* tag of an empty packed array (the first element stored sets it) */
+#define PACKEMPTY	LUA_TNUMFLT
+#endif
+
+
+/*
+** turns the packed array part of 't' into a regular one
+*/
+/* 将紧凑的队列部分转换成普通的队列部分 */
+static void unpackarray (lua_State *L, Table *t) {
+  int i;
+  int n = npacked(t);
+  TValue *a = luaM_newvector(L, t->sizearray, TValue);
+  for (i = 0; i < n; i++)
+    getpacked(t, i, &a[i]);
+  for (; i < t->sizearray; i++)
+    setnilvalue(&a[i]);
+  luaM_freearray(L, packedblock(t), packedslots(t->sizearray));
+  t->array = a;
+  t->packtt = LUA_TNIL;
 }
 
+
+/*
+** packs the regular array part of 't' again, if all its values are
+** numbers with the same subtype followed only by nils
+*/
+/* 如果队列部分的值都是同一子类型的数字(其后只有nil),将它重新变紧凑 */
+static void packarray (lua_State *L, Table *t) {
+#if !defined(LUA_NANTRICK)
+  int n = 0;
+  int i, tt;
+  Value *a;
+  if (t->sizearray == 0 || !ttisnumber(&t->array[0]))
+    return;
+  tt = rttype(&t->array[0]);
+  while (n < t->sizearray && rttype(&t->array[n]) == tt) n++;
+  for (i = n; i < t->sizearray; i++)
+    if (!ttisnil(&t->array[i])) return;  /* holes or other types */
+  a = luaM_newvector(L, packedslots(t->sizearray), Value) + 1;
+  for (i = 0; i < n; i++)
+    a[i] = val_(&t->array[i]);
+  luaM_freearray(L, t->array, t->sizearray);
+  t->array = cast(TValue *, a);
+  t->packtt = cast_byte(tt);
+  sizepacked(t) = n;
+#else
+  UNUSED(L); UNUSED(t);
+#endif
+}
+
+
+/*
+** stores 'v' in element 'i' (counting from 0) of the array part
+*/
+/* 将值v存入队列部分的第i个元素(从0计数) */
+static void setarrayslot (lua_State *L, Table *t, int i, const TValue *v) {
+  if (ispacked(t)) {
+    if (i < sizepacked(t)) {  /* present element? */
+      if (rttype(v) == t->packtt) {
+        setpacked(t, i, v);
+        return;
+      }
+      else if (ttisnil(v) && i == sizepacked(t) - 1) {  /* remove last? */
+        sizepacked(t)--;
+        return;
+      }
+    }
+    else if (ttisnil(v))
+      return;  /* element is already absent */
+    else if (i == sizepacked(t) && ttisnumber(v) &&
+             (i == 0 || rttype(v) == t->packtt)) {  /* append? */
+      t->packtt = cast_byte(rttype(v));
+      setpacked(t, i, v);
+      sizepacked(t)++;
+      return;
+    }
+    unpackarray(L, t);  /* 'v' does not fit: it needs a regular array */
+  }
+  setobj2t(L, &t->array[i], v);
+}
+
+
+/*
+** whether the hash part with 'size' nodes 'nd' (and control bytes 'ct')
+** has keys in the range (from, to] of the array part
+*/
+/* 哈希部分是否有在队列部分(from, to]范围内的健 */
+static int hasarraykeys (const Node *nd, const lu_byte *ct, int size,
+                         int from, int to) {
+  int i;
+  for (i = 0; i < size; i++) {
+    if (ctrlisfull(ct[i]) && !ttisnil(gval(&nd[i]))) {
+      int k = arrayindex(gkey(&nd[i]));
+      if (from < k && k <= to) return 1;
+    }
+  }
+  return 0;
+}
+
+/* }============================================================= */
+
 /* 设置哈希表节点队列
  * L 虚拟机状态指针
  * t 哈希表
@@ -322,27 +1023,36 @@ static void setnodevector (lua_State *L, Table *t, int size) {
     lsize = 0;
   }
   else {
-    int i;
+    int csize;
+    lu_byte *ctrl;
+    NodeHeader *head;
 		/* 计算size以2为底的对数 */
     lsize = luaO_ceillog2(size);
+    if (maxload(twoto(lsize)) < size)  /* too full? */
+      lsize++;
     if (lsize > MAXBITS)
       luaG_runerror(L, "table overflow");
 		/* 还原真实的大小 */
     size = twoto(lsize);
-		/* 分配节点内存 */
-    t->node = luaM_newvector(L, size, Node);
-		/* 遍历所有节点，设置空值 */
-    for (i=0; i<size; i++) {
-      Node *n = gnode(t, i);
-      gnext(n) = NULL;
-      setnilvalue(gkey(n));
-      setnilvalue(gval(n));
-    }
+    csize = sizectrl(size);
+		/* 分配节点内存,头部在其前,控制字节紧随其后 */
+    if (cast(size_t, size) >=
+        (MAX_SIZET - csize - sizeof(NodeHeader)) / sizeof(Node))
+      luaM_toobig(L);
+    head = cast(NodeHeader *, luaM_malloc(L, nodebytes(size)));
+    t->node = cast(Node *, head + 1);
+    ctrl = cast(lu_byte *, t->node + size);
+		/* 节点在得到健时才初始化 */
+    memset(ctrl, CEMPTY, size);
+    memset(ctrl + size, CSENTINEL, csize - size);
+    head->h.old = NULL;
+		/* 所有的节点是空闲的 */
+    head->h.hfree = maxload(size);
+    head->h.lastnext = 0;
+    head->h.ncounted = head->h.nlive = 0;
   }
 	/* 设置节点的数量 */
   t->lsizenode = cast_byte(lsize);
-	/* 所有的节点是空闲的 */
-  t->lastfree = gnode(t, size);  /* all positions are free */
 }
 
 /* 重新设置哈希表大小
@@ -350,49 +1060,124 @@ static void setnodevector (lua_State *L, Table *t, int size) {
  * t 哈希表指针
  * nasize 节点队列个数
  * nhsize 节点向量个数
+ * 有形状的表在nhsize不为0时把字段移入哈希部分(nhsize要包括它们)
  */
 void luaH_resize (lua_State *L, Table *t, int nasize, int nhsize) {
   int i;
-  int oldasize = t->sizearray;     /* 队列长度 */
-  int oldhsize = t->lsizenode;     /* 节点个数 */
-	
+  int oldasize, oldhsize;
+  Node *nold;
+  const lu_byte *cold;
+  Fields *fields = (nhsize > 0) ? t->fields : NULL;  /* fields to move */
+  /* move entries of an old part first (one of the few places where an
+     incremental grow finishes in one step; see 'luaH_finishgrow') */
+  luaH_finishgrow(L, t);
+  oldasize = t->sizearray;     /* 队列长度 */
+  oldhsize = t->lsizenode;     /* 节点个数 */
 	/* 获取节点队列 */
-  Node *nold = t->node;  /* save old hash ... */
+  nold = t->node;  /* save old hash ... */
+  cold = gctrl(t);
 	/* 新设定的队列大小大于原来的,则增长队列 */
-  if (nasize > oldasize)  /* array part must grow? */
+  if (nasize > oldasize) {  /* array part must grow? */
+    /* keys that move from the hash part may not fit in a packed array;
+       unpack it now, as moving them must not raise errors */
+    if (ispacked(t) &&
+        hasarraykeys(nold, cold, twoto(oldhsize), oldasize, nasize))
+      unpackarray(L, t);
     setarrayvector(L, t, nasize);
+  }
   /* create new hash part with appropriate size */
 	/* 设置节点向量 */
   setnodevector(L, t, nhsize);
+  t->intkeys = 0;  /* set again by the keys that go to the new part */
+  if (fields != NULL)  /* table loses its shape? */
+    t->fields = NULL;
 	/* 如果新的队列小于旧的队列 */
   if (nasize < oldasize) {  /* array part must shrink? */
     t->sizearray = nasize;
+    t->intkeys = 1;  /* (its keys must not grow it back in 'luaH_newkey') */
     /* re-insert elements from vanishing slice */
 		/* 将队列中超出的部分设置为空值 */
-    for (i=nasize; i<oldasize; i++) {
+    if (ispacked(t)) {
+      for (i=nasize; i<sizepacked(t); i++) {
+        TValue v;
+        getpacked(t, i, &v);
+        luaH_setint(L, t, i + 1, &v);
+      }
+      t->sizearray = oldasize;
+      setarrayvector(L, t, nasize);  /* shrink array */
+    }
+    else {
+      for (i=nasize; i<oldasize; i++) {
 			/* 如果节点非空对象 */
-      if (!ttisnil(&t->array[i]))
-        luaH_setint(L, t, i + 1, &t->array[i]);
+        if (!ttisnil(&t->array[i]))
+          luaH_setint(L, t, i + 1, &t->array[i]);
+      }
+      /* shrink array */
+      luaM_reallocvector(L, t->array, oldasize, nasize, TValue);
     }
-    /* shrink array */
-    luaM_reallocvector(L, t->array, oldasize, nasize, TValue);
+    if (nasize == 0)  /* no array part? next one may be packed */
+      t->packtt = PACKEMPTY;
   }
   /* re-insert elements from hash part */
   for (i = twoto(oldhsize) - 1; i >= 0; i--) {
     Node *old = nold+i;
-    if (!ttisnil(gval(old))) {
+    if (ctrlisfull(cold[i]) && !ttisnil(gval(old))) {
+      const TValue *key = gkey(old);
+      int k = arrayindex(key);
       /* doesn't need barrier/invalidate cache, as entry was
          already present in the table */
-      setobjt2t(L, luaH_set(L, t, gkey(old)), gval(old));
+      if (0 < k && k <= t->sizearray)  /* goes to the array part? */
+        setarrayslot(L, t, k - 1, gval(old));
+      else {  /* keys are distinct: no need to search the new part */
+        unsigned int h = hashkey(key);
+        Node *n = getfreepos(t, h);
+        lua_assert(n != NULL);
+        setobjt2t(L, setkey(L, t, n, key, h), gval(old));
+      }
     }
   }
   if (!isdummy(nold))
-    luaM_freearray(L, nold, cast(size_t, twoto(oldhsize))); /* free old array */
+    freenodes(L, nold, twoto(oldhsize));  /* free old array */
+  if (fields != NULL) {  /* re-insert fields */
+    Shape *shape = fields->shape;
+    for (i = 0; i < shape->nkeys; i++) {
+      if (!ttisnil(&fields->v[i])) {
+        TValue key;
+        unsigned int h = hashstr(shape->keys[i]);
+        Node *n = getfreepos(t, h);
+        lua_assert(n != NULL);
+        setsvalue(L, &key, shape->keys[i]);
+        setobjt2t(L, setkey(L, t, n, &key, h), &fields->v[i]);
+      }
+    }
+    luaM_freemem(L, fields, sizefields(fields->size));
+  }
+  if (!ispacked(t) && nasize != oldasize)  /* new array may be packed? */
+    packarray(L, t);
+}
+
+
+/*
+** sizes a table built by a constructor with 'nasize' list items and
+** 'nhsize' other fields; a few fields go to a shape (see luaH_resize)
+*/
+/* 设定构造函数创建的表的大小,少量的字段使用形状 */
+void luaH_presize (lua_State *L, Table *t, int nasize, int nhsize) {
+  lua_assert(t->fields == NULL && isdummy(t->node));
+  if (0 < nhsize && nhsize <= MAXSHAPE) {
+    if (nasize > 0)
+      setarrayvector(L, t, nasize);
+    t->fields = cast(Fields *, luaM_malloc(L, sizefields(nhsize)));
+    t->fields->shape = emptyshape;
+    t->fields->size = cast_byte(nhsize);
+  }
+  else if (nasize > 0 || nhsize > 0)
+    luaH_resize(L, t, nasize, nhsize);
 }
 
 
 void luaH_resizearray (lua_State *L, Table *t, int nasize) {
-  int nsize = isdummy(t->node) ? 0 : sizenode(t);
+  int nsize = isdummy(t->node) ? 0 : maxload(sizenode(t));
   luaH_resize(L, t, nasize, nsize);
 }
 
@@ -402,10 +1187,21 @@ void luaH_resizearray (lua_State *L, Table *t, int nasize) {
  * ek
  */
 static void rehash (lua_State *L, Table *t, const TValue *ek) {
-  int nasize, na;
+  int nasize, na, nhsize;
   int nums[MAXBITS+1];  /* nums[i] = number of keys with 2^(i-1) < k <= 2^i */
   int i;
   int totaluse;
+  luaH_finishgrow(L, t);  /* count keys in a single hash part (in O(n)) */
+  if (!t->intkeys && arrayindex(ek) <= 0 &&
+      arrayisfull(t)) {  /* array part cannot change? */
+		/* 只计算哈希部分,队列部分保持其大小 */
+    nasize = 0;
+    nhsize = numusehash(t, NULL, &nasize) + 1;  /* (+1 for the extra key) */
+    if (t->fields != NULL)
+      nhsize += numusefields(t);  /* fields go to the hash part */
+    luaH_resize(L, t, t->sizearray, nhsize);
+    return;
+  }
 	/* 遍历所有健 */
   for (i=0; i<=MAXBITS; i++) nums[i] = 0;  /* reset counts */
 	/* 计算健在队列部分 */
@@ -417,8 +1213,165 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
   totaluse++;
   /* compute new size for array part */
   na = computesizes(nums, &nasize);
+  nhsize = totaluse - na;
+  /* a shaped table keeps its shape while other keys fit in the array */
+  if (nhsize > 0 && t->fields != NULL)
+    nhsize += numusefields(t);  /* else its fields go to the hash part */
   /* resize the table to new computed sizes */
-  luaH_resize(L, t, nasize, totaluse - na);
+  luaH_resize(L, t, nasize, nhsize);
+}
+
+
+/*
+** charges 'd' more bytes of the new part of a growing table to the
+** collector (see 'growhash')
+*/
+/* 将新节点的d字节计入垃圾回收器的债务 */
+static void chargedebt (lua_State *L, OldPart *o, lu_mem d) {
+  global_State *g = G(L);
+  o->debt -= d;
+  luaE_setdebt(g, g->GCdebt + cast(l_mem, d));
+}
+
+
+/*
+** frees the old hash part of 't'
+*/
+/* 释放表t的旧哈希部分 */
+static void freeold (lua_State *L, Table *t) {
+  OldPart *o = gnodehead(t)->old;
+  chargedebt(L, o, o->debt);
+  freenodes(L, o->node, sizeoldnode(t));
+  luaM_free(L, o);
+  gnodehead(t)->old = NULL;
+}
+
+
+struct NewPart {  /* data to 'f_newpart' */
+  Table *t;
+  int size;
+};
+
+
+static void f_newpart (lua_State *L, void *ud) {
+  struct NewPart *np = cast(struct NewPart *, ud);
+  setnodevector(L, np->t, np->size);
+}
+
+
+/*
+** starts to move the hash part of 't' incrementally to a new part with
+** 2^lsize nodes: the current part becomes the old part, and the new one
+** takes the new keys. The collector is charged for the new part as the
+** old entries move, not at once: a debt that large would make its next
+** step run a whole cycle, while that insertion waits.
+*/
+/* 开始渐进地迁移哈希部分: 当前节点成为旧节点,新节点有2^lsize个;
+ * 新节点的内存随着迁移逐步计入垃圾回收器的债务 */
+static void growhash (lua_State *L, Table *t, int lsize) {
+  struct NewPart np;
+  int status;
+  OldPart *o = luaM_new(L, OldPart);
+  lua_assert(!isrehashing(t));
+  o->node = t->node;
+  o->lsizenode = t->lsizenode;
+  o->next = 0;
+  np.t = t;
+  np.size = maxload(twoto(lsize));
+  status = luaD_rawrunprotected(L, f_newpart, &np);
+  if (status != LUA_OK) {  /* table keeps its part (and 'o' is not used) */
+    luaM_free(L, o);
+    luaD_throw(L, status);
+  }
+  gnodehead(t)->old = o;
+  o->debt = nodebytes(sizenode(t));  /* not charged yet */
+  luaE_setdebt(G(L), G(L)->GCdebt - cast(l_mem, o->debt));
+}
+
+
+/*
+** counts the keys in the next 'n' nodes of the hash part of 't' that
+** were not counted yet. Keys that go later to counted nodes are counted
+** by 'setkey'; keys removed after being counted still count, so the
+** count may only be larger than the number of keys in the part.
+*/
+/* 计算哈希部分中后续n个尚未计数的节点中的健 */
+static void countkeys (Table *t, int n) {
+  int i = gnodehead(t)->ncounted;
+  int lim = (n < sizenode(t) - i) ? i + n : sizenode(t);
+  for (; i < lim; i++) {
+    if (ctrlisfull(gctrl(t)[i]) && !ttisnil(gval(gnode(t, i))))
+      gnodehead(t)->nlive++;
+  }
+  gnodehead(t)->ncounted = lim;
+}
+
+
+/*
+** the hash part of 't' (of LUAI_INCRHASH nodes or more) is full: its
+** keys, counted while its last free nodes were used (see 'countkeys'),
+** choose what to do. With many keys (more than 3/4 of its load), it
+** grows to twice its size; with a few, 'rehash' shrinks the table at
+** once; otherwise its removed entries (which do not count) fill it, and
+** its live entries move to a new part of the same size, that has no
+** such entries.
+*/
+/* 大的哈希部分已满: 根据已计数的健,决定加倍,立即缩小或者迁移到同样大小的新节点 */
+static void fullhash (lua_State *L, Table *t, const TValue *ek) {
+  int size = sizenode(t);
+  int totaluse;
+  countkeys(t, size);  /* count the nodes left, if any */
+  totaluse = gnodehead(t)->nlive + 1;  /* (+1 for 'ek') */
+  if (totaluse > maxload(size) / 4 * 3)
+    growhash(L, t, t->lsizenode + 1);
+  else if (totaluse > maxload(size) / 8)
+    growhash(L, t, t->lsizenode);  /* drop removed entries */
+  else
+    rehash(L, t, ek);
+}
+
+
+/*
+** moves the entries of the next 'n' old nodes to the new hash part, and
+** frees the old part when all its nodes were moved. Moved nodes get
+** control byte CMOVED, so searches and the collector ignore them.
+*/
+/* 将后续n个旧节点的健迁移到新节点中,全部迁移完后释放旧节点 */
+static void migrate (lua_State *L, Table *t, int n) {
+  OldPart *o = gnodehead(t)->old;
+  int size = sizeoldnode(t);
+  int left = size - o->next;  /* nodes still to move */
+  lu_byte *ctrl = goldctrl(t);
+  if (n < left)  /* charge the collector for a share of the new part */
+    chargedebt(L, o, o->debt / cast(lu_mem, left) * cast(lu_mem, n));
+  for (; n > 0 && o->next < size; n--) {
+    int i = o->next++;
+    Node *old = goldnode(t, i);
+    if (ctrlisfull(ctrl[i]) && !ttisnil(gval(old))) {
+      const TValue *key = gkey(old);
+      unsigned int h = hashkey(key);
+      Node *mp = getfreepos(t, h);
+      lua_assert(mp != NULL);
+      /* no barrier needed, as entry was already in the table */
+      setobjt2t(L, setkey(L, t, mp, key, h), gval(old));
+    }
+    ctrl[i] = CMOVED;
+  }
+  if (o->next == size)  /* old part is empty? (and all its debt paid) */
+    freeold(L, t);
+}
+
+
+/*
+** moves all entries left in the old hash part of 't', if any. That
+** takes time proportional to the table size, so it is only done when
+** the whole table is rebuilt or copied anyway: by 'luaH_resize' (and so
+** 'rehash') and by 'luaH_copy'.
+*/
+/* 迁移旧节点中剩余的所有健 */
+void luaH_finishgrow (lua_State *L, Table *t) {
+  if (isrehashing(t))
+    migrate(L, t, MAX_INT);
 }
 
 
@@ -435,6 +1388,10 @@ Table *luaH_new (lua_State *L) {
   t->flags = cast_byte(~0);
   t->array = NULL;
   t->sizearray = 0;
+  t->packtt = PACKEMPTY;
+  t->border = 0;
+  t->intkeys = 0;
+  t->fields = NULL;
 	/* 真正的初始化表 */
   setnodevector(L, t, 0);
   return t;
@@ -442,81 +1399,84 @@ Table *luaH_new (lua_State *L) {
 
 
 void luaH_free (lua_State *L, Table *t) {
+  if (isrehashing(t))
+    freeold(L, t);
   if (!isdummy(t->node))
-    luaM_freearray(L, t->node, cast(size_t, sizenode(t)));
-  luaM_freearray(L, t->array, t->sizearray);
+    freenodes(L, t->node, sizenode(t));
+  if (t->fields != NULL)
+    luaM_freemem(L, t->fields, sizefields(t->fields->size));
+  if (ispacked(t))
+    luaM_freearray(L, packedblock(t), packedslots(t->sizearray));
+  else
+    luaM_freearray(L, t->array, t->sizearray);
   luaM_free(L, t);
 }
 
-/* 从一个哈希表中获取空闲位置 */
-static Node *getfreepos (Table *t) {
-	/* 循环遍历直到所有节点遍历完成 */
-  while (t->lastfree > t->node) {
-    t->lastfree--;      /* 递减 */
-		/* 如果为空则直接返回 */
-    if (ttisnil(gkey(t->lastfree)))
-      return t->lastfree;
-  }
-  return NULL;  /* could not find a free place */
-}
-
 
 
 /*
-** inserts a new key into a hash table; first, check whether key's main
-** position is free. If not, check whether colliding node is in its main
-** position or not: if it is not, move colliding node to an empty place and
-** put new key in its main position; otherwise (colliding node is in its main
-** position), new key goes to an empty position.
+** inserts a new key (absent from the table and outside its array part)
+** with value 'value' into a hash table, in the first node of its probe
+** sequence that is free (see 'getfreepos'); grows the table when there
+** is none. While the hash part grows incrementally, each insertion
+** also moves some old entries. Nil values are not inserted. A key right
+** after a full array part doubles that part instead, when the hash part
+** has no key that could go there (a rehash would not do better; with
+** nils in the array part, it may shrink it).
 */
-/* 插入一个新的健到一个哈希表中；首先，检查健的主位置是否为空。如果不为空，检查
- * 冲突节点是否在他的主位置是否为空或者空闲：如果不是空闲，移动冲突的节点到一个空
- * 的位置并且放置一个新的健在它的主位置；或者新健到一个空的位置。
- */
-TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
+/* 插入一个新的健及其值到一个哈希表中,放在其探测序列中第一个空闲的节点;
+ * 如果没有则增长哈希表.渐进增长时每次插入还会迁移一些旧的健.
+ * 紧接着队列部分的健使队列部分的大小加倍 */
+void luaH_newkey (lua_State *L, Table *t, const TValue *key,
+                                         const TValue *value) {
   Node *mp;
+  TValue aux;
+  unsigned int h;
 	/* 如果健的值为空则抛出异常 */
   if (ttisnil(key)) luaG_runerror(L, "table index is nil");
 	/* 健的值是数字并且数字为nan */
-  else if (ttisnumber(key) && luai_numisnan(L, nvalue(key)))
-    luaG_runerror(L, "table index is NaN");
-	/* 通过计算得到一个位置 */
-  mp = mainposition(t, key);
-	
-	/* 主位置被占用或者空值 */
-  if (!ttisnil(gval(mp)) || isdummy(mp)) {  /* main position is taken? */
-    Node *othern;
-		/* 获取一个空闲位置 */
-    Node *n = getfreepos(t);  /* get a free place */
+  else if (ttisfloat(key)) {
+    if (luai_numisnan(L, fltvalue(key)))
+      luaG_runerror(L, "table index is NaN");
+    key = normkey(key, &aux);  /* integral floats are inserted as integers */
+  }
+  if (ttisnil(value))
+    return;  /* do not insert nil values */
+  if (ttisinteger(key) && ivalue(key) == cast(lua_Integer, t->sizearray) + 1
+      && !t->intkeys && t->sizearray <= MAXASIZE / 2 &&
+      arrayisfull(t)) {  /* append? */
+    int n = t->sizearray;
+    setarrayvector(L, t, (n == 0) ? 1 : 2 * n);
+    setarrayslot(L, t, n, value);
+    return;
+  }
+  if (t->fields != NULL && ttisshrstring(key) &&
+      t->fields->shape->nkeys < MAXSHAPE) {
+    setobj2t(L, luaH_addfield(L, t, rawtsvalue(key)), value);  /* new field */
+    return;
+  }
+  if (isrehashing(t))
+    migrate(L, t, MIGRATESTEP);
+  else if (sizenode(t) >= LUAI_INCRHASH &&
+           gnodehead(t)->hfree <= COUNTFROM(sizenode(t)))
+    countkeys(t, COUNTSTEP);  /* part will be full soon: count its keys */
+	/* 计算哈希值并获取一个空闲位置 */
+  h = hashkey(key);
+  mp = getfreepos(t, h);
 		/* 如果找不到一个空闲的位置，则增长哈希表内存 */
-    if (n == NULL) {  /* cannot find a free place? */
+  if (mp == NULL) {  /* cannot find a free place? */
+    if (!isrehashing(t) && sizenode(t) >= LUAI_INCRHASH)
+      fullhash(L, t, key);  /* large hash part: move its entries later */
+    else
 			/* 重新增长哈希表 */
       rehash(L, t, key);  /* grow table */
-      /* whatever called 'newkey' take care of TM cache and GC barrier */
+    /* whatever called 'newkey' take care of TM cache and GC barrier */
 			/* 塞入一个健到表中 */
-      return luaH_set(L, t, key);  /* insert key into grown table */
-    }
-    lua_assert(!isdummy(n));
-    othern = mainposition(t, gkey(mp));
-    if (othern != mp) {  /* is colliding node out of its main position? */
-      /* yes; move colliding node into free position */
-      while (gnext(othern) != mp) othern = gnext(othern);  /* find previous */
-      gnext(othern) = n;  /* redo the chain with `n' in place of `mp' */
-      *n = *mp;  /* copy colliding node into free pos. (mp->next also goes) */
-      gnext(mp) = NULL;  /* now `mp' is free */
-      setnilvalue(gval(mp));
-    }
-    else {  /* colliding node is in its own main position */
-      /* new node will go into free position */
-      gnext(n) = gnext(mp);  /* chain new position */
-      gnext(mp) = n;
-      mp = n;
-    }
-  }
-  setobj2t(L, gkey(mp), key);
+    luaH_set(L, t, key, value);  /* insert key into grown table */
+    return;
+  }
   luaC_barrierback(L, obj2gco(t), key);
-  lua_assert(ttisnil(gval(mp)));
-  return gval(mp);
+  setobj2t(L, setkey(L, t, mp, key, h), value);
 }
 
 
@@ -527,21 +1487,25 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
  * t 哈希表指针
  * key 要获取的整型健,这个值总要比要检测的值+1
  */
-const TValue *luaH_getint (Table *t, int key) {
+const TValue *luaH_getint (Table *t, lua_Integer key, TValue *aux) {
   /* (1 <= key && key <= t->sizearray) */
 	/* 如果整型健值小于队列长度,直接从队列中取得值 */
-  if (cast(unsigned int, key-1) < cast(unsigned int, t->sizearray))
-    return &t->array[key-1];
+  if (cast(lu_integer, key) - 1u < cast(lu_integer, t->sizearray)) {
+    if (!ispacked(t))
+      return &t->array[key-1];
+    else if (key <= sizepacked(t)) {
+      getpacked(t, key - 1, aux);
+    }
+    else
+      setnilvalue(aux);
+    return aux;
+  }
   else {
-		/* 转换健成lua数字类型 */
-    lua_Number nk = cast_num(key);
-		/* 进行哈希算法并返回节点 */
-    Node *n = hashnum(t, nk);
-    do {  /* check whether `key' is somewhere in the chain */
-      if (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk))
-        return gval(n);  /* that's it */
-      else n = gnext(n);
-    } while (n);
+		/* 进行哈希算法并探测节点 */
+    unsigned int h = hashint(key);
+    probe(t, h, n,
+      if (ttisinteger(gkey(n)) && ivalue(gkey(n)) == key)
+        return gval(n);  /* that's it */)
     return luaO_nilobject;
   }
 }
@@ -555,13 +1519,45 @@ const TValue *luaH_getint (Table *t, int key) {
  * key 健
  */
 const TValue *luaH_getstr (Table *t, TString *key) {
-  Node *n = hashstr(t, key);
+  unsigned int h;
   lua_assert(key->tsv.tt == LUA_TSHRSTR);
-  do {  /* check whether `key' is somewhere in the chain */
+  if (t->fields != NULL) {
+    int i = shapefind(t->fields->shape, key);
+    return (i >= 0) ? &t->fields->v[i] : luaO_nilobject;
+  }
+  h = hashstr(key);
+  probe(t, h, n,
     if (ttisshrstring(gkey(n)) && eqshrstr(rawtsvalue(gkey(n)), key))
+      return gval(n);  /* that's it */)
+  return luaO_nilobject;
+}
+
+
+/*
+** same as 'luaH_getstr', but also stores in 'slot' the index of the
+** node holding the key, or its field in a shaped table (used to refill
+** inline caches)
+*/
+/* 同luaH_getstr,并在slot中记录持有该健的节点(或字段)索引 */
+const TValue *luaH_getstrslot (Table *t, TString *key, int *slot) {
+  unsigned int h;
+  lua_assert(key->tsv.tt == LUA_TSHRSTR);
+  if (t->fields != NULL) {
+    int i = shapefind(t->fields->shape, key);
+    if (i < 0) return luaO_nilobject;
+    *slot = i;
+    return &t->fields->v[i];
+  }
+  h = hashstr(key);
+  probepart(t->node, gctrl(t), sizenode(t), h, n,
+    if (ttisshrstring(gkey(n)) && eqshrstr(rawtsvalue(gkey(n)), key)) {
+      *slot = cast_int(n - t->node);
       return gval(n);  /* that's it */
-    else n = gnext(n);
-  } while (n);
+    })
+  if (isrehashing(t))  /* old nodes are not cached (they will move) */
+    probepart(goldnode(t, 0), goldctrl(t), sizeoldnode(t), h, n,
+      if (ttisshrstring(gkey(n)) && eqshrstr(rawtsvalue(gkey(n)), key))
+        return gval(n);)
   return luaO_nilobject;
 }
 
@@ -573,36 +1569,33 @@ const TValue *luaH_getstr (Table *t, TString *key) {
  * t 哈希表指针
  * key 要获取的健
  */
-const TValue *luaH_get (Table *t, const TValue *key) {
+const TValue *luaH_get (Table *t, const TValue *key, TValue *aux) {
 	/* 判断健的类型 */
   switch (ttype(key)) {
 		/* 字符串类型 */
     case LUA_TSHRSTR: return luaH_getstr(t, rawtsvalue(key));
 		/* 空值类型 */
     case LUA_TNIL: return luaO_nilobject;
-		/* 数字类型 */
-    case LUA_TNUMBER: {
-      int k;
-      lua_Number n = nvalue(key);          /* 获取哈希表键的值 */
-      lua_number2int(k, n);                /* 转换lua_number类型到整型 */
-			/* 如果两个值相等 */
-      if (luai_numeq(cast_num(k), n)) /* index is int? */
+		/* 整数类型 */
+    case LUA_TNUMINT: return luaH_getint(t, ivalue(key), aux);
+		/* 浮点数类型 */
+    case LUA_TNUMFLT: {
+      lua_Integer k;
+			/* 整数值的浮点数按照整数健查找 */
+      if (luaV_flttointeger(fltvalue(key), &k, 0)) /* index is int? */
 				/* 从整型key中获取值 */
-        return luaH_getint(t, k);  /* use specialized version */
+        return luaH_getint(t, k, aux);  /* use specialized version */
       /* else go through */
     }
 		/* 默认 */
     default: {
-			/* 找到哈希表的键的节点位置 */
-      Node *n = mainposition(t, key);
-      do {  /* check whether `key' is somewhere in the chain */
+			/* 计算健的哈希值 */
+      unsigned int h = hashkey(key);
+      probe(t, h, n,
 				/* 对比两个对象的键是否相等 */
         if (luaV_rawequalobj(gkey(n), key))
-          return gval(n);  /* that's it */
-        else n = gnext(n);
-      } while (n);
-			
-			/* 找不到返回n */
+          return gval(n);  /* that's it */)
+			/* 找不到返回nil */
       return luaO_nilobject;
     }
   }
@@ -617,53 +1610,88 @@ const TValue *luaH_get (Table *t, const TValue *key) {
  * L 虚拟机状态指针
  * t 哈希表指针
  * key 要设置的健
+ * value 要设置的值
  */
-TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
-	/* 从健中获取值 */
-  const TValue *p = luaH_get(t, key);
-  if (p != luaO_nilobject)
-    return cast(TValue *, p);
-  else return luaH_newkey(L, t, key);
+void luaH_set (lua_State *L, Table *t, const TValue *key,
+                                       const TValue *value) {
+  TValue aux;
+  const TValue *p;
+  key = normkey(key, &aux);
+  if (ttisinteger(key))
+    luaH_setint(L, t, ivalue(key), value);
+  else if ((p = luaH_get(t, key, &aux)) != luaO_nilobject) {
+    setobj2t(L, cast(TValue *, p), value);  /* (not in the array part) */
+  }
+  else
+    luaH_newkey(L, t, key, value);
+}
+
+
+/*
+** keeps the border of a sequence (see 'invalidateborder') across a store
+** t[k] = v: pushes and pops move it, and other stores that may leave
+** holes invalidate it
+*/
+/* 在存储t[k] = v时维护序列的边界:压入和弹出移动它,可能留下空洞的存储使它失效 */
+static void noteborder (Table *t, lua_Integer k, const TValue *v) {
+  if (t->border < 0) return;  /* not a sequence */
+  if (ttisnil(v)) {
+    if (k == t->border && k > 0) t->border--;  /* a pop */
+    else if (k > 0 && k < t->border) invalidateborder(t);
+  }
+  else if (k > t->border) {
+    if (k == cast(lua_Integer, t->border) + 1 && k < MAX_INT)
+      t->border++;  /* a push */
+    else invalidateborder(t);
+  }
 }
 
+
 /* 设置整型健的值
  * L 虚拟机状态
  * t 哈希表
  * key 哈希健
  * value 哈希值的指针指针
  */
-void luaH_setint (lua_State *L, Table *t, int key, TValue *value) {
-  const TValue *p = luaH_getint(t, key);
-  TValue *cell;
-  if (p != luaO_nilobject)
-    cell = cast(TValue *, p);
+void luaH_setint (lua_State *L, Table *t, lua_Integer key,
+                                          const TValue *value) {
+  noteborder(t, key, value);
+  if (cast(lu_integer, key) - 1u < cast(lu_integer, t->sizearray))
+    setarrayslot(L, t, cast_int(key - 1), value);
   else {
-    TValue k;
-    setnvalue(&k, cast_num(key));
-    cell = luaH_newkey(L, t, &k);
+    TValue aux;
+    const TValue *p = luaH_getint(t, key, &aux);
+    if (p != luaO_nilobject) {
+      setobj2t(L, cast(TValue *, p), value);
+    }
+    else {
+      TValue k;
+      setivalue(&k, key);
+      luaH_newkey(L, t, &k, value);
+    }
   }
-  setobj2t(L, cell, value);
 }
 
 
 static int unbound_search (Table *t, unsigned int j) {
   unsigned int i = j;  /* i is zero or a present index */
+  TValue aux;
   j++;
   /* find `i' and `j' such that i is present and j is not */
-  while (!ttisnil(luaH_getint(t, j))) {
+  while (!ttisnil(luaH_getint(t, j, &aux))) {
     i = j;
     j *= 2;
     if (j > cast(unsigned int, MAX_INT)) {  /* overflow? */
       /* table was built with bad purposes: resort to linear search */
       i = 1;
-      while (!ttisnil(luaH_getint(t, i))) i++;
+      while (!ttisnil(luaH_getint(t, i, &aux))) i++;
       return i - 1;
     }
   }
   /* now do a binary search between them */
   while (j - i > 1) {
     unsigned int m = (i+j)/2;
-    if (ttisnil(luaH_getint(t, m))) j = m;
+    if (ttisnil(luaH_getint(t, m, &aux))) j = m;
     else i = m;
   }
   return i;
@@ -673,10 +1701,18 @@ static int unbound_search (Table *t, unsigned int j) {
 /*
 ** Try to find a boundary in table `t'. A `boundary' is an integer index
 ** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
+** While 't' is a sequence its only boundary is kept in 'border' (see
+** 'noteborder'), so its length costs nothing; otherwise (when 't' may
+** have holes) the boundary is searched for as always.
 */
+/* 表是序列时其唯一的边界就是border;否则(可能有空洞)照常查找边界 */
 int luaH_getn (Table *t) {
   unsigned int j = t->sizearray;
-  if (j > 0 && ttisnil(&t->array[j - 1])) {
+  if (t->border >= 0)
+    return t->border;
+  else if (ispacked(t) && cast(unsigned int, npacked(t)) < j)
+    return sizepacked(t);  /* packed values are followed by nils */
+  else if (!ispacked(t) && j > 0 && ttisnil(&t->array[j - 1])) {
     /* there is a boundary in the array part: (binary) search for it */
     unsigned int i = 0;
     while (j - i > 1) {
@@ -693,11 +1729,597 @@ int luaH_getn (Table *t) {
 }
 
 
+/*
+** t[#t+1] = v, for a table without metatable; returns the new index.
+** While a sequence grows by appends, its length is known (see
+** 'luaH_getn') and its array part grows geometrically (see
+** 'luaH_newkey'), so each append takes constant amortized time.
+*/
+/* t[#t+1] = v,用于没有元表的表 */
+int luaH_append (lua_State *L, Table *t, const TValue *v) {
+  int n = luaH_getn(t);
+  luaH_setint(L, t, cast(lua_Integer, n) + 1, v);
+  return n + 1;
+}
+
+
+
+/*
+** {=============================================================
+** Bulk operations
+** ==============================================================
+*/
+
+/*
+** removes all entries of 't', keeping the memory of its parts (and its
+** shape, with no fields) for the entries it will get again; an array
+** part stays packed or not, as the values it had
+*/
+/* 删除表中所有的健,保留各部分的内存(以及形状)供之后的健使用 */
+void luaH_clear (lua_State *L, Table *t) {
+  int i;
+  if (isrehashing(t))  /* old entries are cleared too */
+    freeold(L, t);
+  if (ispacked(t)) {
+    if (t->sizearray > 0)
+      sizepacked(t) = 0;
+  }
+  else {  /* stays a regular array, for values that cannot be packed */
+    for (i = 0; i < t->sizearray; i++)
+      setnilvalue(&t->array[i]);
+  }
+  for (i = 0; i < nfields(t); i++)
+    setnilvalue(&t->fields->v[i]);
+  if (!isdummy(t->node)) {  /* all nodes become empty */
+    memset(gctrl(t), CEMPTY, sizenode(t));
+    gnodehead(t)->hfree = maxload(sizenode(t));
+    gnodehead(t)->ncounted = gnodehead(t)->nlive = 0;
+  }
+  t->intkeys = 0;
+  t->border = 0;
+}
+
+
+/*
+** makes the new (empty) table 't' a shallow copy of 'src', with the same
+** metatable; the parts of 't' are copies of those of 'src'
+*/
+/* 将新的空表t变成src的浅拷贝(包括元表),t的各部分是src的各部分的复制 */
+void luaH_copy (lua_State *L, Table *t, Table *src) {
+  int n = src->sizearray;
+  lua_assert(t->sizearray == 0 && isdummy(t->node) && t->fields == NULL);
+  luaH_finishgrow(L, src);  /* copy a single hash part (in O(n) anyway) */
+  if (n > 0) {  /* copy array part */
+    if (ispacked(src)) {
+      Value *a = luaM_newvector(L, packedslots(n), Value);
+      memcpy(a, packedarray(src) - 1, (sizepacked(src) + 1) * sizeof(Value));
+      t->array = cast(TValue *, a + 1);
+    }
+    else {
+      TValue *a = luaM_newvector(L, n, TValue);
+      memcpy(a, src->array, n * sizeof(TValue));
+      t->array = a;
+    }
+    t->packtt = src->packtt;
+    t->sizearray = n;
+  }
+  if (!isdummy(src->node)) {  /* copy hash part (with its control bytes) */
+    size_t sz = nodebytes(sizenode(src));
+    NodeHeader *head = cast(NodeHeader *, luaM_malloc(L, sz));
+    memcpy(head, cast(NodeHeader *, src->node) - 1, sz);  /* (no old part) */
+    t->node = cast(Node *, head + 1);
+    t->lsizenode = src->lsizenode;
+    t->intkeys = src->intkeys;
+  }
+  if (src->fields != NULL) {  /* copy fields (and shape) */
+    Fields *f = cast(Fields *, luaM_malloc(L, sizefields(src->fields->size)));
+    memcpy(f, src->fields, sizefields(nfields(src)));
+    t->fields = f;
+  }
+  t->metatable = src->metatable;
+  t->flags = src->flags;
+  t->border = src->border;
+}
+
+
+/*
+** t[d], t[d+1], ..., t[d+e-f] = src[f], src[f+1], ..., src[e] (with raw
+** accesses; when 't' is 'src' and the ranges overlap, the result is that
+** of copying in the order that reads each element before overwriting
+** it). Ranges inside the array parts of both tables are moved at once.
+*/
+/* 将src[f..e]复制到t[d..]中;两个范围都在队列部分时一次性移动 */
+void luaH_move (lua_State *L, Table *src, int f, int e, Table *t, int d) {
+  int n = e - f + 1;  /* number of elements */
+  int i;
+  lua_assert(f <= e && n > 0);
+  if (f > 0 && e <= src->sizearray && d > 0 && n <= t->sizearray - d + 1) {
+    /* values of a sequence extending one of 't' keep it a sequence */
+    if (t->border >= 0 && e <= src->border && d <= t->border + 1) {
+      if (t->border < d - 1 + n)
+        t->border = d - 1 + n;
+    }
+    else
+      invalidateborder(t);
+    if (!ispacked(src) && !ispacked(t)) {
+      memmove(&t->array[d - 1], &src->array[f - 1], n * sizeof(TValue));
+      if (isblack(obj2gco(t)))  /* (values may be white) */
+        luaC_barrierback_(L, obj2gco(t));
+      return;
+    }
+    else if (ispacked(src) && ispacked(t) && e <= sizepacked(src) &&
+             d <= sizepacked(t) + 1 &&  /* no holes in 't'? */
+             (src->packtt == t->packtt || sizepacked(t) == 0)) {
+      memmove(&packedarray(t)[d - 1], &packedarray(src)[f - 1],
+              n * sizeof(Value));
+      t->packtt = src->packtt;
+      if (sizepacked(t) < d - 1 + n)
+        sizepacked(t) = d - 1 + n;
+      return;
+    }
+  }
+  for (i = 0; i < n; i++) {  /* move one at a time */
+    int j = (t == src && f < d && d <= e) ? n - 1 - i : i;  /* backwards? */
+    TValue aux, v;
+    setobj(L, &v, luaH_getint(src, f + j, &aux));
+    luaH_setint(L, t, d + j, &v);
+    luaC_barrierback(L, obj2gco(t), &v);
+  }
+}
+
+/* }============================================================= */
+
+
+/*
+** {=============================================================
+** Sorting
+** ==============================================================
+*/
+
+/*
+** kinds of comparison: packed integers or floats and boxed arrays of
+** only numbers or only strings are compared here, without any call;
+** the others compare with '<' (which may call metamethods) or with an
+** order function
+*/
+/* 比较的种类:整数,浮点数,只有数字或字符串,可能调用元方法的'<',比较函数 */
+#define SORTINT		0
+#define SORTFLT		1
+#define SORTRAW		2
+#define SORTLT		3
+#define SORTCALL	4
+
+#define SORTSMALL	12  /* ranges up to this size use insertion sort */
+#define SORTBLOCK	20  /* size of the blocks of the stable sort */
+
+typedef struct Sorter {
+  lua_State *L;
+  Table *t;
+  int n;  /* elements t[1..n] are sorted */
+  int kind;
+  lu_byte inarray;  /* elements are in the array part (else see 'sortswap') */
+  lu_byte tt;  /* 'packtt' of 't' when the sort started */
+  ptrdiff_t comp;  /* stack position of the order function */
+} Sorter;
+
+
+/* 将第i个元素(从0计数)复制到o */
+static void getelem (Sorter *s, int i, StkId o) {
+  Table *t = s->t;
+  if (!s->inarray) {
+    TValue aux;
+    setobj2s(s->L, o, luaH_getint(t, i + 1, &aux));
+  }
+  else if (ispacked(t)) {
+    getpacked(t, i, o);
+  }
+  else
+    setobj2s(s->L, o, &t->array[i]);
+}
+
+
+/*
+** calls the order function (or '<') on elements 'i' and 'j'. Anything
+** may happen to the table meanwhile, but an array part holding the
+** elements being sorted must still hold them, in the same form.
+*/
+/* 调用比较函数(或'<'),之后队列部分必须保持原来的形式 */
+static int sortcall (Sorter *s, int i, int j) {
+  lua_State *L = s->L;
+  Table *t = s->t;
+  StkId top;
+  ptrdiff_t old;
+  int res;
+  luaD_checkstack(L, 3);
+  top = L->top;
+  old = savestack(L, top);  /* (the call may move the stack) */
+  if (s->kind == SORTCALL) {
+    setobj2s(L, top, restorestack(L, s->comp));
+    getelem(s, i, top + 1);
+    getelem(s, j, top + 2);
+    L->top = top + 3;
+    luaD_call(L, top, 1, 0);
+    res = !l_isfalse(restorestack(L, old));
+  }
+  else {
+    getelem(s, i, top);
+    getelem(s, j, top + 1);
+    L->top = top + 2;
+    res = luaV_lessthan(L, top, top + 1);
+  }
+  L->top = restorestack(L, old);
+  if (s->inarray && (t->sizearray < s->n || t->packtt != s->tt ||
+                     (ispacked(t) && sizepacked(t) < s->n)))
+    luaG_runerror(L, "array changed by order function");
+  return res;
+}
+
+
+/* 第i个元素是否小于第j个元素 */
+static int sortless (Sorter *s, int i, int j) {
+  Table *t = s->t;
+  switch (s->kind) {
+    case SORTINT:
+      return packedarray(t)[i].i < packedarray(t)[j].i;
+    case SORTFLT:
+      return luai_numlt(s->L, packedarray(t)[i].n, packedarray(t)[j].n);
+    case SORTRAW:
+      return luaV_lessthan(s->L, &t->array[i], &t->array[j]);
+    default:
+      return sortcall(s, i, j);
+  }
+}
+
+
+/*
+** swaps elements 'i' and 'j'. Elements not all in the array part are
+** swapped with raw accesses, through the stack (the stores may create
+** keys, and so collect garbage), as 'lua_rawseti' would do.
+*/
+/* 交换第i个与第j个元素(在队列部分中时不需要屏障) */
+static void sortswap (Sorter *s, int i, int j) {
+  Table *t = s->t;
+  if (!s->inarray) {
+    lua_State *L = s->L;
+    StkId top;
+    luaD_checkstack(L, 2);
+    top = L->top;
+    getelem(s, i, top);
+    getelem(s, j, top + 1);
+    L->top = top + 2;
+    luaH_setint(L, t, i + 1, top + 1);
+    luaC_barrierback(L, obj2gco(t), top + 1);
+    luaH_setint(L, t, j + 1, top);
+    luaC_barrierback(L, obj2gco(t), top);
+    L->top = top;
+  }
+  else if (ispacked(t)) {
+    Value v = packedarray(t)[i];
+    packedarray(t)[i] = packedarray(t)[j];
+    packedarray(t)[j] = v;
+  }
+  else {
+    TValue v;
+    setobj(s->L, &v, &t->array[i]);
+    setobj(s->L, &t->array[i], &t->array[j]);
+    setobj(s->L, &t->array[j], &v);
+  }
+}
+
+
+/* 插入排序[lo, hi](稳定) */
+static void insertionsort (Sorter *s, int lo, int hi) {
+  int i, j;
+  for (i = lo + 1; i <= hi; i++)
+    for (j = i; j > lo && sortless(s, j, j - 1); j--)
+      sortswap(s, j, j - 1);
+}
+
+
+/* 堆排序[lo, hi] */
+static void heapsort (Sorter *s, int lo, int hi) {
+  int n = hi - lo + 1;
+  int i;
+  for (i = n / 2 - 1; i >= 0; i--) {  /* build heap */
+    int r = i;
+    for (;;) {  /* sift down */
+      int c = 2 * r + 1;
+      if (c >= n) break;
+      if (c + 1 < n && sortless(s, lo + c, lo + c + 1)) c++;
+      if (!sortless(s, lo + r, lo + c)) break;
+      sortswap(s, lo + r, lo + c);
+      r = c;
+    }
+  }
+  for (n--; n > 0; n--) {  /* move maximum to the end */
+    int r = 0;
+    sortswap(s, lo, lo + n);
+    for (;;) {
+      int c = 2 * r + 1;
+      if (c >= n) break;
+      if (c + 1 < n && sortless(s, lo + c, lo + c + 1)) c++;
+      if (!sortless(s, lo + r, lo + c)) break;
+      sortswap(s, lo + r, lo + c);
+      r = c;
+    }
+  }
+}
+
+
+/*
+** introsort of [lo, hi]: quicksort with the median of three as pivot,
+** turning into heapsort when 'depth' partitions did not get the range
+** small enough. An invalid order function cannot make the partition
+** leave the range: it raises an error instead.
+*/
+/* 内省排序[lo, hi]:快速排序,划分次数超过depth时改用堆排序 */
+static void introsort (Sorter *s, int lo, int hi, int depth) {
+  while (hi - lo >= SORTSMALL) {
+    int m = lo + (hi - lo) / 2;
+    int i, j;
+    if (depth-- == 0) {
+      heapsort(s, lo, hi);
+      return;
+    }
+    /* order t[lo] <= t[m] <= t[hi], then use t[m] as pivot in t[lo] */
+    if (sortless(s, m, lo)) sortswap(s, m, lo);
+    if (sortless(s, hi, m)) {
+      sortswap(s, hi, m);
+      if (sortless(s, m, lo)) sortswap(s, m, lo);
+    }
+    sortswap(s, lo, m);
+    i = lo; j = hi + 1;
+    for (;;) {  /* invariant: t[lo+1..i] <= P <= t[j..hi] */
+      while (sortless(s, ++i, lo))
+        if (i >= hi) luaG_runerror(s->L, "invalid order function for sorting");
+      while (sortless(s, lo, --j))
+        if (j <= lo) luaG_runerror(s->L, "invalid order function for sorting");
+      if (j <= i) break;
+      sortswap(s, i, j);
+    }
+    sortswap(s, lo, j);  /* t[lo..j-1] <= t[j] == P <= t[j+1..hi] */
+    if (j - lo < hi - j) {  /* recurse into the smaller part */
+      introsort(s, lo, j - 1, depth);
+      lo = j + 1;
+    }
+    else {
+      introsort(s, j + 1, hi, depth);
+      hi = j - 1;
+    }
+  }
+  insertionsort(s, lo, hi);
+}
+
+
+/*
+** the same introsort for packed arrays with the default order, which
+** compares and swaps their values directly (no call can change them)
+*/
+/* 紧凑队列部分使用默认顺序时的内省排序,直接比较与交换值 */
+#define packedlt(isint,a,x,y) \
+	((isint) ? (a)[x].i < (a)[y].i : luai_numlt(L, (a)[x].n, (a)[y].n))
+#define packedswap(a,x,y) \
+	{ Value v_ = (a)[x]; (a)[x] = (a)[y]; (a)[y] = v_; }
+
+static void packedsort (Sorter *s, int lo, int hi, int depth) {
+  lua_State *L = s->L;
+  Value *a = packedarray(s->t);
+  int isint = (s->kind == SORTINT);
+  int m;
+  while (hi - lo >= SORTSMALL) {
+    int i, j;
+    m = lo + (hi - lo) / 2;
+    if (depth-- == 0) {
+      heapsort(s, lo, hi);
+      return;
+    }
+    if (packedlt(isint, a, m, lo)) packedswap(a, m, lo);
+    if (packedlt(isint, a, hi, m)) {
+      packedswap(a, hi, m);
+      if (packedlt(isint, a, m, lo)) packedswap(a, m, lo);
+    }
+    packedswap(a, lo, m);
+    i = lo; j = hi + 1;
+    for (;;) {
+      while (packedlt(isint, a, ++i, lo))
+        if (i >= hi) luaG_runerror(L, "invalid order function for sorting");
+      while (packedlt(isint, a, lo, --j))
+        if (j <= lo) luaG_runerror(L, "invalid order function for sorting");
+      if (j <= i) break;
+      packedswap(a, i, j);
+    }
+    packedswap(a, lo, j);
+    if (j - lo < hi - j) {
+      packedsort(s, lo, j - 1, depth);
+      lo = j + 1;
+    }
+    else {
+      packedsort(s, j + 1, hi, depth);
+      hi = j - 1;
+    }
+  }
+  for (m = lo + 1; m <= hi; m++) {  /* insertion sort */
+    int j;
+    for (j = m; j > lo && packedlt(isint, a, j, j - 1); j--)
+      packedswap(a, j, j - 1);
+  }
+}
+
+
+/* 交换[a, a+n)与[b, b+n) */
+static void swaprange (Sorter *s, int a, int b, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    sortswap(s, a + i, b + i);
+}
+
+
+/* 将[a, m)与[m, b)两部分互换位置 */
+static void rotate (Sorter *s, int a, int m, int b) {
+  int i = m - a;
+  int j = b - m;
+  while (i != j) {
+    if (i > j) {
+      swaprange(s, m - i, m, j);
+      i -= j;
+    }
+    else {
+      swaprange(s, m - i, m + j - i, i);
+      j -= i;
+    }
+  }
+  swaprange(s, m - i, m, i);
+}
+
+
+/*
+** merges the sorted ranges [a, m) and [m, b) in place, keeping the
+** order of equal elements (the SymMerge algorithm of Pok-Son Kim and
+** Arne Kutzner, "Stable Minimum Storage Merging by Symmetric
+** Comparisons")
+*/
+/* 原地合并两个有序范围[a, m)与[m, b),保持相等元素的次序 */
+static void symmerge (Sorter *s, int a, int m, int b) {
+  int mid, n, start, r, end;
+  if (m - a == 1) {  /* insert t[a] into [m, b) */
+    int i = m;
+    int j = b;
+    while (i < j) {
+      int h = i + (j - i) / 2;
+      if (sortless(s, h, a)) i = h + 1;
+      else j = h;
+    }
+    for (j = a; j < i - 1; j++)
+      sortswap(s, j, j + 1);
+    return;
+  }
+  if (b - m == 1) {  /* insert t[m] into [a, m) */
+    int i = a;
+    int j = m;
+    while (i < j) {
+      int h = i + (j - i) / 2;
+      if (!sortless(s, m, h)) i = h + 1;
+      else j = h;
+    }
+    for (j = m; j > i; j--)
+      sortswap(s, j, j - 1);
+    return;
+  }
+  mid = a + (b - a) / 2;
+  n = mid + m;
+  if (m > mid) {
+    start = n - b;
+    r = mid;
+  }
+  else {
+    start = a;
+    r = m;
+  }
+  while (start < r) {
+    int c = start + (r - start) / 2;
+    if (!sortless(s, n - 1 - c, c)) start = c + 1;
+    else r = c;
+  }
+  end = n - start;
+  if (start < m && m < end)
+    rotate(s, start, m, end);
+  if (a < start && start < mid)
+    symmerge(s, a, start, mid);
+  if (mid < end && end < b)
+    symmerge(s, mid, end, b);
+}
+
+
+/* 稳定排序[0, n):对小块进行插入排序,然后两两合并 */
+static void stablesort (Sorter *s, int n) {
+  int bs = SORTBLOCK;
+  int a;
+  for (a = 0; n - a > bs; a += bs)
+    insertionsort(s, a, a + bs - 1);
+  insertionsort(s, a, n - 1);
+  for (; bs < n; bs *= 2) {
+    for (a = 0; n - a > 2 * bs; a += 2 * bs)
+      symmerge(s, a, a + bs, a + 2 * bs);
+    if (a + bs < n)
+      symmerge(s, a, a + bs, n);
+  }
+}
+
+
+/* 选择比较的种类 */
+static int sortkind (Table *t, int n, int hascomp, int inarray) {
+  int i;
+  if (hascomp)
+    return SORTCALL;
+  if (!inarray)
+    return SORTLT;
+  if (ispacked(t))
+    return (t->packtt == LUA_TNUMINT) ? SORTINT : SORTFLT;
+  if (ttisnumber(&t->array[0])) {
+    for (i = 1; i < n; i++)
+      if (!ttisnumber(&t->array[i])) return SORTLT;
+  }
+  else if (ttisstring(&t->array[0])) {
+    for (i = 1; i < n; i++)
+      if (!ttisstring(&t->array[i])) return SORTLT;
+  }
+  else
+    return SORTLT;
+  return SORTRAW;
+}
+
+
+/*
+** sorts t[1..n] in place, with raw accesses, in the order given by the
+** function at stack position 'comp' (or by '<' when 'comp' is -1). When
+** the elements fit in the array part, or are all present (so 'n' is
+** the real length, not one given by a '__len' metamethod), they are
+** first moved into the array part, where they are sorted without
+** allocating anything; otherwise they are read and written one by one.
+** A 'stable' sort keeps the order of the elements that are equal in
+** that order.
+*/
+/* 原地排序t[1..n]:元素在(或可以移入)队列部分时不分配内存地排序,
+ * 否则逐个读写元素 */
+void luaH_sort (lua_State *L, Table *t, int n, ptrdiff_t comp, int stable) {
+  Sorter s;
+  if (n < 2) return;
+  s.inarray = (n <= t->sizearray || n <= t->border);
+  if (s.inarray) {
+    if (n > t->border)  /* (nils among the elements may move) */
+      invalidateborder(t);
+    if (t->sizearray < n)
+      luaH_resizearray(L, t, n);
+    if (ispacked(t) && sizepacked(t) < n)  /* nils among the elements? */
+      unpackarray(L, t);
+  }
+  s.L = L;
+  s.t = t;
+  s.n = n;
+  s.kind = sortkind(t, n, comp >= 0, s.inarray);
+  s.tt = t->packtt;
+  s.comp = comp;
+  if (stable && s.kind != SORTINT)  /* (equal integers are identical) */
+    stablesort(&s, n);
+  else {
+    int depth = 0;
+    int i;
+    for (i = n; i > 1; i >>= 1) depth += 2;  /* about 2*log2(n) */
+    if (s.kind <= SORTFLT)
+      packedsort(&s, 0, n - 1, depth);
+    else
+      introsort(&s, 0, n - 1, depth);
+  }
+}
+
+/* }============================================================= */
+
+
 
 #if defined(LUA_DEBUG)
 
 Node *luaH_mainposition (const Table *t, const TValue *key) {
-  return mainposition(t, key);
+  return gnode(t, lmod(hashkey(key), sizenode(t)));
 }
 
 int luaH_isdummy (Node *n) { return isdummy(n); }
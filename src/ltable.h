@@ -17,43 +17,215 @@
 #define gkey(n)		(&(n)->i_key.tvk)
 /* 获取节点n的值 */
 #define gval(n)		(&(n)->i_val)
-/* 获取下一个节点 */
-#define gnext(n)	((n)->i_key.nk.next)
+/* 节点的控制字节,与节点在同一块内存中,紧随其后 */
+#define gctrl(t)	cast(lu_byte *, (t)->node + sizenode(t))
+/* 哈希部分的头部,在节点之前 */
+#define gnodehead(t)	(&(cast(NodeHeader *, (t)->node) - 1)->h)
+/* 旧节点数组中的第i个节点 */
+#define goldnode(t,i)	(&gnodehead(t)->old->node[i])
+/* 哈希部分是否正在渐进增长(新旧节点数组共存) */
+#define isrehashing(t)	(gnodehead(t)->old != NULL)
+/* 计算旧节点的真正长度 */
+#define sizeoldnode(t)	(twoto(gnodehead(t)->old->lsizenode))
+/* 旧节点的控制字节 */
+#define goldctrl(t)	cast(lu_byte *, gnodehead(t)->old->node + sizeoldnode(t))
+
+/*
+** a node holds a key when the high bit of its control byte is clear;
+** other nodes may hold garbage (see ltable.c)
+*/
+/* 控制字节为c的节点是否持有健,其他节点的内容是未定义的 */
+#define ctrlisfull(c)	(!((c) & 0x80))
+/* 有形状的表的字段数量 */
+#define nfields(t)	((t)->fields == NULL ? 0 : (t)->fields->shape->nkeys)
+/* 有n个值的字段的内存大小 */
+#define sizefields(n) \
+	(offsetof(Fields, v) + cast(size_t, n) * sizeof(TValue))
+/* 有n个健,健索引大小为2^lsi的形状的内存大小 */
+#define sizeshape(n,lsi) \
+	(offsetof(Shape, keys) + cast(size_t, n) * sizeof(TString *) + \
+	 twoto(lsi))
+
+/* 形状的最大健数量 */
+#define MAXSHAPE	32  /* maximum number of keys in a shape */
+
+/*
+** a packed array part keeps only the 'Value' of its elements, which all
+** have tag 'packtt'; its first 'sizepacked' elements are present, the
+** others are nil (see ltable.c). That count is kept right before the
+** elements, so it exists only when the part is not empty. With
+** LUA_NANTRICK values are already that compact, so arrays are never
+** packed.
+*/
+/* 紧凑的队列部分只保存值(不带类型),前sizepacked个值存在,其余为nil */
+#define packedarray(t)	cast(Value *, (t)->array)
+/* 紧凑的队列部分中存在的值的数量,保存在第一个值之前(队列部分不为空时) */
+#define sizepacked(t)	(*cast(int *, packedarray(t) - 1))
+
+#if defined(LUA_NANTRICK)
+#define ispacked(t)	0
+#define getpacked(t,i,o)	lua_assert(0)
+#define setpacked(t,i,o)	lua_assert(0)
+#else
+#define ispacked(t)	((t)->packtt != LUA_TNIL)
+#define getpacked(t,i,o) \
+	{ const Table *t_=(t); TValue *io_=(o); \
+	  val_(io_) = packedarray(t_)[i]; settt_(io_, t_->packtt); }
+#define setpacked(t,i,o)	(packedarray(t)[i] = val_(o))
+#endif
+
+
+/*
+** fast paths for the array part: 'luaH_fastgeti' copies t[k] into 'res'
+** and 'luaH_fastseti' stores 'v' into t[k] when k is a present element
+** of the array part (and 'v' fits in it, and is not nil: see
+** 'invalidateborder'); both set 'hit' when they do. The caller of
+** 'luaH_fastseti' must check the GC barrier and invalidate the TM cache.
+*/
+/* 队列部分的快速访问: k为队列中存在的元素时复制或设置它的值,并设置hit */
+#define luaH_fastgeti(L,t,k,res,hit) { \
+  Table *h_ = (t);  /* ('res' may be where 't' came from) */ \
+  lu_integer i_ = cast(lu_integer, k) - 1u; \
+  hit = 0; \
+  if (i_ < cast(lu_integer, h_->sizearray)) { \
+    if (!ispacked(h_)) { \
+      const TValue *o_ = &h_->array[i_]; \
+      if (!ttisnil(o_)) { setobj2s(L, res, o_); hit = 1; } \
+    } \
+    else if (i_ < cast(lu_integer, sizepacked(h_))) { \
+      getpacked(h_, i_, res); hit = 1; \
+    } } }
+
+#define luaH_fastseti(L,t,k,v,hit) { \
+  Table *h_ = (t); \
+  lu_integer i_ = cast(lu_integer, k) - 1u; \
+  hit = 0; \
+  if (i_ < cast(lu_integer, h_->sizearray)) { \
+    if (!ispacked(h_)) { \
+      TValue *o_ = &h_->array[i_]; \
+      if (!ttisnil(o_) && !ttisnil(v)) { setobj2t(L, o_, v); hit = 1; } \
+    } \
+    else if (i_ < cast(lu_integer, sizepacked(h_)) && \
+             rttype(v) == h_->packtt) { \
+      setpacked(h_, i_, v); hit = 1; \
+    } } }
+
 /* 清空元操作 */
 #define invalidateTMcache(t)	((t)->flags = 0)
 
+/*
+** 'border' (when not negative) is the length of a table that is a
+** sequence: its positive integer keys are exactly 1..border. Stores of
+** integer keys through 'luaH_setint' keep it (see 'noteborder'); other
+** stores into the array part or of integer keys must either keep 't' a
+** sequence or invalidate its border, and then 'luaH_getn' searches for
+** a border as always.
+*/
+/* border非负时是序列的长度;经过luaH_setint的存储会维护它,可能留下空洞的存储
+ * 使它失效 */
+#define invalidateborder(t)	((t)->border = -1)
+
+/*
+** inline caches: 'c' remembers the node where a short-string key was
+** last found (or its field, for shaped tables). The cache is valid as
+** long as that node still holds the key, or the table's shape has the
+** key at that position, whatever happened to the table in between.
+*/
+/* 内联缓存: c记录了短字符串健上次所在的节点(或字段),只要该节点仍持有此健
+ * (或表的形状在该位置上有此健)即有效 */
+#define luaH_slothit(t,c,key) \
+  (cast(unsigned int, c) < cast(unsigned int, sizenode(t)) && \
+   ctrlisfull(gctrl(t)[c]) && ttisshrstring(gkey(gnode(t, c))) && \
+   rawtsvalue(gkey(gnode(t, c))) == (key))
+
+#define luaH_fieldhit(t,c,key) \
+  (cast(unsigned int, c) < (t)->fields->shape->nkeys && \
+   (t)->fields->shape->keys[c] == (key))
+
+#define luaH_getstrcached(t,key,c) \
+  ((t)->fields != NULL \
+    ? (luaH_fieldhit(t, *(c), key) ? &(t)->fields->v[*(c)] \
+                                   : luaH_getstrslot(t, key, c)) \
+    : (luaH_slothit(t, *(c), key) ? gval(gnode(t, *(c))) \
+                                  : luaH_getstrslot(t, key, c)))
+
+/*
+** whether a store can go right to 'slot', the result of a search in
+** 't': its key is present, and either it has a value or 't' has no
+** '__newindex' to call instead
+*/
+/* 是否可以直接存入slot:键存在,并且有值或者表没有元表 */
+#define luaH_storable(t,slot) \
+  (!ttisnil(slot) || ((slot) != luaO_nilobject && (t)->metatable == NULL))
+
 /* returns the key, given the value of a table entry */
 #define keyfromval(v) \
   (gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
 
-/* 获取整型key的值 */
-LUAI_FUNC const TValue *luaH_getint (Table *t, int key);
+/*
+** 'luaH_getint' and 'luaH_get' return a pointer to the value of a key;
+** values in a packed array part are copied into 'aux' (then 'aux' is
+** returned, even for absent elements), so the result must not be used
+** to change the table
+*/
+/* 获取整型key的值,紧凑的队列部分中的值复制到aux中 */
+LUAI_FUNC const TValue *luaH_getint (Table *t, lua_Integer key, TValue *aux);
 /* 设置整型key的值 */
-LUAI_FUNC void luaH_setint (lua_State *L, Table *t, int key, TValue *value);
+LUAI_FUNC void luaH_setint (lua_State *L, Table *t, lua_Integer key,
+                                                    const TValue *value);
 /* 获取字符串型key的值 */
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
+/* 获取字符串型key的值,并记录其所在的节点 */
+LUAI_FUNC const TValue *luaH_getstrslot (Table *t, TString *key, int *slot);
 /* 获取任意值类型key的值 */
-LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
+LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key, TValue *aux);
 /* 创建一个新的key 
  * L 虚拟机状态指针
  * t 哈希表指针
- * key 新健健的值
+ * key 新健健的值(不在表中,也不在队列部分中)
+ * value 新健的值
  */
-LUAI_FUNC TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key);
+LUAI_FUNC void luaH_newkey (lua_State *L, Table *t, const TValue *key,
+                                                    const TValue *value);
 /* 对一个key进行值设置 */
-LUAI_FUNC TValue *luaH_set (lua_State *L, Table *t, const TValue *key);
+LUAI_FUNC void luaH_set (lua_State *L, Table *t, const TValue *key,
+                                                 const TValue *value);
 /* 创建一个新的哈希表 */
 LUAI_FUNC Table *luaH_new (lua_State *L);
 /* 重新设定表的长度 */
 LUAI_FUNC void luaH_resize (lua_State *L, Table *t, int nasize, int nhsize);
 /* 重新设定表队列的长度 */
 LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, int nasize);
+/* 设定构造函数创建的表的大小 */
+LUAI_FUNC void luaH_presize (lua_State *L, Table *t, int nasize, int nhsize);
+/* 向有形状的表增加一个字段 */
+LUAI_FUNC TValue *luaH_addfield (lua_State *L, Table *t, TString *key);
+/* 迁移旧节点中剩余的健(见ltable.c) */
+LUAI_FUNC void luaH_finishgrow (lua_State *L, Table *t);
 /* 释放表空间 */
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
+/* 重新设置形状转换表的大小 */
+LUAI_FUNC void luaH_resizeshapes (lua_State *L, int newsize);
+/* 释放形状 */
+LUAI_FUNC void luaH_freeshape (lua_State *L, Shape *s);
 /* 获取下一个表中的健 */
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
+/* 获取位置pos之后的健,返回它的位置 */
+LUAI_FUNC int luaH_nextpos (lua_State *L, Table *t, int pos, StkId key);
 /*  */
 LUAI_FUNC int luaH_getn (Table *t);
+/* t[#t+1] = v,返回新的索引 */
+LUAI_FUNC int luaH_append (lua_State *L, Table *t, const TValue *v);
+/* 删除表中所有的健,保留其内存 */
+LUAI_FUNC void luaH_clear (lua_State *L, Table *t);
+/* 将新表变成另一个表的浅拷贝 */
+LUAI_FUNC void luaH_copy (lua_State *L, Table *t, Table *src);
+/* 复制一个范围的整数健的值 */
+LUAI_FUNC void luaH_move (lua_State *L, Table *src, int f, int e,
+                                        Table *t, int d);
+/* 原地排序t[1..n] */
+LUAI_FUNC void luaH_sort (lua_State *L, Table *t, int n, ptrdiff_t comp,
+                                        int stable);
 
 
 #if defined(LUA_DEBUG)
@@ -5,6 +5,7 @@
 */
 
 
+#include <limits.h>
 #include <stddef.h>
 
 #define ltablib_c
@@ -46,12 +47,13 @@ static int tinsert (lua_State *L) {
       break;
     }
     case 3: {
-      int i;
       pos = luaL_checkint(L, 2);  /* 2nd argument is the position */
       luaL_argcheck(L, 1 <= pos && pos <= e, 2, "position out of bounds");
-      for (i = e; i > pos; i--) {  /* move up elements */
-        lua_rawgeti(L, 1, i-1);
-        lua_rawseti(L, 1, i);  /* t[i] = t[i-1] */
+      if (pos < e) {  /* move up elements */
+        lua_rawgeti(L, 1, e-1);
+        lua_rawseti(L, 1, e);  /* t[e] = t[e-1] (grows the table first) */
+        if (pos < e-1)  /* t[pos+1..e-1] = t[pos..e-2] */
+          lua_rawmove(L, 1, pos, e-2, pos+1, 1);
       }
       break;
     }
@@ -70,9 +72,9 @@ static int tremove (lua_State *L) {
   if (pos != size)  /* validate 'pos' if given */
     luaL_argcheck(L, 1 <= pos && pos <= size + 1, 1, "position out of bounds");
   lua_rawgeti(L, 1, pos);  /* result = t[pos] */
-  for ( ; pos < size; pos++) {
-    lua_rawgeti(L, 1, pos+1);
-    lua_rawseti(L, 1, pos);  /* t[pos] = t[pos+1] */
+  if (pos < size) {  /* t[pos..size-1] = t[pos+1..size] */
+    lua_rawmove(L, 1, pos+1, size, pos, 1);
+    pos = size;
   }
   lua_pushnil(L);
   lua_rawseti(L, 1, pos);  /* t[pos] = nil */
@@ -80,31 +82,81 @@ static int tremove (lua_State *L) {
 }
 
 
-static void addfield (lua_State *L, luaL_Buffer *b, int i) {
-  lua_rawgeti(L, 1, i);
-  if (!lua_isstring(L, -1))
-    luaL_error(L, "invalid value (%s) at index %d in table for "
-                  LUA_QL("concat"), luaL_typename(L, -1), i);
-  luaL_addvalue(b);
+/*
+** {======================================================
+** Whole tables
+** =======================================================
+*/
+
+/*
+** checks that integer 'n', argument 'arg', fits in an 'int' (which
+** 'luaL_checkint' would silently truncate it to)
+*/
+static int intarg (lua_State *L, int arg, lua_Integer n) {
+  luaL_argcheck(L, INT_MIN <= n && n <= INT_MAX, arg, "value out of range");
+  return (int)n;
+}
+
+
+static int tnew (lua_State *L) {
+  int narr = intarg(L, 1, luaL_optinteger(L, 1, 0));
+  int nrec = intarg(L, 2, luaL_optinteger(L, 2, 0));
+  luaL_argcheck(L, narr >= 0, 1, "size must be non-negative");
+  luaL_argcheck(L, nrec >= 0, 2, "size must be non-negative");
+  lua_createtable(L, narr, nrec);
+  return 1;
+}
+
+
+static int tclear (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_cleartable(L, 1);
+  return 0;
+}
+
+
+static int tclone (lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_clonetable(L, 1);
+  return 1;
+}
+
+
+static int tmove (lua_State *L) {
+  int f = intarg(L, 2, luaL_checkinteger(L, 2));
+  int e = intarg(L, 3, luaL_checkinteger(L, 3));
+  int t = intarg(L, 4, luaL_checkinteger(L, 4));
+  int tt = !lua_isnoneornil(L, 5) ? 5 : 1;  /* destination table */
+  luaL_checktype(L, 1, LUA_TTABLE);
+  luaL_checktype(L, tt, LUA_TTABLE);
+  if (e >= f) {  /* otherwise, nothing to move */
+    luaL_argcheck(L, f > 0 || e < INT_MAX + f, 3,
+                  "too many elements to move");
+    luaL_argcheck(L, t <= INT_MAX - (e - f), 4, "destination wrap around");
+    lua_rawmove(L, 1, f, e, t, tt);
+  }
+  lua_pushvalue(L, tt);  /* return destination table */
+  return 1;
 }
 
+/* }====================================================== */
+
 
 static int tconcat (lua_State *L) {
-  luaL_Buffer b;
-  size_t lsep;
-  int i, last;
-  const char *sep = luaL_optlstring(L, 2, "", &lsep);
+  int i, last, bad;
+  luaL_optstring(L, 2, "");
   luaL_checktype(L, 1, LUA_TTABLE);
   i = luaL_optint(L, 3, 1);
   last = luaL_opt(L, luaL_checkint, 4, luaL_len(L, 1));
-  luaL_buffinit(L, &b);
-  for (; i < last; i++) {
-    addfield(L, &b, i);
-    luaL_addlstring(&b, sep, lsep);
+  if (lua_isnoneornil(L, 2))
+    lua_pushliteral(L, "");
+  else
+    lua_pushvalue(L, 2);  /* separator (a string by now) */
+  if (!lua_rawconcat(L, 1, i, last, &bad)) {
+    lua_rawgeti(L, 1, bad);
+    return luaL_error(L, "invalid value (%s) at index %d in table for "
+                         LUA_QL("concat"), luaL_typename(L, -1), bad);
   }
-  if (i == last)  /* add last value (if interval was not empty) */
-    addfield(L, &b, i);
-  luaL_pushresult(&b);
   return 1;
 }
 
@@ -153,103 +205,21 @@ static int unpack (lua_State *L) {
 
 /*
 ** {======================================================
-** Quicksort
-** (based on `Algorithms in MODULA-3', Robert Sedgewick;
-**  Addison-Wesley, 1993.)
+** Sort
+** (introsort, or an in-place merge sort when it must be stable,
+**  done by the core on the array part of the table)
 ** =======================================================
 */
 
 
-static void set2 (lua_State *L, int i, int j) {
-  lua_rawseti(L, 1, i);
-  lua_rawseti(L, 1, j);
-}
-
-static int sort_comp (lua_State *L, int a, int b) {
-  if (!lua_isnil(L, 2)) {  /* function? */
-    int res;
-    lua_pushvalue(L, 2);
-    lua_pushvalue(L, a-1);  /* -1 to compensate function */
-    lua_pushvalue(L, b-2);  /* -2 to compensate function and `a' */
-    lua_call(L, 2, 1);
-    res = lua_toboolean(L, -1);
-    lua_pop(L, 1);
-    return res;
-  }
-  else  /* a < b? */
-    return lua_compare(L, a, b, LUA_OPLT);
-}
-
-static void auxsort (lua_State *L, int l, int u) {
-  while (l < u) {  /* for tail recursion */
-    int i, j;
-    /* sort elements a[l], a[(l+u)/2] and a[u] */
-    lua_rawgeti(L, 1, l);
-    lua_rawgeti(L, 1, u);
-    if (sort_comp(L, -1, -2))  /* a[u] < a[l]? */
-      set2(L, l, u);  /* swap a[l] - a[u] */
-    else
-      lua_pop(L, 2);
-    if (u-l == 1) break;  /* only 2 elements */
-    i = (l+u)/2;
-    lua_rawgeti(L, 1, i);
-    lua_rawgeti(L, 1, l);
-    if (sort_comp(L, -2, -1))  /* a[i]<a[l]? */
-      set2(L, i, l);
-    else {
-      lua_pop(L, 1);  /* remove a[l] */
-      lua_rawgeti(L, 1, u);
-      if (sort_comp(L, -1, -2))  /* a[u]<a[i]? */
-        set2(L, i, u);
-      else
-        lua_pop(L, 2);
-    }
-    if (u-l == 2) break;  /* only 3 elements */
-    lua_rawgeti(L, 1, i);  /* Pivot */
-    lua_pushvalue(L, -1);
-    lua_rawgeti(L, 1, u-1);
-    set2(L, i, u-1);
-    /* a[l] <= P == a[u-1] <= a[u], only need to sort from l+1 to u-2 */
-    i = l; j = u-1;
-    for (;;) {  /* invariant: a[l..i] <= P <= a[j..u] */
-      /* repeat ++i until a[i] >= P */
-      while (lua_rawgeti(L, 1, ++i), sort_comp(L, -1, -2)) {
-        if (i>=u) luaL_error(L, "invalid order function for sorting");
-        lua_pop(L, 1);  /* remove a[i] */
-      }
-      /* repeat --j until a[j] <= P */
-      while (lua_rawgeti(L, 1, --j), sort_comp(L, -3, -1)) {
-        if (j<=l) luaL_error(L, "invalid order function for sorting");
-        lua_pop(L, 1);  /* remove a[j] */
-      }
-      if (j<i) {
-        lua_pop(L, 3);  /* pop pivot, a[i], a[j] */
-        break;
-      }
-      set2(L, i, j);
-    }
-    lua_rawgeti(L, 1, u-1);
-    lua_rawgeti(L, 1, i);
-    set2(L, u-1, i);  /* swap pivot (a[u-1]) with a[i] */
-    /* a[l..i-1] <= a[i] == P <= a[i+1..u] */
-    /* adjust so that smaller half is in [j..i] and larger one in [l..u] */
-    if (i-l < u-i) {
-      j=l; i=i-1; l=i+2;
-    }
-    else {
-      j=i+1; i=u; u=j-2;
-    }
-    auxsort(L, j, i);  /* call recursively the smaller one */
-  }  /* repeat the routine for the larger one */
-}
-
 static int sort (lua_State *L) {
   int n = aux_getn(L, 1);
-  luaL_checkstack(L, 40, "");  /* assume array is smaller than 2^40 */
-  if (!lua_isnoneornil(L, 2))  /* is there a 2nd argument? */
+  int comp = 0;
+  if (!lua_isnoneornil(L, 2)) {  /* is there a 2nd argument? */
     luaL_checktype(L, 2, LUA_TFUNCTION);
-  lua_settop(L, 2);  /* make sure there is two arguments */
-  auxsort(L, 1, n);
+    comp = 2;
+  }
+  lua_rawsort(L, 1, n, comp, lua_toboolean(L, 3));
   return 0;
 }
 
@@ -257,11 +227,15 @@ static int sort (lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+  {"clear", tclear},
+  {"clone", tclone},
   {"concat", tconcat},
 #if defined(LUA_COMPAT_MAXN)
   {"maxn", maxn},
 #endif
   {"insert", tinsert},
+  {"move", tmove},
+  {"new", tnew},
   {"pack", pack},
   {"unpack", unpack},
   {"remove", tremove},
@@ -169,6 +169,7 @@ LUA_API void  (lua_xmove) (lua_State *from, lua_State *to, int n);
 
 LUA_API int             (lua_isnumber) (lua_State *L, int idx);
 LUA_API int             (lua_isstring) (lua_State *L, int idx);
+LUA_API int             (lua_isinteger) (lua_State *L, int idx);
 LUA_API int             (lua_iscfunction) (lua_State *L, int idx);
 LUA_API int             (lua_isuserdata) (lua_State *L, int idx);
 LUA_API int             (lua_type) (lua_State *L, int idx);
@@ -236,6 +237,7 @@ LUA_API void  (lua_rawget) (lua_State *L, int idx);
 LUA_API void  (lua_rawgeti) (lua_State *L, int idx, int n);
 LUA_API void  (lua_rawgetp) (lua_State *L, int idx, const void *p);
 LUA_API void  (lua_createtable) (lua_State *L, int narr, int nrec);
+LUA_API void  (lua_clonetable) (lua_State *L, int idx);
 LUA_API void *(lua_newuserdata) (lua_State *L, size_t sz);
 LUA_API int   (lua_getmetatable) (lua_State *L, int objindex);
 LUA_API void  (lua_getuservalue) (lua_State *L, int idx);
@@ -250,6 +252,11 @@ LUA_API void  (lua_setfield) (lua_State *L, int idx, const char *k);
 LUA_API void  (lua_rawset) (lua_State *L, int idx);
 LUA_API void  (lua_rawseti) (lua_State *L, int idx, int n);
 LUA_API void  (lua_rawsetp) (lua_State *L, int idx, const void *p);
+LUA_API void  (lua_cleartable) (lua_State *L, int idx);
+LUA_API void  (lua_rawmove) (lua_State *L, int idx, int f, int e, int d,
+                                           int tidx);
+LUA_API void  (lua_rawsort) (lua_State *L, int idx, int n, int comp,
+                                           int stable);
 LUA_API int   (lua_setmetatable) (lua_State *L, int objindex);
 LUA_API void  (lua_setuservalue) (lua_State *L, int idx);
 
@@ -312,8 +319,11 @@ LUA_API int   (lua_error) (lua_State *L);
 LUA_API int   (lua_next) (lua_State *L, int idx);
 
 LUA_API void  (lua_concat) (lua_State *L, int n);
+LUA_API int   (lua_rawconcat) (lua_State *L, int idx, int i, int j, int *bad);
 LUA_API void  (lua_len)    (lua_State *L, int idx);
 
+LUA_API size_t   (lua_stringtonumber) (lua_State *L, const char *s);
+
 LUA_API lua_Alloc (lua_getallocf) (lua_State *L, void **ud);
 LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 
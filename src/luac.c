@@ -21,6 +21,7 @@
 
 static void PrintFunction(const Proto* f, int full);
 #define luaU_print	PrintFunction
+static void EmitC(lua_State* L, const Proto* f, const char* module, FILE* D);
 
 #define PROGNAME	"luac"		/* default program name */
 #define OUTPUT		PROGNAME ".out"	/* default output file */
@@ -28,6 +29,8 @@ static void PrintFunction(const Proto* f, int full);
 static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
+static int optimizing=1;		/* optimize bytecodes? */
+static const char* cmodule=NULL;	/* translate to C for this module? */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -53,7 +56,9 @@ static void usage(const char* message)
  fprintf(stderr,
   "usage: %s [options] [filenames]\n"
   "Available options are:\n"
+  "  -C name  output C source for module " LUA_QL("name") "\n"
   "  -l       list (use -l -l for full listing)\n"
+  "  -n       do not optimize\n"
   "  -o name  output to file " LUA_QL("name") " (default is \"%s\")\n"
   "  -p       parse only\n"
   "  -s       strip debug information\n"
@@ -83,8 +88,15 @@ static int doargs(int argc, char* argv[])
   }
   else if (IS("-"))			/* end of options; use stdin */
    break;
+  else if (IS("-C"))			/* translate to C */
+  {
+   cmodule=argv[++i];
+   if (cmodule==NULL || *cmodule==0) usage(LUA_QL("-C") " needs argument");
+  }
   else if (IS("-l"))			/* list */
    ++listing;
+  else if (IS("-n"))			/* do not optimize */
+   optimizing=0;
   else if (IS("-o"))			/* output file */
   {
    output=argv[++i];
@@ -169,7 +181,8 @@ static int pmain(lua_State* L)
  for (i=0; i<argc; i++)
  {
   const char* filename=IS("-") ? NULL : argv[i];
-  if (luaL_loadfile(L,filename)!=LUA_OK) fatal(lua_tostring(L,-1));
+  if (luaL_loadfilex(L,filename,optimizing ? "bto" : NULL)!=LUA_OK)
+   fatal(lua_tostring(L,-1));
  }
  f=combine(L,argc);
  if (listing) luaU_print(f,listing>1);
@@ -177,9 +190,14 @@ static int pmain(lua_State* L)
  {
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
   if (D==NULL) cannot("open");
-  lua_lock(L);
-  luaU_dump(L,f,writer,D,stripping);
-  lua_unlock(L);
+  if (cmodule!=NULL)
+   EmitC(L,f,cmodule,D);
+  else
+  {
+   lua_lock(L);
+   luaU_dump(L,f,writer,D,stripping);
+   lua_unlock(L);
+  }
   if (ferror(D)) cannot("write");
   if (fclose(D)) cannot("close");
  }
@@ -260,11 +278,29 @@ static void PrintConstant(const Proto* f, int i)
 	printf(bvalue(o) ? "true" : "false");
 	break;
   case LUA_TNUMBER:
-	printf(LUA_NUMBER_FMT,nvalue(o));
+	if (ttisinteger(o))
+	 printf(LUA_INTEGER_FMT,ivalue(o));
+	else
+	 printf(LUA_NUMBER_FMT,fltvalue(o));
 	break;
   case LUA_TSTRING:
 	PrintString(rawtsvalue(o));
 	break;
+  case LUA_TTABLE:			/* constructor template */
+  {
+	const Table* h=hvalue(o);
+	int j;
+	if (h->fields==NULL)		/* cases of OP_SWITCH */
+	{
+	 printf("switch");
+	 break;
+	}
+	printf("{");
+	for (j=0; j<h->fields->shape->nkeys; j++)
+	 printf("%s%s",j>0 ? "," : "",getstr(h->fields->shape->keys[j]));
+	printf("}");
+	break;
+  }
   default:				/* cannot happen */
 	printf("? type=%d",ttype(o));
 	break;
@@ -311,9 +347,11 @@ static void PrintCode(const Proto* f)
     printf("%d",MYK(ax));
     break;
   }
-  switch (o)
+  switch (GET_GENOPCODE(i))
   {
    case OP_LOADK:
+   case OP_NEWTEMPL:
+   case OP_SWITCH:
     printf("\t; "); PrintConstant(f,bx);
     break;
    case OP_GETUPVAL:
@@ -330,10 +368,14 @@ static void PrintCode(const Proto* f)
     if (ISK(c)) { printf(" "); PrintConstant(f,INDEXK(c)); }
     break;
    case OP_GETTABLE:
+   case OP_GETFIELD:
+   case OP_GETI:
    case OP_SELF:
     if (ISK(c)) { printf("\t; "); PrintConstant(f,INDEXK(c)); }
     break;
    case OP_SETTABLE:
+   case OP_SETFIELD:
+   case OP_SETI:
    case OP_ADD:
    case OP_SUB:
    case OP_MUL:
@@ -430,3 +472,195 @@ static void PrintFunction(const Proto* f, int full)
  if (full) PrintDebug(f);
  for (i=0; i<n; i++) PrintFunction(f->p[i],full);
 }
+
+/*
+** $Id: cgen.c $
+** translate functions to C (luac -C)
+** See Copyright Notice in lua.h
+*/
+
+/*
+** Each function becomes a C function that runs its frame as the
+** baseline compiler in ljit.c does: one C statement per instruction,
+** mostly calls to the helpers in 'luaJ_helper', with jumps as gotos.
+** A switch on 'savedpc' enters it at any instruction (an OP_SWITCH
+** goes through it too).
+** The chunk itself is embedded as a precompiled binary chunk, so that
+** loading it creates the prototypes without parsing; 'luaopen_<name>'
+** then attaches the C functions to them (see 'luaJ_loadnative').
+*/
+
+#include "ljit.h"
+
+typedef struct {
+ FILE* D;
+ size_t n;
+} CWriter;
+
+static int cwriter(lua_State* L, const void* p, size_t size, void* u)
+{
+ CWriter* w=(CWriter*)u;
+ const unsigned char* b=(const unsigned char*)p;
+ size_t i;
+ UNUSED(L);
+ for (i=0; i<size; i++)
+  fprintf(w->D,"%s%d,",(w->n++%20==0)?"\n ":"",(int)b[i]);
+ return ferror(w->D);
+}
+
+static int CountFunctions(const Proto* f)
+{
+ int i,n=1;
+ for (i=0; i<f->sizep; i++) n+=CountFunctions(f->p[i]);
+ return n;
+}
+
+static void EmitGoto(FILE* D, int pc, int target)
+{
+ if (target>pc)
+  fprintf(D,"goto L%d;",target);
+ else
+  fprintf(D,"BACK(%d);",target);
+}
+
+static void EmitCode(FILE* D, const Proto* f)
+{
+ int pc;
+ for (pc=0; pc<f->sizecode; pc++)
+ {
+  Instruction i=f->code[pc];
+  OpCode o=GET_GENOPCODE(i);
+  int a=GETARG_A(i);
+  int b=GETARG_B(i);
+  int c=GETARG_C(i);
+  int sbx=GETARG_sBx(i);
+  fprintf(D," L%d:  /* %s */\n  ",pc,luaP_opnames[o]);
+  switch (o)
+  {
+   case OP_MOVE:
+	fprintf(D,"setobjs2s(L, R(%d), R(%d));",a,b);
+	break;
+   case OP_LOADK:
+	fprintf(D,"setobj2s(L, R(%d), cl->p->k + %d);",a,GETARG_Bx(i));
+	break;
+   case OP_LOADBOOL:
+	fprintf(D,"setbvalue(R(%d), %d);",a,b);
+	if (c) fprintf(D," goto L%d;",pc+2);
+	break;
+   case OP_LOADNIL:
+	fprintf(D,"{ int j; for (j = %d; j <= %d; j++) setnilvalue(R(j)); }",
+		a,a+b);
+	break;
+   case OP_GETUPVAL:
+	fprintf(D,"setobj2s(L, R(%d), cl->upvals[%d]->v);",a,b);
+	break;
+   case OP_JMP:
+	if (a) fprintf(D,"H(OP_JMP, %d); ",pc+1);
+	EmitGoto(D,pc,pc+1+sbx);
+	break;
+   case OP_EQ: case OP_LT: case OP_LE: case OP_TEST: case OP_TESTSET:
+	fprintf(D,"if (H(OP_%s, %d)) goto L%d;",luaP_opnames[o],pc+1,pc+2);
+	break;
+   case OP_SWITCH:			/* the case is left in 'savedpc' */
+	fprintf(D,"if (H(OP_SWITCH, %d)) goto dispatch;",pc+1);
+	break;
+   case OP_LEN:
+	if (GET_OPCODE(i)==OP_APPEND)	/* may do the ADD and SETTABLE too */
+	 fprintf(D,"if (H(OP_APPEND, %d)) goto L%d;",pc+1,pc+3);
+	else
+	 fprintf(D,"H(OP_LEN, %d);",pc+1);
+	break;
+   case OP_CALL:
+	fprintf(D,"{ int r = H(OP_CALL, %d); if (r != 0) return r; }",pc+1);
+	break;
+   case OP_TAILCALL: case OP_RETURN:
+	fprintf(D,"INTERP(%d);",pc);
+	break;
+   case OP_FORLOOP: case OP_TFORLOOP:
+	fprintf(D,"if (H(OP_%s, %d)) { ",luaP_opnames[o],pc+1);
+	EmitGoto(D,pc,pc+1+sbx);
+	fprintf(D," }");
+	break;
+   case OP_FORPREP:
+	fprintf(D,"{ int r = H(OP_FORPREP, %d); "
+		"if (r < 0) goto L%d; if (r > 0) goto L%d; }",
+		pc+1,pc+2+sbx,pc+1+sbx);
+	break;
+   case OP_EXTRAARG:
+	fprintf(D,";");
+	break;
+   default:
+	fprintf(D,"H(OP_%s, %d);",luaP_opnames[o],pc+1);
+	break;
+  }
+  fprintf(D,"\n");
+ }
+}
+
+static int HasSwitch(const Proto* f)
+{
+ int pc;
+ for (pc=0; pc<f->sizecode; pc++)
+  if (GET_OPCODE(f->code[pc])==OP_SWITCH) return 1;
+ return 0;
+}
+
+static int EmitFunction(FILE* D, const Proto* f, int n)
+{
+ int i,m=n+1;
+ const char* s=f->source ? getstr(f->source) : "=?";
+ if (*s=='@' || *s=='=') s++; else s="(string)";
+ fprintf(D,"\n/* %s <%s:%d,%d> */\n",
+	(f->linedefined==0)?"main":"function",s,
+	f->linedefined,f->lastlinedefined);
+ fprintf(D,"static int f%d (lua_State *L, CallInfo *ci) {\n",n);
+ fprintf(D,"  LClosure *cl = clLvalue(ci->func);\n");
+ fprintf(D,"  const Instruction *code = cl->p->code;\n");
+ fprintf(D,"  (void)L;\n");
+ if (HasSwitch(f)) fprintf(D," dispatch:\n");
+ fprintf(D,"  switch (ci->u.l.savedpc - code) {\n");
+ for (i=0; i<f->sizecode; i++) fprintf(D,"    case %d: goto L%d;\n",i,i);
+ fprintf(D,"    default: lua_assert(0); return JIT_INTERP;\n  }\n");
+ EmitCode(D,f);
+ fprintf(D,"  return JIT_INTERP;  /* not reached */\n}\n");
+ for (i=0; i<f->sizep; i++) m=EmitFunction(D,f->p[i],m);
+ return m;
+}
+
+static void EmitC(lua_State* L, const Proto* f, const char* module, FILE* D)
+{
+ CWriter w;
+ int i,n=CountFunctions(f);
+ char* name=(char*)malloc(strlen(module)+1);
+ if (name==NULL) fatal("not enough memory");
+ for (i=0; module[i]!=0; i++)
+  name[i]=isalnum((unsigned char)module[i]) ? module[i] : '_';
+ name[i]=0;
+ fprintf(D,"/* module " LUA_QS " precompiled by luac -C */\n\n",module);
+ fprintf(D,"#define LUA_CORE\n\n#include \"lua.h\"\n\n");
+ fprintf(D,"#include \"ljit.h\"\n#include \"lobject.h\"\n"
+	"#include \"lstate.h\"\n\n");
+ fprintf(D,"#define R(x)\t\t(ci->u.l.base + (x))\n");
+ fprintf(D,"#define H(o,n)\t\t(luaJ_helper[o](L, code + (n)))\n");
+ fprintf(D,"#define INTERP(n)\t"
+	"{ ci->u.l.savedpc = code + (n); return JIT_INTERP; }\n");
+ fprintf(D,"#define BACK(n) \\\n"
+	"\tif (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) INTERP(n) "
+	"else goto L##n\n");
+ EmitFunction(D,f,0);
+ fprintf(D,"\nstatic const unsigned char chunk[] = {");
+ w.D=D; w.n=0;
+ lua_lock(L);
+ luaU_dump(L,f,cwriter,&w,stripping);
+ lua_unlock(L);
+ fprintf(D,"\n};\n\nstatic const NativeFunction functions[] = {");
+ for (i=0; i<n; i++) fprintf(D,"%s f%d,",(i%10==0)?"\n ":"",i);
+ fprintf(D,"\n};\n\n");
+ fprintf(D,"LUAMOD_API int luaopen_%s (lua_State *L) {\n",name);
+ fprintf(D,"  if (luaJ_loadnative(L, (const char *)chunk, sizeof(chunk), "
+	"\"=%s\",\n                      functions, %d) != LUA_OK)\n",module,n);
+ fprintf(D,"    return lua_error(L);\n");
+ fprintf(D,"  lua_insert(L, 1);  /* chunk below its arguments */\n");
+ fprintf(D,"  lua_call(L, lua_gettop(L) - 1, 1);\n  return 1;\n}\n");
+ free(name);
+}
@@ -237,6 +237,48 @@
 #define LUAI_MAXSHORTLEN        40
 
 
+/*
+@@ LUA_USE_JUMPTABLE controls the use of direct-threaded dispatch
+@* ("computed goto") in the interpreter main loop.
+** It needs the "labels as values" extension from GCC (also accepted
+** by Clang). CHANGE it to 0 if you want the portable 'switch' dispatch
+** even with those compilers.
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__) && !defined(LUA_ANSI)
+#define LUA_USE_JUMPTABLE	1
+#else
+#define LUA_USE_JUMPTABLE	0
+#endif
+#endif
+
+
+/*
+@@ LUA_USE_SSE2 controls the use of SSE2 instructions to probe the hash
+@* part of tables 16 nodes at a time (see ltable.c).
+** It is on when the compiler targets SSE2 (as all x86-64 compilers do).
+** CHANGE it to 0 if you want the portable probing loop.
+*/
+/* 使用SSE2指令一次探测哈希表的16个节点 */
+#if !defined(LUA_USE_SSE2)
+#if defined(__SSE2__) && !defined(LUA_ANSI)
+#define LUA_USE_SSE2	1
+#else
+#define LUA_USE_SSE2	0
+#endif
+#endif
+
+
+/*
+@@ LUAI_INCRHASH is the size (in nodes) from which the hash part of a
+@* table grows incrementally: its entries move to the new part a few at
+@* a time on later insertions, instead of all at once in the insertion
+@* that made it grow (see ltable.c).
+*/
+/* 哈希部分达到此节点数量后渐进地增长 */
+#define LUAI_INCRHASH	(1 << 16)
+
+
 
 /*
 ** {==================================================================
@@ -442,7 +484,7 @@
 */
 
 /* the following operations need the math library */
-#if defined(lobject_c) || defined(lvm_c)
+#if defined(lobject_c) || defined(lvm_c) || defined(ljit_c)
 #include <math.h>
 #define luai_nummod(L,a,b)	((a) - l_mathop(floor)((a)/(b))*(b))
 #define luai_numpow(L,a,b)	(l_mathop(pow)(a,b))
@@ -465,11 +507,106 @@
 
 
 /*
-@@ LUA_INTEGER is the integral type used by lua_pushinteger/lua_tointeger.
-** CHANGE that if ptrdiff_t is not adequate on your machine. (On most
-** machines, ptrdiff_t gives a good choice between int or long.)
+@@ LUA_INTEGER is the integral type of the integer subtype of numbers,
+@* also used by lua_pushinteger/lua_tointeger.
+@@ LUAI_UINTEGER is the unsigned version of LUA_INTEGER.
+@@ LUA_MAXINTEGER/LUA_MININTEGER are the limits of LUA_INTEGER.
+@@ LUA_INTEGER_FMT is the format for writing integers.
+@@ lua_integer2str converts an integer to a string.
+** CHANGE them if you want integers with a different size. With
+** 'long long' available (C99) integers have 64 bits; otherwise they
+** fall back to 'long'.
+*/
+/* 整数子类型的定义,尽可能使用64位整数 */
+#if defined(LUA_USE_LONGLONG)	/* { */
+
+#define LUA_INTEGER		long long
+#define LUAI_UINTEGER		unsigned long long
+#define LUA_MAXINTEGER		LLONG_MAX
+#define LUA_MININTEGER		LLONG_MIN
+#define LUA_INTEGER_FMT		"%lld"
+
+#else				/* }{ */
+
+#define LUA_INTEGER		long
+#define LUAI_UINTEGER		unsigned long
+#define LUA_MAXINTEGER		LONG_MAX
+#define LUA_MININTEGER		LONG_MIN
+#define LUA_INTEGER_FMT		"%ld"
+
+#endif				/* } */
+
+/*
+** With LUA_NANTRICK (see below) integer values must fit in the 47-bit
+** payload of a boxed value; larger integers become floats.
+*/
+/* NaN技巧下整数只有47位 */
+#if defined(LUA_NANTRICK)	/* { */
+#if !defined(LUA_USE_LONGLONG)
+#error option 'LUA_NANTRICK' needs 64-bit integers ('long long')
+#endif
+#undef LUA_MAXINTEGER
+#undef LUA_MININTEGER
+#define LUA_MAXINTEGER		0x3FFFFFFFFFFFLL
+#define LUA_MININTEGER		(-LUA_MAXINTEGER - 1)
+#endif				/* } */
+
+#define lua_integer2str(s,n)	sprintf((s), LUA_INTEGER_FMT, (n))
+
+/*
+@@ luai_intfits checks whether an integer is inside the range
+@* [LUA_MININTEGER, LUA_MAXINTEGER] (always true when LUA_INTEGER
+@* has exactly that range).
+*/
+#define luai_intfits(i)  \
+	((LUAI_UINTEGER)(i) - (LUAI_UINTEGER)LUA_MININTEGER <= \
+	 (LUAI_UINTEGER)LUA_MAXINTEGER - (LUAI_UINTEGER)LUA_MININTEGER)
+
+
+/*
+@@ The luai_int* macros define the primitive operations over integers.
+** Each one stores the result in 'r' and returns true when the
+** operation cannot be done with integers (overflow, division by zero,
+** or a result that must be a float, such as -0); in that case the
+** operation falls back to floats. Integer arithmetic never wraps around.
 */
-#define LUA_INTEGER	ptrdiff_t
+/* 整数运算,返回真表示需要回退到浮点数运算(溢出等) */
+#if defined(LUA_CORE)	/* { */
+
+#if (defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__)	/* { */
+#define luai_intadd(L,r,a,b)  \
+	(__builtin_add_overflow((a), (b), &(r)) || !luai_intfits(r))
+#define luai_intsub(L,r,a,b)  \
+	(__builtin_sub_overflow((a), (b), &(r)) || !luai_intfits(r))
+#define luai_intmul(L,r,a,b)  \
+	(__builtin_mul_overflow((a), (b), &(r)) || !luai_intfits(r) || \
+	 ((r) == 0 && ((a) ^ (b)) < 0))
+#else				/* }{ */
+/* portable versions, using unsigned arithmetic to detect overflows */
+#define luai_intadd(L,r,a,b)  \
+	((r) = (LUA_INTEGER)((LUAI_UINTEGER)(a) + (LUAI_UINTEGER)(b)), \
+	 (((a) ^ (r)) & ((b) ^ (r))) < 0 || !luai_intfits(r))
+#define luai_intsub(L,r,a,b)  \
+	((r) = (LUA_INTEGER)((LUAI_UINTEGER)(a) - (LUAI_UINTEGER)(b)), \
+	 (((a) ^ (b)) & ((a) ^ (r))) < 0 || !luai_intfits(r))
+#define luai_intmul(L,r,a,b)  \
+	(((a) != 0 && ((b) == -1 ? (a) == LUA_MININTEGER : \
+	   ((a) == -1 ? (b) == LUA_MININTEGER : \
+	   ((b) != 0 && ((a) > 0 ? ((b) > 0 ? (a) > LUA_MAXINTEGER / (b) \
+	                                    : (b) < LUA_MININTEGER / (a)) \
+	                         : ((b) > 0 ? (a) < LUA_MININTEGER / (b) \
+	                                    : (a) < LUA_MAXINTEGER / (b))))))) \
+	 || ((r) = (a) * (b), !luai_intfits(r) || \
+	     ((r) == 0 && ((a) ^ (b)) < 0)))
+#endif				/* } */
+
+#define luai_intmod(L,r,a,b)  \
+	((b) == 0 || ((r) = ((b) == -1) ? 0 : (a) % (b), \
+	  ((r) != 0 && ((r) ^ (b)) < 0) ? ((r) += (b), 0) : 0))
+#define luai_intunm(L,r,a)  \
+	((a) == 0 || (a) == LUA_MININTEGER || ((r) = -(a), 0))
+
+#endif				/* } */
 
 /*
 @@ LUA_UNSIGNED is the integral type used by lua_pushunsigned/lua_tounsigned.
@@ -483,6 +620,17 @@
 ** Some tricks with doubles
 */
 
+/*
+@@ LUA_NANTRICK controls the use of a trick to pack all types into
+** a single double value (8 bytes per TValue instead of 16), using NaN
+** values to represent non-number values. The trick needs IEEE 754
+** doubles, 64-bit integers and pointers that fit in 47 bits (true for
+** user space in x86-64 and in most 64-bit systems). Integers are then
+** restricted to 47 bits. CHANGE it (define it) if you want the smaller
+** representation; it is not enabled by default.
+*/
+/* #define LUA_NANTRICK */
+
 #if defined(LUA_NUMBER_DOUBLE) && !defined(LUA_ANSI)	/* { */
 /*
 ** The next definitions activate some tricks to speed up the
@@ -499,14 +647,7 @@
 **
 @@ LUA_IEEEENDIAN is the endianness of doubles in your machine
 ** (0 for little endian, 1 for big endian); if not defined, Lua will
-** check it dynamically for LUA_IEEE754TRICK (but not for LUA_NANTRICK).
-**
-@@ LUA_NANTRICK controls the use of a trick to pack all types into
-** a single double value, using NaN values to represent non-number
-** values. The trick only works on 32-bit machines (ints and pointers
-** are 32-bit values) with numbers represented as IEEE 754-2008 doubles
-** with conventional endianess (12345678 or 87654321), in CPUs that do
-** not produce signaling NaN values (all NaNs are quiet).
+** check it dynamically for LUA_IEEE754TRICK.
 */
 
 /* Microsoft compiler on a Pentium (32 bit) ? */
@@ -514,16 +655,13 @@
 
 #define LUA_MSASMTRICK
 #define LUA_IEEEENDIAN		0
-#define LUA_NANTRICK
 
 
 /* pentium 32 bits? */
 #elif defined(__i386__) || defined(__i386) || defined(__X86__) /* }{ */
 
 #define LUA_IEEE754TRICK
-#define LUA_IEEELL
 #define LUA_IEEEENDIAN		0
-#define LUA_NANTRICK
 
 /* pentium 64 bits? */
 #elif defined(__x86_64)						/* }{ */
@@ -548,6 +686,22 @@
 /* }================================================================== */
 
 
+/*
+@@ LUA_USE_JIT turns on the baseline compiler to machine code (see
+** ljit.c). It is off by default: define LUA_JIT to get it. It only
+** knows x86-64 with the System V calling convention and the standard
+** 16-byte TValue, so it stays off elsewhere and with LUA_NANTRICK.
+** Chunks translated to C by 'luac -C' run without it.
+@@ LUAI_JITHOT is the number of calls plus loop iterations after which
+** a function is compiled.
+*/
+#if defined(LUA_JIT) && defined(LUA_USE_LINUX) && defined(__x86_64__) && \
+    !defined(LUA_NANTRICK)
+#define LUA_USE_JIT
+#endif
+
+#define LUAI_JITHOT	100
+
 
 
 /* =================================================================== */
@@ -17,6 +17,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstring.h"
+#include "ltable.h"
 #include "lundump.h"
 #include "lzio.h"
 
@@ -69,6 +70,13 @@ static lua_Number LoadNumber(LoadState* S)
  return x;
 }
 
+static lua_Integer LoadInteger(LoadState* S)
+{
+ lua_Integer x;
+ LoadVar(S,x);
+ return x;
+}
+
 static TString* LoadString(LoadState* S)
 {
  size_t size;
@@ -89,38 +97,93 @@ static void LoadCode(LoadState* S, Proto* f)
  f->code=luaM_newvector(S->L,n,Instruction);
  f->sizecode=n;
  LoadVector(S,f->code,n,sizeof(Instruction));
+ luaF_newicache(S->L,f);
 }
 
 static void LoadFunction(LoadState* S, Proto* f);
 
-static void LoadConstants(LoadState* S, Proto* f)
+static void LoadConstant(LoadState* S, TValue* o, int intemplate)
 {
- int i,n;
- n=LoadInt(S);
- f->k=luaM_newvector(S->L,n,TValue);
- f->sizek=n;
- for (i=0; i<n; i++) setnilvalue(&f->k[i]);
- for (i=0; i<n; i++)
+ int t=LoadChar(S);
+ switch (t)
  {
-  TValue* o=&f->k[i];
-  int t=LoadChar(S);
-  switch (t)
-  {
-   case LUA_TNIL:
+  case LUA_TNIL:
 	setnilvalue(o);
 	break;
-   case LUA_TBOOLEAN:
+  case LUA_TBOOLEAN:
 	setbvalue(o,LoadChar(S));
 	break;
-   case LUA_TNUMBER:
+  case LUA_TNUMFLT:
 	setnvalue(o,LoadNumber(S));
 	break;
-   case LUA_TSTRING:
+  case LUA_TNUMINT:
+  {
+	lua_Integer x=LoadInteger(S);
+	if (luai_intfits(x))		/* may not fit with LUA_NANTRICK */
+	{ setivalue(o,x); }
+	else
+	{ setnvalue(o,cast_num(x)); }
+	break;
+  }
+  case LUA_TSTRING:
 	setsvalue2n(S->L,o,LoadString(S));
 	break;
-    default: lua_assert(0);
+  case LUA_TTABLE:			/* constructor template */
+  {
+	Table* h;
+	int i,na,n;
+	if (intemplate) error(S,"corrupted");
+	h=luaH_new(S->L);
+	sethvalue(S->L,o,h);		/* (anchors it) */
+	na=LoadInt(S);
+	n=LoadInt(S);
+	if (n==0 || n>MAXSHAPE) error(S,"corrupted");
+	luaH_presize(S->L,h,na,n);
+	for (i=0; i<n; i++)
+	{
+	 TString* key=LoadString(S);
+	 if (key==NULL || key->tsv.tt!=LUA_TSHRSTR ||
+	     luaH_getstr(h,key)!=luaO_nilobject) error(S,"corrupted");
+	 LoadConstant(S,luaH_addfield(S->L,h,key),1);
+	}
+	invalidateTMcache(h);		/* copies may become metatables */
+	break;
+  }
+  case LUAC_TSWITCH:			/* cases of OP_SWITCH */
+  {
+	Table* h;
+	int i,n;
+	if (intemplate) error(S,"corrupted");
+	h=luaH_new(S->L);
+	sethvalue(S->L,o,h);		/* (anchors it) */
+	n=LoadInt(S);
+	for (i=0; i<n; i++)
+	{
+	 TValue* key=S->L->top;
+	 TValue offset;
+	 LoadConstant(S,key,1);
+	 incr_top(S->L);		/* (anchors it) */
+	 if (ttisnumber(key) ? luai_numisnan(S->L,nvalue(key))
+	                     : !ttisstring(key))
+	  error(S,"corrupted");
+	 setivalue(&offset,LoadInt(S));
+	 luaH_set(S->L,h,key,&offset);
+	 S->L->top--;
+	}
+	break;
   }
+  default: error(S,"corrupted");
  }
+}
+
+static void LoadConstants(LoadState* S, Proto* f)
+{
+ int i,n;
+ n=LoadInt(S);
+ f->k=luaM_newvector(S->L,n,TValue);
+ f->sizek=n;
+ for (i=0; i<n; i++) setnilvalue(&f->k[i]);
+ for (i=0; i<n; i++) LoadConstant(S,&f->k[i],0);
  n=LoadInt(S);
  f->p=luaM_newvector(S->L,n,Proto*);
  f->sizep=n;
@@ -253,6 +316,7 @@ void luaU_header (lu_byte* h)
  *h++=cast_byte(sizeof(size_t));
  *h++=cast_byte(sizeof(Instruction));
  *h++=cast_byte(sizeof(lua_Number));
+ *h++=cast_byte(sizeof(lua_Integer));
  *h++=cast_byte(((lua_Number)0.5)==0);		/* is lua_Number integral? */
  memcpy(h,LUAC_TAIL,sizeof(LUAC_TAIL)-sizeof(char));
 }
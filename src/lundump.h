@@ -19,10 +19,15 @@ LUAI_FUNC void luaU_header (lu_byte* h);
 /* dump one chunk; from ldump.c */
 LUAI_FUNC int luaU_dump (lua_State* L, const Proto* f, lua_Writer w, void* data, int strip);
 
+/* tag of the case table of an OP_SWITCH among the constants; the other
+   table constants are constructor templates, which have a shape */
+#define LUAC_TSWITCH		(LUA_TTABLE | (1 << 4))
+
 /* data to catch conversion errors */
 #define LUAC_TAIL		"\x19\x93\r\n\x1a\n"
 
 /* size in bytes of header of binary files */
-#define LUAC_HEADERSIZE		(sizeof(LUA_SIGNATURE)-sizeof(char)+2+6+sizeof(LUAC_TAIL)-sizeof(char))
+#define LUAC_HEADERSIZE		(sizeof(LUA_SIGNATURE)-sizeof(char)+2+7+ \
+				 sizeof(LUAC_TAIL)-sizeof(char))
 
 #endif
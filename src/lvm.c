@@ -18,6 +18,7 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
@@ -38,9 +39,18 @@
  */
 const TValue *luaV_tonumber (const TValue *obj, TValue *n) {
   lua_Number num;
+  lua_Integer i;
 	/* 如果obj是数字类型则直接返回 */
   if (ttisnumber(obj)) return obj;
-  if (ttisstring(obj) && luaO_str2d(svalue(obj), tsvalue(obj)->len, &num)) {
+  if (!ttisstring(obj))
+    return NULL;
+  /* integral numerals become integers */
+  /* 整数形式的字符串转换成整数 */
+  if (luaO_str2int(svalue(obj), tsvalue(obj)->len, &i)) {
+    setivalue(n, i);
+    return n;
+  }
+  if (luaO_str2d(svalue(obj), tsvalue(obj)->len, &num)) {
 		/* 设置对象的值 */
     setnvalue(n, num);
     return n;
@@ -49,6 +59,36 @@ const TValue *luaV_tonumber (const TValue *obj, TValue *n) {
     return NULL;
 }
 
+
+/*
+** try to convert a float to an integer. 'mode' selects the rounding:
+** 0 accepts only integral values, 1 takes the floor and 2 the ceiling.
+** Fails (returns 0) for NaN and for values outside the integer range.
+*/
+/* 浮点数转换成整数,超出范围或者NaN时失败 */
+int luaV_flttointeger (lua_Number n, lua_Integer *p, int mode) {
+  lua_Number f = l_mathop(floor)(n);
+  if (n != f) {  /* not an integral value? */
+    if (mode == 0) return 0;
+    else if (mode == 2) f += 1;  /* ceiling */
+  }
+  if (f >= cast_num(LUA_MININTEGER) && f < -cast_num(LUA_MININTEGER)) {
+    *p = cast(lua_Integer, f);
+    return 1;
+  }
+  return 0;  /* out of range (or NaN) */
+}
+
+/* 将数字o格式化到s中(至少LUAI_MAXNUMBER2STR个字节),返回其长度 */
+static int numtostr (char *s, const TValue *o) {
+  if (ttisinteger(o))
+    return lua_integer2str(s, ivalue(o));
+  else {
+    lua_Number n = fltvalue(o);      /* 返回浮点数的值 */
+    return lua_number2str(s, n);
+  }
+}
+
 /* 转换成字符串对象
  * L lua虚拟机状态
  * obj 要转换的对象的栈索引
@@ -59,8 +99,7 @@ int luaV_tostring (lua_State *L, StkId obj) {
     return 0;
   else {
     char s[LUAI_MAXNUMBER2STR];
-    lua_Number n = nvalue(obj);      /* 返回整型的值 */
-    int l = lua_number2str(s, n);
+    int l = numtostr(s, obj);
     setsvalue2s(L, obj, luaS_newlstr(L, s, l));
     return 1;
   }
@@ -158,7 +197,8 @@ void luaV_gettable (lua_State *L, const TValue *t, TValue *key, StkId val) {
     if (ttistable(t)) {  /* `t' is a table? */
       Table *h = hvalue(t);        /* 获取哈希表值 */
 			/* 从键中取出值 */
-      const TValue *res = luaH_get(h, key); /* do a primitive get */
+      TValue aux;
+      const TValue *res = luaH_get(h, key, &aux); /* do a primitive get */
 			/* 如果不是空值或者其表的元运算为空 */
       if (!ttisnil(res) ||  /* result is not nil? */
           (tm = fasttm(L, h->metatable, TM_INDEX)) == NULL) { /* or no TM? */
@@ -194,19 +234,20 @@ void luaV_settable (lua_State *L, const TValue *t, TValue *key, StkId val) {
     const TValue *tm;
     if (ttistable(t)) {  /* `t' is a table? */
       Table *h = hvalue(t);
-      TValue *oldval = cast(TValue *, luaH_get(h, key));
+      TValue aux;
+      const TValue *oldval = luaH_get(h, key, &aux);
       /* if previous value is not nil, there must be a previous entry
          in the table; moreover, a metamethod has no relevance */
       if (!ttisnil(oldval) ||
          /* previous value is nil; must check the metamethod */
-         ((tm = fasttm(L, h->metatable, TM_NEWINDEX)) == NULL &&
-         /* no metamethod; is there a previous entry in the table? */
-         (oldval != luaO_nilobject ||
-         /* no previous entry; must create one. (The next test is
-            always true; we only need the assignment.) */
-         (oldval = luaH_newkey(L, h, key), 1)))) {
-        /* no metamethod and (now) there is an entry with given key */
-        setobj2t(L, oldval, val);  /* assign new value to that entry */
+         (tm = fasttm(L, h->metatable, TM_NEWINDEX)) == NULL) {
+        /* no metamethod or a previous entry with given key */
+        if (ttisnumber(key) || oldval == &aux)  /* (see 'invalidateborder') */
+          luaH_set(L, h, key, val);
+        else if (oldval == luaO_nilobject)  /* no previous entry? */
+          luaH_newkey(L, h, key, val);  /* create one */
+        else
+          setobj2t(L, cast(TValue *, oldval), val);  /* assign new value */
         invalidateTMcache(h);
         luaC_barrierback(L, obj2gco(h), val);
         return;
@@ -303,6 +344,68 @@ static int l_strcmp (const TString *ls, const TString *rs) {
   }
 }
 
+/*
+** exact order between an integer and a float: the float is rounded
+** to an integer in the direction that keeps the comparison result;
+** floats out of the integer range (and NaN) are decided by their sign
+*/
+/* 整数与浮点数之间的精确比较 */
+static int LTintfloat (lua_Integer i, lua_Number f) {
+  lua_Integer fi;
+  if (luaV_flttointeger(f, &fi, 2))  /* i < f <=> i < ceil(f) */
+    return i < fi;
+  else
+    return f > 0;
+}
+
+static int LEintfloat (lua_Integer i, lua_Number f) {
+  lua_Integer fi;
+  if (luaV_flttointeger(f, &fi, 1))  /* i <= f <=> i <= floor(f) */
+    return i <= fi;
+  else
+    return f > 0;
+}
+
+static int LTfloatint (lua_Number f, lua_Integer i) {
+  lua_Integer fi;
+  if (luaV_flttointeger(f, &fi, 1))  /* f < i <=> floor(f) < i */
+    return fi < i;
+  else
+    return f < 0;
+}
+
+static int LEfloatint (lua_Number f, lua_Integer i) {
+  lua_Integer fi;
+  if (luaV_flttointeger(f, &fi, 2))  /* f <= i <=> ceil(f) <= i */
+    return fi <= i;
+  else
+    return f < 0;
+}
+
+
+/* 数字比较 小于 */
+static int LTnum (lua_State *L, const TValue *l, const TValue *r) {
+  UNUSED(L);  /* only for 'luai_numlt' */
+  if (ttisinteger(l)) {
+    if (ttisinteger(r)) return ivalue(l) < ivalue(r);
+    else return LTintfloat(ivalue(l), fltvalue(r));
+  }
+  else if (ttisfloat(r)) return luai_numlt(L, fltvalue(l), fltvalue(r));
+  else return LTfloatint(fltvalue(l), ivalue(r));
+}
+
+
+/* 数字比较 小于等于 */
+static int LEnum (lua_State *L, const TValue *l, const TValue *r) {
+  UNUSED(L);  /* only for 'luai_numle' */
+  if (ttisinteger(l)) {
+    if (ttisinteger(r)) return ivalue(l) <= ivalue(r);
+    else return LEintfloat(ivalue(l), fltvalue(r));
+  }
+  else if (ttisfloat(r)) return luai_numle(L, fltvalue(l), fltvalue(r));
+  else return LEfloatint(fltvalue(l), ivalue(r));
+}
+
 /* 对象值比较 小于 
  * L 虚拟机状态
  * l 左值指针
@@ -311,7 +414,7 @@ static int l_strcmp (const TString *ls, const TString *rs) {
 int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r) {
   int res;
   if (ttisnumber(l) && ttisnumber(r))
-    return luai_numlt(L, nvalue(l), nvalue(r));
+    return LTnum(L, l, r);
   else if (ttisstring(l) && ttisstring(r))
     return l_strcmp(rawtsvalue(l), rawtsvalue(r)) < 0;
 	/* 如果以上非数字或者非字符串 */
@@ -328,7 +431,7 @@ int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r) {
 int luaV_lessequal (lua_State *L, const TValue *l, const TValue *r) {
   int res;
   if (ttisnumber(l) && ttisnumber(r))
-    return luai_numle(L, nvalue(l), nvalue(r));
+    return LEnum(L, l, r);
   else if (ttisstring(l) && ttisstring(r))
     return l_strcmp(rawtsvalue(l), rawtsvalue(r)) <= 0;
 	/* 调用元方法 */
@@ -346,11 +449,19 @@ int luaV_lessequal (lua_State *L, const TValue *l, const TValue *r) {
 /* 判断两个对象是否相等 */
 int luaV_equalobj_ (lua_State *L, const TValue *t1, const TValue *t2) {
   const TValue *tm;
-  lua_assert(ttisequal(t1, t2));      /* 断言类型必须相同 */
+  if (!ttisequal(t1, t2)) {  /* integer and float? */
+    lua_Integer i;
+    lua_assert(ttisnumber(t1) && ttisnumber(t2));
+    if (ttisinteger(t1))
+      return luaV_flttointeger(fltvalue(t2), &i, 0) && i == ivalue(t1);
+    else
+      return luaV_flttointeger(fltvalue(t1), &i, 0) && i == ivalue(t2);
+  }
 	/* 判断对象类型，分类型进行匹配 */
   switch (ttype(t1)) {
     case LUA_TNIL: return 1;
-    case LUA_TNUMBER: return luai_numeq(nvalue(t1), nvalue(t2));
+    case LUA_TNUMINT: return ivalue(t1) == ivalue(t2);
+    case LUA_TNUMFLT: return luai_numeq(fltvalue(t1), fltvalue(t2));
     case LUA_TBOOLEAN: return bvalue(t1) == bvalue(t2);  /* true must be 1 !! */
     case LUA_TLIGHTUSERDATA: return pvalue(t1) == pvalue(t2);
     case LUA_TLCF: return fvalue(t1) == fvalue(t2);
@@ -377,6 +488,204 @@ int luaV_equalobj_ (lua_State *L, const TValue *t1, const TValue *t2) {
   return !l_isfalse(L->top);
 }
 
+/*
+** convert the limit of an integer 'for' loop to an integer, rounding
+** it towards the loop start. Returns 1 if the loop must not run
+** (NaN limit, or a limit beyond the integer range on the wrong side),
+** -1 if it has to run as a floating loop instead, 0 otherwise.
+*/
+/* 转换整数for循环的限制值,返回1表示循环不执行,-1表示改用浮点循环 */
+static int forlimit (const TValue *obj, lua_Integer step, lua_Integer *p) {
+  lua_Number n;
+  if (ttisinteger(obj)) {
+    *p = ivalue(obj);
+    return 0;
+  }
+  n = fltvalue(obj);
+  if (luaV_flttointeger(n, p, (step < 0) ? 2 : 1))
+    return 0;
+  else if (luai_numisnan(NULL, n))
+    return 1;  /* NaN limit: loop never runs */
+#if defined(LUA_NANTRICK)
+  /* boxed integers are narrower than the type; clamping would stop early */
+  /* NaN装箱下整数范围较窄,截断限制值会提前结束循环 */
+  else if ((n > 0) == (step > 0))
+    return -1;
+#endif
+  else if (n > 0) {  /* limit is above the maximum integer */
+    *p = LUA_MAXINTEGER;
+    return (step < 0);
+  }
+  else {  /* limit is below the minimum integer */
+    *p = LUA_MININTEGER;
+    return (step > 0);
+  }
+}
+
+/*
+** prepare a numeric 'for' loop whose control values start at 'ra'.
+** Returns 0 for an integer loop, which falls into its body; 1 for a
+** floating loop, which jumps to its OP_FORLOOP; -1 if the loop must
+** not run at all.
+*/
+/* 准备数值for循环: 0表示整数循环直接进入循环体,
+ * 1表示浮点循环跳到FORLOOP,-1表示跳过循环 */
+int luaV_forprep (lua_State *L, StkId ra) {
+  const TValue *init = ra;
+  const TValue *plimit = ra+1;
+  const TValue *pstep = ra+2;
+  lua_Integer ilimit;
+  int skip;
+  if (!tonumber(init, ra))
+    luaG_runerror(L, LUA_QL("for") " initial value must be a number");
+  else if (!tonumber(plimit, ra+1))
+    luaG_runerror(L, LUA_QL("for") " limit must be a number");
+  else if (!tonumber(pstep, ra+2))
+    luaG_runerror(L, LUA_QL("for") " step must be a number");
+  if (ttisinteger(init) && ttisinteger(pstep) && ivalue(pstep) != 0 &&
+      (skip = forlimit(plimit, ivalue(pstep), &ilimit)) >= 0) {
+    /* integer loop: check it here and fall into the loop body */
+    /* 整数循环: 在这里检查条件,然后直接进入循环体 */
+    lua_Integer initv = ivalue(init);
+    lua_Integer step = ivalue(pstep);
+    if (skip || (step > 0 ? initv > ilimit : initv < ilimit))
+      return -1;  /* skip the loop */
+    setivalue(ra+1, ilimit);
+    setivalue(ra+3, initv);  /* external index for 1st iteration */
+    return 0;
+  }
+  else {  /* floating loop */
+    lua_Number ninit = nvalue(init);
+    lua_Number nlimit = nvalue(plimit);
+    lua_Number nstep = nvalue(pstep);
+    setnvalue(ra+1, nlimit);
+    setnvalue(ra+2, nstep);
+    setnvalue(ra, luai_numsub(L, ninit, nstep));
+    return 1;
+  }
+}
+
+
+/*
+** {==================================================================
+** Iterators of the base library: 'next' and the iterator of 'ipairs'
+** are in the core (lbaselib registers them), so that 'luaV_tforcall'
+** can recognize them
+** ===================================================================
+*/
+
+/* 基础库的next */
+int luaV_next (lua_State *L) {
+  if (lua_type(L, 1) != LUA_TTABLE)
+    luaG_argerror(L, 1, LUA_TTABLE, "next");
+  lua_settop(L, 2);  /* create a 2nd argument if there isn't one */
+  if (lua_next(L, 1))
+    return 2;
+  else {
+    lua_pushnil(L);
+    return 1;
+  }
+}
+
+
+/*
+** generator that 'luaV_tforcall' puts in the place of 'luaV_next' in a
+** generic 'for' that keeps the position of its last entry as control
+** variable. Only a debug library can get it out of the loop, and call
+** it: it then works as 'next' (with the position as a key).
+*/
+/* 控制变量为位置的泛型for循环的生成器,只有调试库能取得并调用它 */
+int luaV_nextpos (lua_State *L) {
+  return luaV_next(L);
+}
+
+
+/* ipairs的迭代器 */
+int luaV_ipairsaux (lua_State *L) {
+  int isnum;
+  int i = cast_int(lua_tointegerx(L, 2, &isnum));
+  if (!isnum)
+    luaG_argerror(L, 2, LUA_TNUMBER, "?");
+  if (lua_type(L, 1) != LUA_TTABLE)
+    luaG_argerror(L, 1, LUA_TTABLE, "?");
+  i++;  /* next value */
+  lua_pushinteger(L, i);
+  lua_rawgeti(L, 1, i);
+  return (lua_isnil(L, -1)) ? 1 : 2;
+}
+
+
+/*
+** runs a call of a generic 'for' iterator at 'ra' (with its state and
+** control value after it) without calling the iterator, when it is
+** 'luaV_next' or 'luaV_ipairsaux' over a table and no call or return
+** hook would see the call; puts 'nresults' results at 'ra+3', as the
+** call would. Returns 0 (and does nothing) otherwise.
+** The first step over 'next' finds its control key in the table; then
+** the generator becomes 'luaV_nextpos' and the control variable the
+** position of the entry returned (see 'luaH_nextpos'), which the next
+** step starts from without searching for a key. When a hook is set,
+** that next step goes back to the key, so that the following steps
+** call 'next'.
+*/
+/* 迭代器是基础库的next或ipairs的迭代器时不调用它,直接完成一次迭代;
+ * 其他迭代器(或者有调用与返回钩子时)返回0.
+ * 对next的迭代在控制变量中保存上一个元素的位置,不再查找健 */
+int luaV_tforcall (lua_State *L, StkId ra, int nresults) {
+  StkId cb = ra + 3;  /* where results go */
+  Table *h;
+  int n;  /* number of results produced */
+  int hooked = (L->hookmask & (LUA_MASKCALL | LUA_MASKRET));
+  if (!ttislcf(ra) || !ttistable(ra + 1))
+    return 0;
+  h = hvalue(ra + 1);
+  if (fvalue(ra) == luaV_nextpos && ttisinteger(ra + 2) &&
+      0 <= ivalue(ra + 2) && ivalue(ra + 2) <= MAX_INT) {
+    int pos = luaH_nextpos(L, h, cast_int(ivalue(ra + 2)), cb);
+    n = 0;
+    if (pos > 0) {
+      n = 2;
+      if (hooked) {  /* back to calling 'next' with keys */
+        setfvalue(ra, luaV_next);
+      }
+      else
+        setivalue(ra + 2, pos);
+    }
+  }
+  else if (hooked)
+    return 0;
+  else if (fvalue(ra) == luaV_next) {
+    int pos;
+    setobjs2s(L, cb, ra + 2);
+    pos = luaH_next(L, h, cb);
+    n = 0;
+    if (pos > 0) {  /* keep the position from now on */
+      n = 2;
+      setfvalue(ra, luaV_nextpos);
+      setivalue(ra + 2, pos);
+    }
+  }
+  else if (fvalue(ra) == luaV_ipairsaux && ttisinteger(ra + 2)) {
+    lua_Integer k = cast(lua_Integer, cast(lu_integer, ivalue(ra + 2)) + 1u);
+    TValue aux;
+    const TValue *v = luaH_getint(h, k, &aux);
+    if (ttisnil(v))
+      n = 0;
+    else {
+      setivalue(cb, k);
+      setobj2s(L, cb + 1, v);
+      n = 2;
+    }
+  }
+  else
+    return 0;
+  for (; n < nresults; n++)  /* complete missing results */
+    setnilvalue(cb + n);
+  return 1;
+}
+
+/* }================================================================== */
+
 /* 从栈中链接数据
  * total 表示了 数据在栈中的数量
  */
@@ -424,6 +733,81 @@ void luaV_concat (lua_State *L, int total) {
 }
 
 
+/*
+** concatenation of t[i], sep, t[i+1], sep, ..., t[j] (with raw accesses),
+** in two passes: the first one adds up the lengths (formatting numbers
+** into the concatenation buffer), the second one copies the pieces into
+** the new string, allocated once. Returns NULL if t[k] is neither a
+** string nor a number, with 'k' in '*bad'.
+*/
+/* 链接t[i..j](以sep分隔):先计算总长度(数字格式化到缓存中),再一次性分配并复制 */
+TString *luaV_tconcat (lua_State *L, Table *t, int i, int j, TString *sep,
+                       int *bad) {
+  Mbuffer *b = &G(L)->buff;
+  size_t lsep = sep->tsv.len;
+  size_t tl = 0;
+  size_t nb = 0;  /* position in the buffer of the next number */
+  char buff[LUAI_MAXSHORTLEN];
+  TString *ts = NULL;
+  char *res = buff;
+  int k;
+  if (i > j)
+    return luaS_newlstr(L, "", 0);
+  luaZ_resetbuffer(b);
+  for (k = i; ; k++) {  /* collect total length */
+    TValue aux;
+    const TValue *o = luaH_getint(t, k, &aux);
+    size_t l;
+    if (ttisstring(o))
+      l = tsvalue(o)->len;
+    else if (ttisnumber(o)) {  /* keep it formatted, with its '\0' */
+      nb = luaZ_bufflen(b);
+      if (nb + LUAI_MAXNUMBER2STR > luaZ_sizebuffer(b))  /* grow buffer */
+        luaZ_openspace(L, b, 2 * (nb + LUAI_MAXNUMBER2STR));
+      l = numtostr(luaZ_buffer(b) + nb, o);
+      luaZ_bufflen(b) += l + 1;
+    }
+    else {
+      *bad = k;
+      return NULL;
+    }
+    if (k != j)
+      l += lsep;
+    if (l >= MAX_SIZET - sizeof(TString) - tl)
+      luaG_runerror(L, "string length overflow");
+    tl += l;
+    if (k == j) break;
+  }
+  if (tl > LUAI_MAXSHORTLEN) {  /* (short strings are built in 'buff') */
+    ts = luaS_createlngstrobj(L, tl);
+    res = cast(char *, ts + 1);  /* (its contents) */
+  }
+  tl = 0;
+  nb = 0;
+  for (k = i; ; k++) {  /* copy the pieces */
+    TValue aux;
+    const TValue *o = luaH_getint(t, k, &aux);
+    const char *s;
+    size_t l;
+    if (ttisstring(o)) {
+      s = svalue(o);
+      l = tsvalue(o)->len;
+    }
+    else {  /* number formatted by the first pass */
+      s = luaZ_buffer(b) + nb;
+      l = strlen(s);
+      nb += l + 1;
+    }
+    memcpy(res + tl, s, l * sizeof(char));
+    tl += l;
+    if (k == j) break;
+    memcpy(res + tl, getstr(sep), lsep * sizeof(char));
+    tl += lsep;
+  }
+  return (ts != NULL) ? ts : luaS_newlstr(L, res, tl);
+}
+
+
 void luaV_objlen (lua_State *L, StkId ra, const TValue *rb) {
   const TValue *tm;
   switch (ttypenv(rb)) {
@@ -431,11 +815,11 @@ void luaV_objlen (lua_State *L, StkId ra, const TValue *rb) {
       Table *h = hvalue(rb);
       tm = fasttm(L, h->metatable, TM_LEN);
       if (tm) break;  /* metamethod? break switch to call it */
-      setnvalue(ra, cast_num(luaH_getn(h)));  /* else primitive len */
+      setivalue(ra, cast(lua_Integer, luaH_getn(h)));  /* else primitive len */
       return;
     }
     case LUA_TSTRING: {
-      setnvalue(ra, cast_num(tsvalue(rb)->len));
+      setivalue(ra, cast(lua_Integer, tsvalue(rb)->len));
       return;
     }
     default: {  /* try metamethod */
@@ -454,10 +838,8 @@ void luaV_arith (lua_State *L, StkId ra, const TValue *rb,
   TValue tempb, tempc;
   const TValue *b, *c;
   if ((b = luaV_tonumber(rb, &tempb)) != NULL &&
-      (c = luaV_tonumber(rc, &tempc)) != NULL) {
-    lua_Number res = luaO_arith(op - TM_ADD + LUA_OPADD, nvalue(b), nvalue(c));
-    setnvalue(ra, res);
-  }
+      (c = luaV_tonumber(rc, &tempc)) != NULL)
+    luaO_arith(op - TM_ADD + LUA_OPADD, b, c, ra);
   else if (!call_binTM(L, rb, rc, ra, op))
     luaG_aritherror(L, rb, rc);
 }
@@ -509,6 +891,21 @@ static void pushclosure (lua_State *L, Proto *p, UpVal **encup, StkId base,
 }
 
 
+/*
+** put in 'ra' a closure for prototype 'p', reusing the cached one when
+** it has the right upvalues
+*/
+/* 在ra中放入函数原型p的闭包,如果缓存的闭包upvalue相同则直接重用 */
+void luaV_closure (lua_State *L, Proto *p, UpVal **encup, StkId base,
+                   StkId ra) {
+  Closure *ncl = getcached(p, encup, base);  /* cached closure */
+  if (ncl == NULL)  /* no match? */
+    pushclosure(L, p, encup, base, ra);  /* create a new one */
+  else
+    setclLvalue(L, ra, ncl);  /* push cashed closure */
+}
+
+
 /*
 ** finish execution of an opcode interrupted by an yield
 */
@@ -516,11 +913,12 @@ void luaV_finishOp (lua_State *L) {
   CallInfo *ci = L->ci;
   StkId base = ci->u.l.base;
   Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
-  OpCode op = GET_OPCODE(inst);
+  OpCode op = GET_GENOPCODE(inst);  /* may have been quickened meanwhile */
   switch (op) {  /* finish its execution */
     case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
     case OP_MOD: case OP_POW: case OP_UNM: case OP_LEN:
-    case OP_GETTABUP: case OP_GETTABLE: case OP_SELF: {
+    case OP_GETTABUP: case OP_GETTABLE: case OP_GETFIELD: case OP_GETI:
+    case OP_SELF: {
       setobjs2s(L, base + GETARG_A(inst), --L->top);
       break;
     }
@@ -562,6 +960,7 @@ void luaV_finishOp (lua_State *L) {
       break;
     }
     case OP_TAILCALL: case OP_SETTABUP: case OP_SETTABLE:
+    case OP_SETFIELD: case OP_SETI:
       break;
     default: lua_assert(0);
   }
@@ -591,6 +990,51 @@ void luaV_finishOp (lua_State *L) {
 #define KBx(i)  \
   (k + (GETARG_Bx(i) != 0 ? GETARG_Bx(i) - 1 : GETARG_Ax(*ci->u.l.savedpc++)))
 
+/* inline cache of the current instruction */
+/* 当前指令的内联缓存 */
+#define ICACHE()	(&cl->p->icache[ci->u.l.savedpc - cl->p->code - 1])
+
+/*
+** table accesses with a short-string key (through the inline cache of
+** the instruction) or an integer key (in the array part). Only present
+** fields take the fast path (and, for stores, the keys of tables
+** without a metatable, even with nil values, as in a table built from
+** a template); anything else, including a miss, goes through the
+** generic functions and their metamethods.
+*/
+/* 短字符串健(经由内联缓存)或数组部分整数健的快速表访问,未命中时走通用路径 */
+#define getstrfield(t,key,dst) { \
+        const TValue *res; \
+        if (ttistable(t) && \
+            !ttisnil(res = luaH_getstrcached(hvalue(t), rawtsvalue(key), \
+                                             ICACHE()))) { \
+          setobj2s(L, dst, res); \
+        } \
+        else Protect(luaV_gettable(L, t, key, dst)); }
+
+#define setstrfield(t,key,val) { \
+        TValue *slot; \
+        if (ttistable(t) && \
+            (slot = cast(TValue *, luaH_getstrcached(hvalue(t), \
+                                   rawtsvalue(key), ICACHE())), \
+             luaH_storable(hvalue(t), slot))) { \
+          setobj2t(L, slot, val); \
+          invalidateTMcache(hvalue(t)); \
+          luaC_barrierback(L, obj2gco(hvalue(t)), val); \
+        } \
+        else Protect(luaV_settable(L, t, key, val)); }
+
+#define getintfield(t,key,dst) { \
+        int hit = 0; \
+        if (ttistable(t)) luaH_fastgeti(L, hvalue(t), ivalue(key), dst, hit); \
+        if (!hit) Protect(luaV_gettable(L, t, key, dst)); }
+
+#define setintfield(t,key,val) { \
+        int hit = 0; \
+        if (ttistable(t)) luaH_fastseti(L, hvalue(t), ivalue(key), val, hit); \
+        if (hit) luaC_barrierback(L, obj2gco(hvalue(t)), val) \
+        else Protect(luaV_settable(L, t, key, val)); }
+
 /* execute a jump instruction */
 /* 执行一个跳转指令 
  * 1.从寄存器A中获取值
@@ -626,10 +1070,125 @@ void luaV_finishOp (lua_State *L) {
         } \
         else { Protect(luaV_arith(L, ra, rb, rc, tm)); } }
 
+/* arithmetic with an integer fast path (falls back to floats) */
+/* 带有整数快速路径的算术操作 */
+#define arith_intop(iop,op,tm) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        lua_Integer ir; \
+        if (ttisinteger(rb) && ttisinteger(rc) && \
+            !iop(L, ir, ivalue(rb), ivalue(rc))) { \
+          setivalue(ra, ir); \
+        } \
+        else arith_op(op, tm) }
+
+/*
+** quickening (see lopcodes.h): rewrite the current instruction in place
+** into the variant 'op'. A float arithmetic that sees two floats is
+** quickened; the quickened variant reverts to the generic one as soon
+** as its guard fails.
+*/
+/* 就地将当前指令改写为op,即特化版本或通用版本 */
+#define quicken(op) \
+	SET_OPCODE(*cast(Instruction *, ci->u.l.savedpc - 1), op)
+
+#define arith_quickop(iop,op,tm,qop) { \
+        if (ttisfloat(RKB(i)) && ttisfloat(RKC(i))) \
+          quicken(qop); \
+        arith_intop(iop, op, tm) }
+
+#define arith_fltop(iop,op,tm,gop) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        if (ttisfloat(rb) && ttisfloat(rc)) { \
+          lua_Number nb = fltvalue(rb), nc = fltvalue(rc); \
+          setnvalue(ra, op(L, nb, nc)); \
+        } \
+        else { \
+          quicken(gop); \
+          arith_intop(iop, op, tm) } }
+
+/* jump (or skip the jump) after a comparison */
+/* 比较之后的条件跳转 */
+#define condjump(c) \
+        { if ((c) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci); }
+
+/* count a loop iteration; continue as machine code if that compiled it */
+/* 记录一次循环,如果因此编译了函数则改为执行机器码 */
+#define hotloop() \
+  { luaJ_hot(L, cl->p); if (luaJ_canrun(L, cl->p)) goto newframe; }
+
+/*
+** end of the first half of a superinstruction: run the instruction that
+** follows, which must have generic opcode 'o', without dispatching it
+** (unless hooks must see it)
+*/
+/* 超级指令前半部分结束: 不经派遣直接执行后面的指令 */
+#define vmfuse(o)	{ \
+  if (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) vmbreak; \
+  i = *(ci->u.l.savedpc++); \
+  lua_assert(GET_GENOPCODE(i) == o); \
+  ra = RA(i); \
+  goto L_##o; }
+
+/* fetch the next instruction (and call hooks, if needed) */
+/* 取出下一条指令,如果需要则调用hook */
+#define vmfetch()	{ \
+  i = *(ci->u.l.savedpc++); \
+  if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) && \
+      (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) { \
+    Protect(traceexec(L)); \
+  } \
+  /* WARNING: several calls may realloc the stack and invalidate `ra' */ \
+  ra = RA(i); \
+  lua_assert(base == ci->u.l.base); \
+  lua_assert(base <= L->top && L->top < L->stack + L->stacksize); }
+
+
+#if LUA_USE_JUMPTABLE	/* { */
+
+/*
+** Direct-threaded dispatch: each opcode has its own label, and every
+** handler ends with its own copy of the fetch and the indirect jump,
+** so that each one gets a separate entry in the branch predictor.
+** 'disptab' must follow the order of 'OpCode' (lopcodes.h).
+*/
+/* 直接线索化派遣,每条指令的末尾各自取指并跳转到下一条指令 */
+#define vmdispatch(o)	goto *disptab[o];
+#define vmcase(l,b)	L_##l: {b}  vmbreak;
+#define vmcasenb(l,b)	L_##l: {b}		/* nb = no break */
+#define vmcaset(l,b)	vmcase(l,b)		/* t = target of 'vmfuse' */
+#define vmbreak		{ vmfetch(); vmdispatch(GET_OPCODE(i)); }
+
+#define vmdisptab	static const void *const disptab[] = { \
+  &&L_OP_MOVE, &&L_OP_LOADK, &&L_OP_LOADKX, &&L_OP_LOADBOOL, \
+  &&L_OP_LOADNIL, &&L_OP_GETUPVAL, &&L_OP_GETTABUP, &&L_OP_GETTABLE, \
+  &&L_OP_GETFIELD, &&L_OP_GETI, &&L_OP_SETTABUP, &&L_OP_SETUPVAL, \
+  &&L_OP_SETTABLE, &&L_OP_SETFIELD, &&L_OP_SETI, &&L_OP_NEWTABLE, \
+  &&L_OP_NEWTEMPL, &&L_OP_SELF, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, \
+  &&L_OP_DIV, &&L_OP_MOD, &&L_OP_POW, &&L_OP_UNM, &&L_OP_NOT, &&L_OP_LEN, \
+  &&L_OP_CONCAT, &&L_OP_JMP, &&L_OP_EQ, &&L_OP_LT, &&L_OP_LE, \
+  &&L_OP_TEST, &&L_OP_TESTSET, &&L_OP_SWITCH, &&L_OP_CALL, \
+  &&L_OP_TAILCALL, &&L_OP_RETURN, &&L_OP_FORLOOP, &&L_OP_FORPREP, \
+  &&L_OP_TFORCALL, &&L_OP_TFORLOOP, &&L_OP_SETLIST, &&L_OP_CLOSURE, \
+  &&L_OP_VARARG, &&L_OP_EXTRAARG, &&L_OP_QADDF, &&L_OP_QSUBF, \
+  &&L_OP_QMULF, &&L_OP_QEQS, &&L_OP_QLTN, &&L_OP_QLEN, \
+  &&L_OP_GETTABUP_F, &&L_OP_GETFIELD_F, &&L_OP_GETTABUP_C, &&L_OP_SELF_C, \
+  &&L_OP_MOVE_C, &&L_OP_LOADK_C, &&L_OP_APPEND }
+
+#else			/* }{ */
+
 /* VM派遣 */
 #define vmdispatch(o)	switch(o)
 #define vmcase(l,b)	case l: {b}  break;
 #define vmcasenb(l,b)	case l: {b}		/* nb = no break */
+/* t = target of 'vmfuse' */
+#define vmcaset(l,b)	case l: L_##l: {b}  break;
+#define vmbreak		break
+#define vmdisptab	/* empty */
+
+#endif			/* } */
+
 
 /* 虚拟机主执行函数 */
 void luaV_execute (lua_State *L) {
@@ -637,24 +1196,26 @@ void luaV_execute (lua_State *L) {
   LClosure *cl;
   TValue *k;
   StkId base;
+  Instruction i;
+  StkId ra;
+  vmdisptab;
  newframe:  /* reentry point when frame changes (call/return) */
   lua_assert(ci == L->ci);
   cl = clLvalue(ci->func);    /* 取出当前要执行的函数 */
   k = cl->p->k;
   base = ci->u.l.base;        /* lua函数的栈索引 */
+  if (luaJ_canrun(L, cl->p)) {  /* run it as machine code? */
+    if (luaJ_execute(L, ci) == JIT_NEWFRAME) {  /* called a Lua function? */
+      ci = L->ci;
+      ci->callstatus |= CIST_REENTRY;
+      goto newframe;  /* restart luaV_execute over new Lua function */
+    }
+    base = ci->u.l.base;  /* else interpret from 'savedpc' */
+  }
   /* main loop of interpreter */
 	/* 指令主循环 */
   for (;;) {
-    Instruction i = *(ci->u.l.savedpc++);
-    StkId ra;
-    if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) &&
-        (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
-      Protect(traceexec(L));
-    }
-    /* WARNING: several calls may realloc the stack and invalidate `ra' */
-    ra = RA(i);
-    lua_assert(base == ci->u.l.base);
-    lua_assert(base <= L->top && L->top < L->stack + L->stacksize);
+    vmfetch();
     vmdispatch (GET_OPCODE(i)) {
       vmcase(OP_MOVE,
         setobjs2s(L, ra, RB(i));
@@ -684,15 +1245,33 @@ void luaV_execute (lua_State *L) {
         setobj2s(L, ra, cl->upvals[b]->v);
       )
       vmcase(OP_GETTABUP,
-        int b = GETARG_B(i);
-        Protect(luaV_gettable(L, cl->upvals[b]->v, RKC(i), ra));
+        TValue *upv = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        if (ttisshrstring(rc)) getstrfield(upv, rc, ra)
+        else Protect(luaV_gettable(L, upv, rc, ra));
       )
       vmcase(OP_GETTABLE,
-        Protect(luaV_gettable(L, RB(i), RKC(i), ra));
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rc)) getintfield(rb, rc, ra)
+        else Protect(luaV_gettable(L, rb, rc, ra));
+      )
+      vmcaset(OP_GETFIELD,
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        getstrfield(rb, rc, ra)
+      )
+      vmcase(OP_GETI,
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        getintfield(rb, rc, ra)
       )
       vmcase(OP_SETTABUP,
-        int a = GETARG_A(i);
-        Protect(luaV_settable(L, cl->upvals[a]->v, RKB(i), RKC(i)));
+        TValue *upv = cl->upvals[GETARG_A(i)]->v;
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisshrstring(rb)) setstrfield(upv, rb, rc)
+        else Protect(luaV_settable(L, upv, rb, rc));
       )
       vmcase(OP_SETUPVAL,
         UpVal *uv = cl->upvals[GETARG_B(i)];
@@ -700,7 +1279,20 @@ void luaV_execute (lua_State *L) {
         luaC_barrier(L, uv, ra);
       )
       vmcase(OP_SETTABLE,
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb)) setintfield(ra, rb, rc)
+        else Protect(luaV_settable(L, ra, rb, rc));
+      )
+      vmcase(OP_SETFIELD,
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        setstrfield(ra, rb, rc)
+      )
+      vmcase(OP_SETI,
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        setintfield(ra, rb, rc)
       )
       vmcase(OP_NEWTABLE,
         int b = GETARG_B(i);
@@ -708,35 +1300,47 @@ void luaV_execute (lua_State *L) {
         Table *t = luaH_new(L);
         sethvalue(L, ra, t);
         if (b != 0 || c != 0)
-          luaH_resize(L, t, luaO_fb2int(b), luaO_fb2int(c));
+          luaH_presize(L, t, luaO_fb2int(b), luaO_fb2int(c));
+        checkGC(L, ra + 1);
+      )
+      vmcase(OP_NEWTEMPL,
+        Table *t = luaH_new(L);
+        sethvalue(L, ra, t);
+        luaH_copy(L, t, hvalue(k + GETARG_Bx(i)));
         checkGC(L, ra + 1);
       )
       vmcase(OP_SELF,
         StkId rb = RB(i);
+        TValue *rc = RKC(i);
         setobjs2s(L, ra+1, rb);
-        Protect(luaV_gettable(L, rb, RKC(i), ra));
+        if (ttisshrstring(rc)) getstrfield(rb, rc, ra)
+        else Protect(luaV_gettable(L, rb, rc, ra));
       )
       vmcase(OP_ADD,
-        arith_op(luai_numadd, TM_ADD);
+        arith_quickop(luai_intadd, luai_numadd, TM_ADD, OP_QADDF);
       )
       vmcase(OP_SUB,
-        arith_op(luai_numsub, TM_SUB);
+        arith_quickop(luai_intsub, luai_numsub, TM_SUB, OP_QSUBF);
       )
       vmcase(OP_MUL,
-        arith_op(luai_nummul, TM_MUL);
+        arith_quickop(luai_intmul, luai_nummul, TM_MUL, OP_QMULF);
       )
       vmcase(OP_DIV,
         arith_op(luai_numdiv, TM_DIV);
       )
       vmcase(OP_MOD,
-        arith_op(luai_nummod, TM_MOD);
+        arith_intop(luai_intmod, luai_nummod, TM_MOD);
       )
       vmcase(OP_POW,
         arith_op(luai_numpow, TM_POW);
       )
       vmcase(OP_UNM,
         TValue *rb = RB(i);
-        if (ttisnumber(rb)) {
+        lua_Integer ir;
+        if (ttisinteger(rb) && !luai_intunm(L, ir, ivalue(rb))) {
+          setivalue(ra, ir);
+        }
+        else if (ttisnumber(rb)) {
           lua_Number nb = nvalue(rb);
           setnvalue(ra, luai_numunm(L, nb));
         }
@@ -770,28 +1374,19 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_EQ,
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
-        Protect(
-          if (cast_int(equalobj(L, rb, rc)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
+        if (ttisshrstring(rb) && ttisshrstring(rc))
+          quicken(OP_QEQS);
+        Protect(condjump(cast_int(equalobj(L, rb, rc))))
       )
       vmcase(OP_LT,
-        Protect(
-          if (luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
+        if (ttisnumber(RKB(i)) && ttisnumber(RKC(i)))
+          quicken(OP_QLTN);
+        Protect(condjump(luaV_lessthan(L, RKB(i), RKC(i))))
       )
       vmcase(OP_LE,
-        Protect(
-          if (luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
+        if (ttisnumber(RKB(i)) && ttisnumber(RKC(i)))
+          quicken(OP_QLEN);
+        Protect(condjump(luaV_lessequal(L, RKB(i), RKC(i))))
       )
       vmcase(OP_TEST,
         if (GETARG_C(i) ? l_isfalse(ra) : !l_isfalse(ra))
@@ -808,7 +1403,13 @@ void luaV_execute (lua_State *L) {
           donextjump(ci);
         }
       )
-      vmcase(OP_CALL,
+      vmcase(OP_SWITCH,
+        TValue aux;
+        const TValue *o = luaH_get(hvalue(k + GETARG_Bx(i)), ra, &aux);
+        if (ttisinteger(o))  /* a case? */
+          ci->u.l.savedpc += ivalue(o);
+      )
+      vmcaset(OP_CALL,
         int b = GETARG_B(i);
         int nresults = GETARG_C(i) - 1;
         if (b != 0) L->top = ra+b;  /* else previous instruction set top */
@@ -867,37 +1468,49 @@ void luaV_execute (lua_State *L) {
         }
       )
       vmcase(OP_FORLOOP,
-        lua_Number step = nvalue(ra+2);
-        lua_Number idx = luai_numadd(L, nvalue(ra), step); /* increment index */
-        lua_Number limit = nvalue(ra+1);
-        if (luai_numlt(L, 0, step) ? luai_numle(L, idx, limit)
-                                   : luai_numle(L, limit, idx)) {
-          ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
-          setnvalue(ra, idx);  /* update internal index... */
-          setnvalue(ra+3, idx);  /* ...and external index */
+        if (ttisinteger(ra)) {  /* integer loop? */
+          /* 整数循环: 索引永远不会越过限制,因此不会溢出 */
+          lu_integer idx = cast(lu_integer, ivalue(ra));
+          lu_integer limit = cast(lu_integer, ivalue(ra+1));
+          lua_Integer step = ivalue(ra+2);
+          if (step > 0 ? limit - idx >= cast(lu_integer, step)
+                       : idx - limit >= 0u - cast(lu_integer, step)) {
+            lua_Integer nidx = cast(lua_Integer, idx + cast(lu_integer, step));
+            ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
+            setivalue(ra, nidx);  /* update internal index... */
+            setivalue(ra+3, nidx);  /* ...and external index */
+            hotloop();
+          }
+        }
+        else {  /* floating loop */
+          lua_Number step = fltvalue(ra+2);
+          /* increment index */
+          lua_Number idx = luai_numadd(L, fltvalue(ra), step);
+          lua_Number limit = fltvalue(ra+1);
+          if (luai_numlt(L, 0, step) ? luai_numle(L, idx, limit)
+                                     : luai_numle(L, limit, idx)) {
+            ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
+            setnvalue(ra, idx);  /* update internal index... */
+            setnvalue(ra+3, idx);  /* ...and external index */
+            hotloop();
+          }
         }
       )
       vmcase(OP_FORPREP,
-        const TValue *init = ra;
-        const TValue *plimit = ra+1;
-        const TValue *pstep = ra+2;
-        if (!tonumber(init, ra))
-          luaG_runerror(L, LUA_QL("for") " initial value must be a number");
-        else if (!tonumber(plimit, ra+1))
-          luaG_runerror(L, LUA_QL("for") " limit must be a number");
-        else if (!tonumber(pstep, ra+2))
-          luaG_runerror(L, LUA_QL("for") " step must be a number");
-        setnvalue(ra, luai_numsub(L, nvalue(ra), nvalue(pstep)));
-        ci->u.l.savedpc += GETARG_sBx(i);
+        int res = luaV_forprep(L, ra);
+        if (res != 0)  /* floating loop or loop to be skipped? */
+          ci->u.l.savedpc += GETARG_sBx(i) + (res < 0);
       )
       vmcasenb(OP_TFORCALL,
         StkId cb = ra + 3;  /* call base */
-        setobjs2s(L, cb+2, ra+2);
-        setobjs2s(L, cb+1, ra+1);
-        setobjs2s(L, cb, ra);
-        L->top = cb + 3;  /* func. + 2 args (state and index) */
-        Protect(luaD_call(L, cb, GETARG_C(i), 1));
-        L->top = ci->top;
+        if (!luaV_tforcall(L, ra, GETARG_C(i))) {  /* must call iterator? */
+          setobjs2s(L, cb+2, ra+2);
+          setobjs2s(L, cb+1, ra+1);
+          setobjs2s(L, cb, ra);
+          L->top = cb + 3;  /* func. + 2 args (state and index) */
+          Protect(luaD_call(L, cb, GETARG_C(i), 1));
+          L->top = ci->top;
+        }
         i = *(ci->u.l.savedpc++);  /* go to next instruction */
         ra = RA(i);
         lua_assert(GET_OPCODE(i) == OP_TFORLOOP);
@@ -906,14 +1519,17 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_TFORLOOP,
         l_tforloop:
         if (!ttisnil(ra + 1)) {  /* continue loop? */
-          setobjs2s(L, ra, ra + 1);  /* save control variable */
+          if (!luaV_keepspos(ra))
+            setobjs2s(L, ra, ra + 1);  /* save control variable */
            ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
+          hotloop();
         }
       )
       vmcase(OP_SETLIST,
         int n = GETARG_B(i);
         int c = GETARG_C(i);
-        int last;
+        int first;
+        int j;
         Table *h;
         if (n == 0) n = cast_int(L->top - ra) - 1;
         if (c == 0) {
@@ -922,23 +1538,19 @@ void luaV_execute (lua_State *L) {
         }
         luai_runtimecheck(L, ttistable(ra));
         h = hvalue(ra);
-        last = ((c-1)*LFIELDS_PER_FLUSH) + n;
-        if (last > h->sizearray)  /* needs more space? */
-          luaH_resizearray(L, h, last);  /* pre-allocate it at once */
-        for (; n > 0; n--) {
-          TValue *val = ra+n;
-          luaH_setint(L, h, last--, val);
+        first = (c-1)*LFIELDS_PER_FLUSH;  /* index before the first item */
+        if (first + n > h->sizearray)  /* needs more space? */
+          luaH_resizearray(L, h, first + n);  /* pre-allocate it at once */
+        for (j = 1; j <= n; j++) {  /* in order, to keep arrays packed */
+          TValue *val = ra+j;
+          luaH_setint(L, h, first + j, val);
           luaC_barrierback(L, obj2gco(h), val);
         }
         L->top = ci->top;  /* correct top (in case of previous open call) */
       )
       vmcase(OP_CLOSURE,
         Proto *p = cl->p->p[GETARG_Bx(i)];
-        Closure *ncl = getcached(p, cl->upvals, base);  /* cached closure */
-        if (ncl == NULL)  /* no match? */
-          pushclosure(L, p, cl->upvals, base, ra);  /* create a new one */
-        else
-          setclLvalue(L, ra, ncl);  /* push cashed closure */
+        luaV_closure(L, p, cl->upvals, base, ra);
         checkGC(L, ra + 1);
       )
       vmcase(OP_VARARG,
@@ -960,6 +1572,97 @@ void luaV_execute (lua_State *L) {
           }
         }
       )
+      vmcase(OP_QADDF,
+        arith_fltop(luai_intadd, luai_numadd, TM_ADD, OP_ADD);
+      )
+      vmcase(OP_QSUBF,
+        arith_fltop(luai_intsub, luai_numsub, TM_SUB, OP_SUB);
+      )
+      vmcase(OP_QMULF,
+        arith_fltop(luai_intmul, luai_nummul, TM_MUL, OP_MUL);
+      )
+      vmcase(OP_QEQS,
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisshrstring(rb) && ttisshrstring(rc))
+          condjump(cast_int(eqshrstr(rawtsvalue(rb), rawtsvalue(rc))))
+        else {
+          quicken(OP_EQ);
+          Protect(condjump(cast_int(equalobj(L, rb, rc))))
+        }
+      )
+      vmcase(OP_QLTN,
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisnumber(rb) && ttisnumber(rc))
+          condjump(LTnum(L, rb, rc))
+        else {
+          quicken(OP_LT);
+          Protect(condjump(luaV_lessthan(L, rb, rc)))
+        }
+      )
+      vmcase(OP_QLEN,
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisnumber(rb) && ttisnumber(rc))
+          condjump(LEnum(L, rb, rc))
+        else {
+          quicken(OP_LE);
+          Protect(condjump(luaV_lessequal(L, rb, rc)))
+        }
+      )
+      vmcase(OP_GETTABUP_F,
+        TValue *upv = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        if (ttisshrstring(rc)) getstrfield(upv, rc, ra)
+        else Protect(luaV_gettable(L, upv, rc, ra));
+        vmfuse(OP_GETFIELD);
+      )
+      vmcase(OP_GETFIELD_F,
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        getstrfield(rb, rc, ra)
+        vmfuse(OP_GETFIELD);
+      )
+      vmcase(OP_GETTABUP_C,
+        TValue *upv = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        if (ttisshrstring(rc)) getstrfield(upv, rc, ra)
+        else Protect(luaV_gettable(L, upv, rc, ra));
+        vmfuse(OP_CALL);
+      )
+      vmcase(OP_SELF_C,
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        setobjs2s(L, ra+1, rb);
+        if (ttisshrstring(rc)) getstrfield(rb, rc, ra)
+        else Protect(luaV_gettable(L, rb, rc, ra));
+        vmfuse(OP_CALL);
+      )
+      vmcase(OP_MOVE_C,
+        setobjs2s(L, ra, RB(i));
+        vmfuse(OP_CALL);
+      )
+      vmcase(OP_LOADK_C,
+        TValue *rb = k + GETARG_Bx(i);
+        setobj2s(L, ra, rb);
+        vmfuse(OP_CALL);
+      )
+      vmcase(OP_APPEND,
+        StkId rb = RB(i);
+        if (ttistable(rb) && hvalue(rb)->metatable == NULL &&
+            !(L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT))) {
+          Table *h = hvalue(rb);
+          Instruction st = *(ci->u.l.savedpc + 1);  /* the OP_SETTABLE */
+          TValue *v = RKC(st);
+          lua_assert(GET_OPCODE(st) == OP_SETTABLE);
+          setivalue(ra, luaH_append(L, h, v));  /* as the OP_ADD would */
+          invalidateTMcache(h);
+          luaC_barrierback(L, obj2gco(h), v);
+          ci->u.l.savedpc += 2;  /* skip OP_ADD and OP_SETTABLE */
+        }
+        else Protect(luaV_objlen(L, ra, rb));
+      )
       vmcase(OP_EXTRAARG,
         lua_assert(0);
       )
@@ -17,9 +17,22 @@
 /* 将对象转换成整型对象 */
 #define tonumber(o,n)	(ttisnumber(o) || (((o) = luaV_tonumber(o,n)) != NULL))
 /* 判断两个对象相等 */
-#define equalobj(L,o1,o2)  (ttisequal(o1, o2) && luaV_equalobj_(L, o1, o2))
+/* integers and floats with the same value are also equal */
+/* 值相同的整数与浮点数也相等 */
+#define equalobj(L,o1,o2)  \
+	((ttisequal(o1, o2) || (ttisnumber(o1) && ttisnumber(o2))) && \
+	 luaV_equalobj_(L, o1, o2))
 #define luaV_rawequalobj(o1,o2)		equalobj(NULL,o1,o2)
 
+/*
+** whether the generic 'for' whose control variable is at 'ra' keeps
+** there a position in its table instead of a key (see 'luaV_tforcall');
+** OP_TFORLOOP does not copy keys over it
+*/
+/* 泛型for循环的控制变量是否保存表中的位置而不是健 */
+#define luaV_keepspos(ra)  \
+	(ttislcf((ra) - 2) && fvalue((ra) - 2) == luaV_nextpos)
+
 
 /* not to called directly */
 /* 内部函数不要直接调用 */
@@ -29,6 +42,7 @@ LUAI_FUNC int luaV_equalobj_ (lua_State *L, const TValue *t1, const TValue *t2);
 LUAI_FUNC int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r);
 LUAI_FUNC int luaV_lessequal (lua_State *L, const TValue *l, const TValue *r);
 LUAI_FUNC const TValue *luaV_tonumber (const TValue *obj, TValue *n);
+LUAI_FUNC int luaV_flttointeger (lua_Number n, lua_Integer *p, int mode);
 LUAI_FUNC int luaV_tostring (lua_State *L, StkId obj);
 LUAI_FUNC void luaV_gettable (lua_State *L, const TValue *t, TValue *key,
                                             StkId val);
@@ -37,8 +51,18 @@ LUAI_FUNC void luaV_settable (lua_State *L, const TValue *t, TValue *key,
 LUAI_FUNC void luaV_finishOp (lua_State *L);
 LUAI_FUNC void luaV_execute (lua_State *L);
 LUAI_FUNC void luaV_concat (lua_State *L, int total);
+LUAI_FUNC TString *luaV_tconcat (lua_State *L, Table *t, int i, int j,
+                                 TString *sep, int *bad);
 LUAI_FUNC void luaV_arith (lua_State *L, StkId ra, const TValue *rb,
                            const TValue *rc, TMS op);
 LUAI_FUNC void luaV_objlen (lua_State *L, StkId ra, const TValue *rb);
+LUAI_FUNC int luaV_forprep (lua_State *L, StkId ra);
+LUAI_FUNC int luaV_tforcall (lua_State *L, StkId ra, int nresults);
+/* 基础库的迭代器(由lbaselib注册) */
+LUAI_FUNC int luaV_next (lua_State *L);
+LUAI_FUNC int luaV_nextpos (lua_State *L);
+LUAI_FUNC int luaV_ipairsaux (lua_State *L);
+LUAI_FUNC void luaV_closure (lua_State *L, Proto *p, UpVal **encup,
+                             StkId base, StkId ra);
 
 #endif
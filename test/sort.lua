@@ -0,0 +1,27 @@
+-- regression tests for table.sort
+
+print("testing sort with a huge __len")
+
+-- a length from __len that the table cannot back must not grow it:
+-- the sort fails on the first missing element, as it always did
+local t = setmetatable({}, {__len = function () return 1e8 end})
+collectgarbage()
+local mem = collectgarbage("count")
+assert(not pcall(table.sort, t))
+collectgarbage()
+assert(collectgarbage("count") < mem + 100)   -- (in Kbytes)
+assert(next(t) == nil)
+
+t = setmetatable({3, 1, 2}, {__len = function () return 2^30 end})
+local ok, msg = pcall(table.sort, t)
+assert(not ok and string.find(msg, "compare"))
+
+-- elements outside the array part are sorted where they are
+t = setmetatable({}, {__len = function () return 5 end})
+for i = 5, 1, -1 do t[i] = (i * 3) % 5 end
+table.sort(t)
+for i = 1, 5 do assert(t[i] == i - 1) end
+table.sort(t, function (a, b) return a > b end, true)
+for i = 1, 5 do assert(t[i] == 5 - i) end
+
+print("OK")